@@ -0,0 +1,77 @@
+#ifndef PROJECT_MAC_DICTIONARY_H
+#define PROJECT_MAC_DICTIONARY_H
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * Packs a mac address of the form aa:bb:cc:dd:ee:ff into the lower 48 bits of an integer. Underscores are accepted as
+ * separators as well, since they replace colons in file and topic names.
+ * @param mac mac address as string
+ * @param packed Will be set to the packed mac address
+ * @return false if the string is not a mac address
+ */
+bool pack_mac(const std::string &mac, uint64_t &packed);
+
+/**
+ * Formats a packed mac address as string.
+ * @param packed packed mac address
+ * @param separator Character that is put between the bytes
+ * @return mac address as string, using lower case hex digits
+ */
+std::string unpack_mac(uint64_t packed, char separator = ':');
+
+/**
+ * Lists the files of a directory whose names without extension are mac addresses, like the training files of the
+ * access points. A mac address written in several forms, like aa_bb_cc_dd_ee_ff.csv and AA:BB:CC:DD:EE:FF.csv, is
+ * reported once, keeping the first file by name.
+ * @param directory Path of the directory
+ * @param ignored Will be set to the paths of the other regular files and of the duplicates
+ * @return Paths of the files by packed mac address
+ */
+std::map<uint64_t, std::string> mac_files(const std::string &directory, std::vector<std::string> &ignored);
+
+/**
+ * MacDictionary class
+ * Assigns dense indices to packed mac addresses, so that data belonging to access points can be kept in arrays instead
+ * of maps keyed by strings.
+ */
+class MacDictionary
+{
+public:
+  /**
+   * Returns the index of a mac address, adding it if it is not known yet.
+   * @param mac packed mac address
+   * @return index of the mac address. A known mac address keeps its index, so the index equals the previous size()
+   * only if the mac address was added.
+   */
+  int insert(uint64_t mac);
+
+  /**
+   * Returns the index of a mac address.
+   * @param mac packed mac address
+   * @return index, or -1 if the mac address is unknown
+   */
+  int index(uint64_t mac) const;
+
+  /**
+   * Returns the index of a mac address given as string.
+   * @param mac mac address as string
+   * @return index, or -1 if the mac address is unknown or malformed
+   */
+  int index(const std::string &mac) const;
+
+  /// Packed mac address of an index
+  uint64_t mac(int index) const { return macs_[index]; }
+
+  /// Number of mac addresses in the dictionary
+  int size() const { return macs_.size(); }
+
+private:
+  std::unordered_map<uint64_t, int> indices_;
+  std::vector<uint64_t> macs_;
+};
+
+#endif //PROJECT_MAC_DICTIONARY_H
@@ -9,6 +9,7 @@
 #include <ros/node_handle.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include "mac_dictionary.h"
 
 /**
  * Collection of all maps of the different mac addresses.
@@ -36,6 +37,17 @@ public:
   void add_data(int timestamp, std::string mac, double wifi_signal, int channel, std::string ssid,
                 geometry_msgs::PoseWithCovarianceStamped pose);
 
+  /**
+   * add data to a map
+   * @param packed_mac mac address packed with pack_mac()
+   * @param wifi_signal wifi signal
+   * @param channel channel of the signal
+   * @param ssid ssid of the signal
+   * @param pose pose the signal was recorded in
+   */
+  void add_data(int timestamp, uint64_t packed_mac, double wifi_signal, int channel, const std::string &ssid,
+                const geometry_msgs::PoseWithCovarianceStamped &pose);
+
   /**
    * Add csv data to the maps.
    * @param path Path to folder containing csv files
@@ -43,8 +55,8 @@ public:
   void add_csv_data(std::string path);
 
 private:
-  /// Holds the mac addresses corresponding to the right map
-  std::map<std::string, MapData> mac_map_;
+  /// Holds the packed mac addresses corresponding to the right map
+  std::map<uint64_t, MapData> mac_map_;
 
   /// Ros NodeHandle
   ros::NodeHandle n_;
@@ -54,10 +66,10 @@ private:
 
   /**
    * Returns the map matching to the mac address. If such a map does not exist yet it is going to be created.
-   * @param mac mac address
+   * @param packed_mac packed mac address
    * @return map matching the mac address
    */
-  std::map<std::string, MapData>::iterator get_map(std::string mac);
+  std::map<uint64_t, MapData>::iterator get_map(uint64_t packed_mac);
 
   /// service that publishes the wifi maps
   ros::ServiceServer wifi_map_service;
@@ -10,6 +10,8 @@
 #include <geometry_msgs/PoseWithCovariance.h>
 #include "wifi_localization/MaxWeight.h"
 #include "wifi_localization/WifiState.h"
+#include "wifi_localization/WifiState2.h"
+#include "wifi_localization/WifiSsidDictionary.h"
 #include <nav_msgs/OccupancyGrid.h>
 #include <nav_msgs/Odometry.h>
 #include <std_srvs/Empty.h>
@@ -52,6 +54,15 @@ private:
   /// Subscriber for the wifi data
   ros::Subscriber wifi_data_sub_;
 
+  /// Subscriber for the wifi data in the compact format
+  ros::Subscriber wifi_compact_data_sub_;
+
+  /// Subscriber for the ssid dictionary the compact wifi data refers to
+  ros::Subscriber ssid_dictionary_sub_;
+
+  /// Latest ssid dictionary
+  wifi_localization::WifiSsidDictionary ssids_;
+
   /// Subscriber for odometry data. Used to check if the robot is stopped.
   ros::Subscriber odom_sub_;
 
@@ -130,6 +141,31 @@ private:
    */
   void wifiCallbackMethod(const wifi_localization::WifiState::ConstPtr& wifi_data_msg);
 
+  /**
+   * Same as wifiCallbackMethod for wifi data in the compact format.
+   * @param wifi_data_msg wifi data
+   */
+  void wifiCompactCallbackMethod(const wifi_localization::WifiState2::ConstPtr& wifi_data_msg);
+
+  /**
+   * Stores the ssid dictionary used to resolve the ssids of the compact wifi data.
+   * @param msg ssid dictionary
+   */
+  void ssidDictionaryCallbackMethod(const wifi_localization::WifiSsidDictionary::ConstPtr& msg);
+
+  /**
+   * Checks if the state of the object allows for recordings.
+   * @param empty_scan true if the incoming wifi data contains no access points
+   * @return Pose the wifi data is recorded at, or nullptr if it is not recorded
+   */
+  const geometry_msgs::PoseWithCovarianceStamped *recording_pose(bool empty_scan);
+
+  /**
+   * Updates the recording state after incoming wifi data was processed.
+   * @param pose Pose returned by recording_pose
+   */
+  void finish_wifi_data(const geometry_msgs::PoseWithCovarianceStamped *pose);
+
   /**
    * Checks if the robot is stopped.
    * @param msg Odometry data of the turtlebot
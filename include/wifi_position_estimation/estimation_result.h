@@ -0,0 +1,31 @@
+#ifndef PROJECT_ESTIMATION_RESULT_H
+#define PROJECT_ESTIMATION_RESULT_H
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include <wifi_localization/WifiPoseHypotheses.h>
+
+/**
+ * EstimationResult struct
+ * Estimated pose together with how far the estimation got.
+ */
+struct EstimationResult
+{
+  geometry_msgs::PoseWithCovarianceStamped pose;
+  /// Log likelihood of the estimated position, NaN if the search does not report it
+  double log_likelihood;
+  /// Weighted standard deviation of the particles in meters, NaN if the search does not report it
+  double spread;
+  /// True if the spread fell below the minimum refinement spread
+  bool converged;
+  /// False if the estimation was stopped by its deadline
+  bool completed;
+  /// Number of scored particles
+  int evaluations;
+  /// False if no position could be estimated. The pose is neither published nor cached then.
+  bool valid;
+  /// Summary of the posterior, only meaningful if has_hypotheses is set. Cached with the pose, so a hit republishes it.
+  wifi_localization::WifiPoseHypotheses hypotheses;
+  bool has_hypotheses;
+};
+
+
+#endif //PROJECT_ESTIMATION_RESULT_H
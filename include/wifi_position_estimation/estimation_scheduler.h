@@ -0,0 +1,95 @@
+#ifndef PROJECT_ESTIMATION_SCHEDULER_H
+#define PROJECT_ESTIMATION_SCHEDULER_H
+#include <deque>
+#include <string>
+#include <utility>
+
+/**
+ * EstimationScheduler class
+ * Decides which triggers start a position estimation. Bursts of triggers during an estimation are coalesced into a
+ * single follow-up estimation, which is checked like a new trigger once the running one is finished. Two
+ * estimations are at least min_interval seconds apart, the estimations may only use a share of the cpu time within a
+ * sliding window and every estimation needs a scan that is newer than the one of the previous estimation.
+ * All times are in seconds. The class is not thread-safe.
+ */
+class EstimationScheduler
+{
+public:
+  /// Result of a trigger
+  enum Outcome
+  {
+    /// An estimation is started
+    STARTED,
+    /// An estimation is still queued or running, the trigger is replayed when it is finished
+    COALESCED,
+    /// The previous estimation started less than min_interval seconds ago
+    TOO_SOON,
+    /// The estimations used up their cpu budget within the window
+    OVER_BUDGET,
+    /// No scan arrived since the previous estimation
+    NO_FRESH_SCAN,
+    /// Number of outcomes
+    N_OUTCOMES
+  };
+
+  /**
+   * Constructor
+   * @param min_interval Minimum time between the starts of two estimations. 0 disables the limit.
+   * @param cpu_budget Share of the window the estimations may use cpu time for. 0 disables the budget.
+   * @param budget_window Length of the sliding window the cpu budget refers to
+   */
+  EstimationScheduler(double min_interval = 0.0, double cpu_budget = 0.0, double budget_window = 60.0);
+
+  /**
+   * Decides whether a trigger starts an estimation. If it does, the scheduler counts the estimation as running until
+   * finished() is called.
+   * @param now Current time
+   * @param scan_stamp Stamp of the latest scan
+   * @return Outcome of the trigger
+   */
+  Outcome trigger(double now, double scan_stamp);
+
+  /**
+   * Reports that the started estimation is finished. If triggers were coalesced meanwhile, one of them is replayed.
+   * @param now Current time
+   * @param cpu_time Cpu time the estimation used
+   * @param scan_stamp Stamp of the latest scan, for the replayed trigger
+   * @return true if the replayed trigger started another estimation, which the caller has to run
+   */
+  bool finished(double now, double cpu_time, double scan_stamp);
+
+  /// Number of triggers with the given outcome
+  long count(Outcome outcome) const { return counts_[outcome]; }
+
+  /// Outcome of the latest trigger
+  Outcome last_outcome() const { return last_outcome_; }
+
+  /// Cpu time used within the window ending at now, relative to the length of the window
+  double cpu_usage(double now);
+
+  /// Readable name of an outcome
+  static std::string outcome_name(Outcome outcome);
+
+private:
+  double min_interval_;
+  double cpu_budget_;
+  double budget_window_;
+
+  /// Set between a started trigger and finished()
+  bool running_;
+
+  /// Set if a trigger was coalesced since the running estimation started
+  bool pending_;
+
+  /// Start time and scan stamp of the latest estimation, negative before the first one
+  double last_start_;
+  double last_scan_stamp_;
+
+  /// End times and cpu times of the estimations within the window
+  std::deque<std::pair<double, double>> history_;
+
+  long counts_[N_OUTCOMES];
+  Outcome last_outcome_;
+};
+
+#endif //PROJECT_ESTIMATION_SCHEDULER_H
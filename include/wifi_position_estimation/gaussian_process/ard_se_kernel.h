@@ -36,7 +36,7 @@ public:
    * @param pos2 second position
    * @return Covariance of the two positions
    */
-  double covariance(Vector2d& pos1, Vector2d& pos2);
+  double covariance(const Vector2d& pos1, const Vector2d& pos2) const;
 
   /**
    * Computes the gradient for two given positions.
@@ -46,6 +46,15 @@ public:
    */
   Matrix<double, 4, 1> gradient(Vector2d& pos1, Vector2d& pos2);
 
+  /**
+   * Computes the derivative of the covariance with respect to the first position. The noise term is left out, since it
+   * does not change with the position.
+   * @param pos1 first position
+   * @param pos2 second position
+   * @return Derivative with respect to both coordinates of pos1
+   */
+  Vector2d position_gradient(const Vector2d& pos1, const Vector2d& pos2) const;
+
   /**
    * Set the hyper-parameters of the kernel.
    * @param signal_noise
@@ -67,7 +76,7 @@ public:
    * Get the hyper-parameters of the kernel.
    * @return
    */
-  Vector4d get_parameters();
+  Vector4d get_parameters() const;
 
 private:
   double signal_noise_;
@@ -27,6 +27,37 @@ template <typename T> int sgn(T val)
 class Process
 {
 public:
+  /**
+   * Model struct
+   * Normalization constants, hyperparameters and arrays of a trained process. The arrays are column-major.
+   */
+  struct Model
+  {
+    int n;
+    double x_mean;
+    double y_mean;
+    double x_std;
+    double y_std;
+    /// signal_noise, signal_var and both lengthscales, as returned by get_params()
+    double params[4];
+    /// Normalized training coordinates, n x 2
+    const double *coordinates;
+    /// Normalized training observations, n
+    const double *observations;
+    /// Lower Cholesky factor of the covariance matrix of the training coordinates, n x n
+    const double *cholesky;
+    /// Inverse of the covariance matrix times the observations, n
+    const double *alpha;
+  };
+
+  /**
+   * Constructor
+   * Wraps a trained model without copying its arrays, so they have to outlive the process and all its copies. The
+   * process can predict, but neither be trained nor get new parameters or training values.
+   * @param model Trained model, for example from a ModelBundle
+   */
+  explicit Process(const Model &model);
+
   /**
    * Constructor
    * @param training_coords Coordinates, that usually have been recorded beforehand
@@ -60,7 +91,57 @@ public:
    * @param z
    * @return probability that the observation was made at the coordinate the mean and variance were computed with
    */
-  double probability_precomputed(double mean, double variance, double z);
+  static double probability_precomputed(double mean, double variance, double z);
+
+  /**
+   * Returns the log of probability_precomputed(). Sums of these do not underflow like products of probabilities do.
+   * @param mean
+   * @param variance
+   * @param z
+   * @return log probability that the observation was made at the coordinate the mean and variance were computed with
+   */
+  static double log_probability_precomputed(double mean, double variance, double z);
+
+  /**
+   * Upper bound on log_probability_precomputed() for any mean and variance in the given ranges.
+   * @param mean_min
+   * @param mean_max
+   * @param variance_min
+   * @param variance_max
+   * @param z signal strength in dBm
+   * @return upper bound on the log probability
+   */
+  static double log_probability_bound(double mean_min, double mean_max, double variance_min, double variance_max,
+                                      double z);
+
+  /**
+   * Variance of the noise of the process. No predicted variance is lower than this.
+   * @return noise variance
+   */
+  double noise_variance() const;
+
+  /// Number of training observations
+  int training_size() const { return n; }
+
+  /// Normalized training observations
+  Map<const Matrix<double, Dynamic, 1>> training_observations() const
+  {
+    return Map<const Matrix<double, Dynamic, 1>>(mapped_ ? mapped_observations_ : training_observs_.data(), n);
+  }
+
+  /**
+   * Describes the process as a model. The arrays point into the process, except for the Cholesky factor.
+   * @param cholesky Will be set to the Cholesky factor, which the model points into
+   * @return Model of the process
+   */
+  Model model(Matrix<double, Dynamic, Dynamic> &cholesky) const;
+
+  /**
+   * Scales a signal strength in dBm to the range the processes are trained on.
+   * @param z signal strength in dBm
+   * @return normalized signal strength
+   */
+  static double normalize_observation(double z) { return (z+100.0)/(100.0); }
 
   /**
    * Sets the training sets to new values. The values are normalized, before they are saved.
@@ -102,6 +183,29 @@ public:
    */
   void precompute_data(PrecomputedDataPoint& data, Eigen::Vector2d position);
 
+  /**
+   * Predicts the normalized mean and variance for the given coordinates. Unlike probability(), this does not modify
+   * the state of the process.
+   * @param x x coordinate
+   * @param y y coordinate
+   * @param mean Will be set to the predicted mean
+   * @param variance Will be set to the predicted variance
+   */
+  void predict(double x, double y, double &mean, double &variance) const;
+
+  /**
+   * Predicts the normalized mean and variance like predict() and additionally their derivatives with respect to the
+   * coordinates.
+   * @param x x coordinate
+   * @param y y coordinate
+   * @param mean Will be set to the predicted mean
+   * @param variance Will be set to the predicted variance
+   * @param mean_gradient Will be set to the derivative of the mean with respect to x and y
+   * @param variance_gradient Will be set to the derivative of the variance with respect to x and y
+   */
+  void predict_with_gradient(double x, double y, double &mean, double &variance, Vector2d &mean_gradient,
+                             Vector2d &variance_gradient) const;
+
 
   /**
    * Creates a map if the mean of the gaussian process.
@@ -117,12 +221,20 @@ public:
   void create_gp_variance_map(grid_map::GridMap &map);
 
 private:
-  /**
-   * Computes the covariance vector between the provided coordinates and the training_coordinates
-   * @param x x coordinate
-   * @param y y coordinate
-   */
-  void compute_cov_vector(double x, double y);
+  /// Normalized training coordinates, from the members or the wrapped model
+  Map<const Matrix<double, Dynamic, 2>> coordinates() const
+  {
+    return Map<const Matrix<double, Dynamic, 2>>(mapped_ ? mapped_coordinates_ : training_coords_.data(), n, 2);
+  }
+
+  /// alpha_ or the alpha of the wrapped model
+  Map<const Matrix<double, Dynamic, 1>> alpha() const
+  {
+    return Map<const Matrix<double, Dynamic, 1>>(mapped_ ? mapped_alpha_ : alpha_.data(), n);
+  }
+
+  /// Inverse of the covariance matrix times a vector. Uses the Cholesky factor, if the process wraps a model.
+  Matrix<double, Dynamic, 1> solve(const Matrix<double, Dynamic, 1> &vector) const;
 
   /**
    * This updates the covariance matrix K and the inverse of it K_inv.
@@ -135,7 +247,9 @@ private:
 
   Matrix<double, Dynamic, Dynamic> K_;
   Matrix<double, Dynamic, Dynamic> K_inv_;
-  Matrix<double, Dynamic, 1> cov_vector_;
+
+  /// K_inv_ * training_observs_, so that the mean can be predicted in linear time
+  Matrix<double, Dynamic, 1> alpha_;
 
   /// Number of training coordinates and training observations
   int n;
@@ -145,6 +259,13 @@ private:
   double y_mean_;
   double x_std_;
   double y_std_;
+
+  /// Set if the process wraps a model. The arrays below are used instead of the matrices above then.
+  bool mapped_;
+  const double *mapped_coordinates_;
+  const double *mapped_observations_;
+  const double *mapped_cholesky_;
+  const double *mapped_alpha_;
 };
 
 
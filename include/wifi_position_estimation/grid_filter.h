@@ -0,0 +1,62 @@
+#ifndef PROJECT_GRID_FILTER_H
+#define PROJECT_GRID_FILTER_H
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+#include <wifi_position_estimation/precomputed_grid.h>
+
+/**
+ * GridFilter class
+ * Recursive Bayesian filter over the free nodes of a PrecomputedGrid. The belief is kept as a log probability per
+ * node. Every scan adds the log likelihood of its observations to all nodes, and motion between scans is modeled by a
+ * separable gaussian blur of the belief.
+ */
+class GridFilter
+{
+public:
+  /**
+   * Sets the belief to a uniform distribution over the free nodes.
+   * @param grid Precomputed grid the filter works on. It has to outlive the filter.
+   * @param uniform_mix Share of a uniform distribution mixed into the belief after every prediction, so that the filter
+   * can recover from a wrong belief
+   */
+  void reset(const PrecomputedGrid &grid, double uniform_mix);
+
+  /**
+   * Prediction step. Blurs the belief with a gaussian kernel.
+   * @param sigma Standard deviation of the motion in meters
+   */
+  void predict(double sigma);
+
+  /**
+   * Measurement step. Adds the log likelihood of the observations to every free node.
+   * @param observations Pairs of process indices and signal strengths in dBm
+   */
+  void update(const std::vector<std::pair<int, double>> &observations);
+
+  /**
+   * Summarizes the belief.
+   * @param mode Will be set to the position of the node with the highest probability
+   * @param mean Will be set to the mean of the belief
+   * @param covariance Will be set to the covariance of the belief
+   * @return false if the filter was not reset yet
+   */
+  bool estimate(Eigen::Vector2d &mode, Eigen::Vector2d &mean, Eigen::Matrix2d &covariance) const;
+
+  bool empty() const { return grid_ == nullptr; }
+
+private:
+  const PrecomputedGrid *grid_ = nullptr;
+
+  double uniform_mix_ = 0.0;
+
+  int n_free_ = 0;
+
+  /// Log probability of every node, stored row after row. -infinity for nodes that are not free.
+  std::vector<double> log_belief_;
+
+  /// Subtracts the maximum, so that the most likely node has a log probability of 0
+  void normalize();
+};
+
+#endif //PROJECT_GRID_FILTER_H
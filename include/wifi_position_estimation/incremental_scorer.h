@@ -0,0 +1,70 @@
+#ifndef PROJECT_INCREMENTAL_SCORER_H
+#define PROJECT_INCREMENTAL_SCORER_H
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <wifi_position_estimation/precomputedDataPoint.h>
+
+/**
+ * IncrementalScorer class
+ * Keeps the log likelihood of a fixed set of particles for the previous scan. A new scan is scored by subtracting the
+ * terms of the access points whose signal strength changed or that disappeared, and adding the terms of the changed
+ * and new ones. Repeated estimations cost O(changed access points x particles) instead of O(access points x particles).
+ */
+class IncrementalScorer
+{
+public:
+  /// Sets mean and variance of a process at a particle
+  typedef std::function<void(int particle, int ap, double &mean, double &variance)> Predictor;
+
+  IncrementalScorer();
+
+  /**
+   * Replaces the particles and forgets the previous scan.
+   * @param n_particles Number of particles
+   * @param predictor Called once per particle for every process the first time it is observed
+   * @param full_rescore_interval Number of updates after which all terms are summed up again, so that rounding errors
+   * of the subtractions do not accumulate. 0 never rescores.
+   */
+  void reset(int n_particles, const Predictor &predictor, int full_rescore_interval);
+
+  /**
+   * Scores a new scan.
+   * @param observations Pairs of process indices and signal strengths in dBm
+   * @return Number of access points whose terms were added or subtracted
+   */
+  int update(const std::vector<std::pair<int, double>> &observations);
+
+  /// Log likelihood of every particle for the latest scan
+  const std::vector<double> &log_likelihoods() const { return totals_; }
+
+  /// Index of the particle with the highest log likelihood, -1 if there are no particles
+  int best_particle() const;
+
+  int size() const { return n_particles_; }
+
+private:
+  int n_particles_;
+  Predictor predictor_;
+  int full_rescore_interval_;
+  int updates_since_rescore_;
+
+  /// Log likelihood of every particle
+  std::vector<double> totals_;
+
+  /// Signal strengths of the access points included in totals_
+  std::map<int, double> scored_;
+
+  /// Means and variances of the processes observed so far, one value per particle
+  std::unordered_map<int, std::vector<PrecomputedDataPoint>> columns_;
+
+  /// Returns the means and variances of a process, computing them on first use
+  const std::vector<PrecomputedDataPoint> &column(int ap);
+
+  /// Adds the terms of an observation to all particles, multiplied with sign
+  void add(int ap, double strength, double sign);
+};
+
+#endif //PROJECT_INCREMENTAL_SCORER_H
@@ -0,0 +1,61 @@
+#ifndef PROJECT_KIDNAPPING_MONITOR_H
+#define PROJECT_KIDNAPPING_MONITOR_H
+
+/**
+ * KidnappingMonitor class
+ * Decides whether the log likelihood of a scan at the pose of amcl is plausible. The monitor learns the distribution of
+ * the statistic from scans at trusted poses as an exponentially weighted mean and variance, and reports a failure when
+ * the statistic falls more than a number of standard deviations below the mean for several scans in a row.
+ */
+class KidnappingMonitor
+{
+public:
+  /**
+   * Constructor
+   * @param threshold Number of standard deviations below the mean, at which a scan fails the check
+   * @param min_samples Number of calibration samples needed before checks can fail
+   * @param consecutive_failures Number of failed scans in a row that are reported as a kidnapping
+   * @param adaptation Weight of a new sample in the mean and variance
+   */
+  KidnappingMonitor(double threshold = 3.0, int min_samples = 20, int consecutive_failures = 2,
+                    double adaptation = 0.05);
+
+  /**
+   * Adds a statistic of a scan at a trusted pose to the distribution.
+   * @param statistic Log likelihood per observation
+   */
+  void calibrate(double statistic);
+
+  /**
+   * Checks a statistic against the distribution.
+   * @param statistic Log likelihood per observation
+   * @return true if enough scans in a row failed the check. The count of failures starts over then.
+   */
+  bool check(double statistic);
+
+  /// Whether the statistic of the latest check was plausible
+  bool last_check_passed() const { return last_passed_; }
+
+  bool calibrated() const { return samples_ >= min_samples_; }
+
+  double threshold() const { return threshold_; }
+  double mean() const { return mean_; }
+  double variance() const { return variance_; }
+
+private:
+  double threshold_;
+  int min_samples_;
+  int consecutive_failures_;
+  double adaptation_;
+
+  int samples_;
+  double mean_;
+  double variance_;
+
+  /// Number of failed checks in a row
+  int failures_;
+
+  bool last_passed_;
+};
+
+#endif //PROJECT_KIDNAPPING_MONITOR_H
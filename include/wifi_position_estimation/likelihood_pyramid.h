@@ -0,0 +1,63 @@
+#ifndef PROJECT_LIKELIHOOD_PYRAMID_H
+#define PROJECT_LIKELIHOOD_PYRAMID_H
+#include <vector>
+#include <Eigen/Dense>
+#include <wifi_position_estimation/precomputed_grid.h>
+
+/**
+ * LikelihoodPyramid class
+ * Multi-resolution pyramid over the nodes of a PrecomputedGrid. Every tile of a level covers four tiles of the level
+ * below and holds the minimum and maximum mean and variance of each process within it. From these an upper bound on
+ * the log likelihood of a scan within the tile can be computed, which allows a branch-and-bound search for the best
+ * node that only expands tiles that can still beat the best node found so far.
+ */
+class LikelihoodPyramid
+{
+public:
+  /**
+   * Builds the pyramid.
+   * @param grid Precomputed grid the pyramid is built for. It has to outlive the pyramid.
+   */
+  void build(const PrecomputedGrid &grid);
+
+  /**
+   * Finds the free node of the grid with the highest log likelihood for the given scan.
+   * @param observations Pairs of process indices and signal strengths in dBm
+   * @param position Will be set to the position of the best node
+   * @param log_likelihood Will be set to the log likelihood of the best node
+   * @return Number of tiles whose bound was evaluated, or -1 if no free node exists or the pyramid has no levels
+   */
+  int search(const std::vector<std::pair<int, double>> &observations, Eigen::Vector2d &position,
+             double &log_likelihood) const;
+
+  /// Whether build() was called
+  bool empty() const { return levels_.empty(); }
+
+private:
+  /// Holds the bounds of all tiles of one level
+  struct Level
+  {
+    int cols;
+    int rows;
+    /// Bounds of the tiles, stored tile after tile, each tile holding the values of all processes
+    std::vector<double> mean_min;
+    std::vector<double> mean_max;
+    std::vector<double> variance_min;
+    std::vector<double> variance_max;
+    /// Marks the tiles containing at least one free node
+    std::vector<char> free;
+  };
+
+  /// Levels of the pyramid, starting with the level directly above the nodes of the grid
+  std::vector<Level> levels_;
+
+  const PrecomputedGrid *grid_ = nullptr;
+
+  /**
+   * Upper bound on the log likelihood of a scan within a tile.
+   * @param level level of the tile, 0 being the nodes of the grid
+   */
+  double tile_bound(const std::vector<std::pair<int, double>> &observations, int level, int col, int row) const;
+};
+
+#endif //PROJECT_LIKELIHOOD_PYRAMID_H
@@ -0,0 +1,84 @@
+#ifndef PROJECT_LIKELIHOOD_TABLE_H
+#define PROJECT_LIKELIHOOD_TABLE_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <wifi_position_estimation/precomputedDataPoint.h>
+
+/**
+ * LikelihoodTable class
+ * Log likelihood lookup tables for the precomputed random points. Signal strengths are integers in dBm, so for a
+ * point and an access point the log likelihood only depends on that integer. Pairs of points and access points with
+ * similar means and variances share a row of log likelihoods for every dBm value, quantized to int16. Scoring a point
+ * then needs one table lookup and an integer addition per observation.
+ */
+class LikelihoodTable
+{
+public:
+  /// Range of the signal strengths in dBm covered by a row. Stronger and weaker signals are clamped.
+  static const int MIN_DBM = -110;
+  static const int MAX_DBM = -10;
+  static const int ROW_LENGTH = MAX_DBM - MIN_DBM + 1;
+
+  LikelihoodTable();
+
+  /**
+   * Clusters the means and variances and fills the rows. The clusters start fine and are made coarser until the table
+   * fits into the memory budget.
+   * @param data Point-major means and variances of n_points points and n_aps access points
+   * @param n_points Number of points
+   * @param n_aps Number of access points
+   * @param max_bytes Memory budget of the table
+   * @param resolution Log likelihood of one quantization step
+   * @return false if the table does not fit into the budget. The table stays empty then.
+   */
+  bool build(const std::vector<PrecomputedDataPoint> &data, int n_points, int n_aps, size_t max_bytes,
+             double resolution);
+
+  void clear();
+
+  bool empty() const { return values_.empty(); }
+
+  /// Column of a signal strength in the rows
+  static int column(double strength);
+
+  /**
+   * Key of a cluster. Both bins may be negative, the variance bin fills the upper and the mean bin the lower 32 bits.
+   * @param variance_bin Bin of the log variance
+   * @param mean_bin Bin of the mean
+   * @return Key of the pair of bins
+   */
+  static uint64_t bin_key(int64_t variance_bin, int64_t mean_bin)
+  {
+    return (static_cast<uint64_t>(variance_bin) << 32) | static_cast<uint32_t>(mean_bin);
+  }
+
+  /// Row of quantized log likelihoods of an access point at a point
+  const int16_t *row(int point, int ap) const
+  {
+    return &values_[size_t(clusters_[size_t(point) * n_aps_ + ap]) * ROW_LENGTH];
+  }
+
+  /// Converts a sum of quantized values back to a log likelihood
+  double log_likelihood(int32_t quantized) const { return quantized * resolution_; }
+
+  int clusters() const { return values_.size() / ROW_LENGTH; }
+
+  size_t bytes() const { return clusters_.size() * sizeof(uint16_t) + values_.size() * sizeof(int16_t); }
+
+  /// Step of the mean in standard deviations and of the log variance, that the clusters were built with
+  double cluster_step() const { return cluster_step_; }
+
+private:
+  int n_aps_;
+  double resolution_;
+  double cluster_step_;
+
+  /// Cluster of every pair of point and access point, point-major
+  std::vector<uint16_t> clusters_;
+
+  /// ROW_LENGTH quantized log likelihoods per cluster
+  std::vector<int16_t> values_;
+};
+
+#endif //PROJECT_LIKELIHOOD_TABLE_H
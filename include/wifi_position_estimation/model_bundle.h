@@ -0,0 +1,74 @@
+#ifndef PROJECT_MODEL_BUNDLE_H
+#define PROJECT_MODEL_BUNDLE_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <wifi_position_estimation/gaussian_process/gaussian_process.h>
+
+/**
+ * ModelBundle class
+ * Stores the trained gaussian processes of all access points in one versioned binary file. Per mac address it holds the
+ * normalization constants, the hyperparameters, the normalized training data, the Cholesky factor of the covariance
+ * matrix and alpha, each array aligned to 64 bytes. Loading maps the file read-only and hands out models that a Process
+ * wraps without copying, so startup does not parse csv files or invert matrices, and several estimators on one host
+ * share the pages.
+ */
+class ModelBundle
+{
+public:
+  /// Incremented whenever the layout of the file changes
+  static const uint32_t VERSION = 2;
+
+  ModelBundle();
+  ~ModelBundle();
+
+  ModelBundle(const ModelBundle &) = delete;
+  ModelBundle &operator=(const ModelBundle &) = delete;
+
+  /**
+   * Writes processes to a file. The file is written to a temporary name and renamed, so a reader never maps a partial
+   * file.
+   * @param file Path of the file
+   * @param key Key of the training data and configuration the processes were trained with
+   * @param macs Packed mac addresses of the processes
+   * @param processes Trained processes
+   * @return false if the file could not be written
+   */
+  static bool write(const std::string &file, uint64_t key, const std::vector<uint64_t> &macs,
+                    const std::vector<Process> &processes);
+
+  /**
+   * Maps a file. The mapping is kept until the next load or the destruction of the bundle, and the processes wrapping
+   * its models must not be used after that.
+   * @param file Path of the file
+   * @param key Key the file has to have been written with
+   * @return false if the file does not exist, has another key, version or byte order, or its index points outside of
+   * the file
+   */
+  bool load(const std::string &file, uint64_t key);
+
+  /// Number of models in the loaded file
+  int size() const { return entries_.size(); }
+
+  /// Packed mac address of a model
+  uint64_t mac(int index) const;
+
+  /// Model of an index, pointing into the mapped file
+  Process::Model model(int index) const;
+
+  /// Begin and size of the mapped file, for hashing its contents
+  const void *data() const { return mapping_; }
+  size_t bytes() const { return size_; }
+
+private:
+  struct Entry;
+
+  void *mapping_;
+  size_t size_;
+  std::vector<const Entry *> entries_;
+
+  void unmap();
+};
+
+#endif //PROJECT_MODEL_BUNDLE_H
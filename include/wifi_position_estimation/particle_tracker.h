@@ -0,0 +1,97 @@
+#ifndef PROJECT_PARTICLE_TRACKER_H
+#define PROJECT_PARTICLE_TRACKER_H
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <vector>
+#include <Eigen/Dense>
+
+/**
+ * ParticleTracker class
+ * Particle filter that tracks the pose of the robot between relocalizations. The particles are moved by the odometry
+ * and reweighted with the log likelihood of every scan. Once the particles converged, the filter continues with fewer
+ * particles, and it grows back to the maximum when their spread exceeds twice the convergence threshold.
+ */
+class ParticleTracker
+{
+public:
+  /// Log likelihood of the current scan at a position
+  typedef std::function<double(const Eigen::Vector2d &)> LikelihoodFunction;
+
+  /// Draws a random position in free space. Returns false if none was found.
+  typedef std::function<bool(Eigen::Vector2d &)> PositionSampler;
+
+  ParticleTracker();
+
+  /**
+   * Sets the parameters of the filter.
+   * @param min_particles Number of particles once the filter converged
+   * @param max_particles Number of particles while the filter did not converge
+   * @param converged_spread The filter counts as converged, when the standard deviation of the particle positions in
+   * meters falls below this value
+   * @param translation_noise Standard deviation of the translation noise per meter moved
+   * @param rotation_noise Standard deviation of the rotation noise per radian turned
+   */
+  void configure(int min_particles, int max_particles, double converged_spread, double translation_noise,
+                 double rotation_noise);
+
+  /**
+   * Spreads up to max_particles particles with random headings over the map. Positions the sampler fails to draw are
+   * left out.
+   * @param sampler Draws the positions
+   */
+  void reset(const PositionSampler &sampler);
+
+  /**
+   * Moves every particle by the odometry, given in the frame of the robot at the previous step, plus noise.
+   * @param dx Forward motion in meters
+   * @param dy Sideways motion in meters
+   * @param dtheta Rotation in radians
+   */
+  void predict(double dx, double dy, double dtheta);
+
+  /**
+   * Reweights the particles with a scan and resamples them if the effective sample size got small or the number of
+   * particles should change. If no particle has a finite likelihood, the filter is reset.
+   * @param log_likelihood Log likelihood of the scan
+   * @param sampler Used to reset the filter
+   */
+  void update(const LikelihoodFunction &log_likelihood, const PositionSampler &sampler);
+
+  /**
+   * Weighted mean and covariance of the particles.
+   * @param mean Will be set to x, y and heading
+   * @param covariance Will be set to the covariance of x, y and heading
+   */
+  void estimate(Eigen::Vector3d &mean, Eigen::Matrix3d &covariance) const;
+
+  /// Standard deviation of the particle positions around their weighted mean in meters
+  double spread() const;
+
+  int size() const { return particles_.size(); }
+
+private:
+  struct Particle
+  {
+    Eigen::Vector2d position;
+    double theta;
+    double log_weight;
+  };
+
+  std::vector<Particle> particles_;
+  std::mt19937 random_engine_;
+
+  int min_particles_;
+  int max_particles_;
+  double converged_spread_;
+  double translation_noise_;
+  double rotation_noise_;
+
+  /// Normalized weights of the particles
+  std::vector<double> weights() const;
+
+  /// Systematic resampling to n particles with equal weights
+  void resample(size_t n);
+};
+
+#endif //PROJECT_PARTICLE_TRACKER_H
@@ -0,0 +1,63 @@
+#ifndef PROJECT_POSTERIOR_SUMMARY_H
+#define PROJECT_POSTERIOR_SUMMARY_H
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+
+/**
+ * PosteriorSummary class
+ * Collects the scored particles of one estimation and summarizes the posterior they describe. The particles have to be
+ * drawn uniformly from the searched area, so their normalized likelihoods are importance weights of the posterior.
+ * Particles abandoned by the early termination are added with a log likelihood of minus infinity, which only drops
+ * weight that is negligible next to the best particle.
+ */
+class PosteriorSummary
+{
+public:
+  /// Position and posterior weight of a mode
+  typedef std::pair<Eigen::Vector2d, double> Mode;
+
+  void clear();
+
+  /**
+   * Adds a scored particle.
+   * @param position Position of the particle
+   * @param log_likelihood Log likelihood of the scan at the position
+   */
+  void add(const Eigen::Vector2d &position, double log_likelihood);
+
+  /**
+   * Normalizes the weights with a log-sum-exp and computes their weighted mean and covariance.
+   * @param mean Will be set to the weighted mean
+   * @param covariance Will be set to the weighted covariance
+   * @return false if less than two particles have a finite log likelihood
+   */
+  bool moments(Eigen::Vector2d &mean, Eigen::Matrix2d &covariance) const;
+
+  /**
+   * Finds well separated modes by non-maximum suppression on a grid. The weights are summed per cell and a cell is
+   * a mode if no neighboring cell holds more weight. The position of a mode is its best particle and its weight the
+   * weight of the cell and its neighbors.
+   * @param k Maximum number of modes
+   * @param separation Side length of the cells in meters
+   * @return Modes by descending weight, none if k or separation is not positive
+   */
+  std::vector<Mode> modes(int k, double separation) const;
+
+  /// Log of the mean likelihood of the particles, minus infinity if there are none
+  double log_mean_likelihood() const;
+
+  int size() const { return positions_.size(); }
+
+private:
+  std::vector<Eigen::Vector2d> positions_;
+  std::vector<double> log_likelihoods_;
+
+  /// Normalized weights of the particles
+  std::vector<double> weights() const;
+
+  /// Log of the sum of the likelihoods
+  double log_sum() const;
+};
+
+#endif //PROJECT_POSTERIOR_SUMMARY_H
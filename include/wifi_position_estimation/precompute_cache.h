@@ -0,0 +1,85 @@
+#ifndef PROJECT_PRECOMPUTE_CACHE_H
+#define PROJECT_PRECOMPUTE_CACHE_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include <wifi_position_estimation/precomputed_table.h>
+
+/**
+ * CacheKey class
+ * FNV-1a hash of everything a cache file depends on.
+ */
+class CacheKey
+{
+public:
+  CacheKey() : hash_(14695981039346656037ull) {}
+
+  void add(const void *data, size_t size);
+
+  template<class T>
+  void add(const T &value) { add(&value, sizeof(T)); }
+
+  void add(const std::string &value) { add(value.data(), value.size()); }
+
+  uint64_t value() const { return hash_; }
+
+private:
+  uint64_t hash_;
+};
+
+/**
+ * PrecomputeCache class
+ * Stores the precomputed random points and their PrecomputedTable in a versioned binary file, named after a CacheKey.
+ * Loading maps the file read-only, so the table is used without reading or copying it, and several estimators on one
+ * host share the pages. Files are written to a temporary name and renamed, so a reader never maps a partial file.
+ */
+class PrecomputeCache
+{
+public:
+  /// Incremented whenever the layout of the file changes
+  static const uint32_t VERSION = 1;
+
+  PrecomputeCache();
+  ~PrecomputeCache();
+
+  PrecomputeCache(const PrecomputeCache &) = delete;
+  PrecomputeCache &operator=(const PrecomputeCache &) = delete;
+
+  /// Path of the file of a key in a directory
+  static std::string file_name(const std::string &directory, uint64_t key);
+
+  /**
+   * Maps a file and attaches the table to it. The mapping is kept until the next load or the destruction of the cache,
+   * and the table must not be used after that.
+   * @param file Path of the file
+   * @param key Key the file has to have been written with
+   * @param n_aps Number of access points the file has to contain
+   * @param precision Storage format the file has to contain
+   * @param points Will be set to the precomputed points
+   * @param table Will be attached to the mapped values
+   * @return false if the file does not exist or does not match
+   */
+  bool load(const std::string &file, uint64_t key, int n_aps, PrecomputedTable::Precision precision,
+            std::vector<Eigen::Vector2d> &points, PrecomputedTable &table);
+
+  /**
+   * Writes the points and the table to a file.
+   * @param file Path of the file
+   * @param key Key of the data
+   * @param points Precomputed points
+   * @param table Their table
+   * @return false if the file could not be written
+   */
+  static bool save(const std::string &file, uint64_t key, const std::vector<Eigen::Vector2d> &points,
+                   const PrecomputedTable &table);
+
+private:
+  void *mapping_;
+  size_t size_;
+
+  void unmap();
+};
+
+#endif //PROJECT_PRECOMPUTE_CACHE_H
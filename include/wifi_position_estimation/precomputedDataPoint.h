@@ -5,15 +5,12 @@
 #ifndef PROJECT_PRECOMPUTEDDATAPOINT_H
 #define PROJECT_PRECOMPUTEDDATAPOINT_H
 
-class Process;
-
 /**
  * PrecomputedDataPoint struct
- * Holds a gaussian process and the precomputed mean and variance.
+ * Holds the precomputed mean and variance of a gaussian process.
  */
 struct PrecomputedDataPoint
 {
-  Process* gp_;
   double mean_;
   double variance_;
 };
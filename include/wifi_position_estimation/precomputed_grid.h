@@ -0,0 +1,115 @@
+#ifndef PROJECT_PRECOMPUTED_GRID_H
+#define PROJECT_PRECOMPUTED_GRID_H
+#include <vector>
+#include <Eigen/Dense>
+#include <nav_msgs/OccupancyGrid.h>
+
+class Process;
+
+/**
+ * PrecomputedGrid class
+ * Holds the mean and variance of every Gaussian process on a regular lattice over the free space of the map. The values
+ * for arbitrary positions are computed by bilinear interpolation of the four surrounding lattice nodes, so positions
+ * can be evaluated without calling the Gaussian processes.
+ */
+class PrecomputedGrid
+{
+public:
+  PrecomputedGrid();
+
+  /**
+   * Lays the lattice over the given map and marks the nodes that lie in free space.
+   * @param map Map of the environment
+   * @param resolution Distance between two neighbouring lattice nodes in meters
+   */
+  void set_geometry(const nav_msgs::OccupancyGrid &map, double resolution);
+
+  /**
+   * Computes the mean and variance of all given processes for every node that is needed for the interpolation of free
+   * space. The position of a process in the vector is the index it is referred to by afterwards.
+   * @param processes Gaussian processes
+   */
+  void compute(const std::vector<Process> &processes);
+
+  /**
+   * Interpolates the mean and variance of a process at the given position.
+   * @param ap Index of the process
+   * @param x x coordinate
+   * @param y y coordinate
+   * @param mean Will be set to the interpolated mean
+   * @param variance Will be set to the interpolated variance
+   * @return false if the position is outside of the precomputed area
+   */
+  bool interpolate(int ap, double x, double y, double &mean, double &variance) const;
+
+  /**
+   * Checks whether the position is in free space and can be interpolated.
+   * @param x x coordinate
+   * @param y y coordinate
+   * @return true if the position can be used as a particle
+   */
+  bool is_free(double x, double y) const;
+
+  /**
+   * Position of a lattice node.
+   * @param col column of the node
+   * @param row row of the node
+   * @return position in map coordinates
+   */
+  Eigen::Vector2d node_position(int col, int row) const;
+
+  /**
+   * Checks whether a node lies in free space of the map.
+   */
+  bool is_free_node(int col, int row) const { return free_[row * cols_ + col]; }
+
+  /**
+   * Checks whether the tables were computed for a node.
+   */
+  bool is_computed_node(int col, int row) const { return computed_[row * cols_ + col]; }
+
+  /// Precomputed mean of a process at a node
+  double node_mean(int col, int row, int ap) const { return mean_[(row * cols_ + col) * n_aps_ + ap]; }
+
+  /// Precomputed variance of a process at a node
+  double node_variance(int col, int row, int ap) const { return variance_[(row * cols_ + col) * n_aps_ + ap]; }
+
+  int cols() const { return cols_; }
+  int rows() const { return rows_; }
+  int n_aps() const { return n_aps_; }
+  double resolution() const { return resolution_; }
+
+private:
+  /// Position of the node in column 0 and row 0
+  double origin_x_;
+  double origin_y_;
+
+  /// Distance between two neighbouring nodes
+  double resolution_;
+
+  int cols_;
+  int rows_;
+
+  /// Number of processes in the tables
+  int n_aps_;
+
+  /// Marks the nodes that lie in free space of the map
+  std::vector<char> free_;
+
+  /// Marks the nodes the tables were computed for. These are the free nodes and their neighbours.
+  std::vector<char> computed_;
+
+  /// Means of all nodes. Stored node after node, each node holding the values of all processes.
+  std::vector<double> mean_;
+
+  /// Variances of all nodes, same layout as mean_.
+  std::vector<double> variance_;
+
+  /**
+   * Finds the cell that contains the given position.
+   * @return false if the position is not inside a cell whose four nodes were computed
+   */
+  bool cell(double x, double y, int &col, int &row, double &u, double &v) const;
+};
+
+#endif //PROJECT_PRECOMPUTED_GRID_H
@@ -0,0 +1,147 @@
+#ifndef PROJECT_PRECOMPUTED_TABLE_H
+#define PROJECT_PRECOMPUTED_TABLE_H
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <wifi_position_estimation/precomputedDataPoint.h>
+#include <wifi_position_estimation/gaussian_process/gaussian_process.h>
+
+/**
+ * PrecomputedTable class
+ * Means and variances of the processes at the precomputed random points, stored point after point. Besides doubles,
+ * the table can store floats, or 16 bit fixed point values with a scale and offset per access point chosen from the
+ * range of its values. The fixed point format stores the log of the variance, so small variances keep their relative
+ * precision. The values are converted back while scoring. Instead of owning its values, the table can also point into
+ * memory owned by someone else, like a mapped PrecomputeCache file.
+ */
+class PrecomputedTable
+{
+public:
+  enum Precision {DOUBLE, FLOAT, FIXED16};
+
+  PrecomputedTable();
+
+  /// Not copyable, the pointers to the values would still point into the original.
+  PrecomputedTable(const PrecomputedTable &) = delete;
+  PrecomputedTable &operator=(const PrecomputedTable &) = delete;
+
+  /**
+   * Parses the name of a precision.
+   * @param name "double", "float" or "fixed16"
+   * @param precision Will be set to the precision
+   * @return false if the name is unknown
+   */
+  static bool parse_precision(const std::string &name, Precision &precision);
+
+  /**
+   * Converts and stores the data.
+   * @param data Point-major means and variances of n_points points and n_aps access points
+   * @param n_points Number of points
+   * @param n_aps Number of access points
+   * @param precision Storage format
+   */
+  void build(const std::vector<PrecomputedDataPoint> &data, int n_points, int n_aps, Precision precision);
+
+  /// Mean and variance of an access point at a point
+  void get(int point, int ap, double &mean, double &variance) const
+  {
+    size_t i = size_t(point) * n_aps_ + ap;
+    switch(precision_)
+    {
+      case DOUBLE:
+        mean = doubles_data_[i].mean_;
+        variance = doubles_data_[i].variance_;
+        break;
+      case FLOAT:
+        mean = floats_data_[2 * i];
+        variance = floats_data_[2 * i + 1];
+        break;
+      case FIXED16:
+        mean = mean_offset_[ap] + mean_scale_[ap] * fixed_data_[2 * i];
+        variance = exp(log_variance_offset_[ap] + log_variance_scale_[ap] * fixed_data_[2 * i + 1]);
+        break;
+    }
+  }
+
+  /// Log probability of a signal strength of an access point at a point, see Process::log_probability_precomputed
+  double log_probability(int point, int ap, double strength) const
+  {
+    if(precision_ != FIXED16)
+    {
+      double mean;
+      double variance;
+      get(point, ap, mean, variance);
+      return Process::log_probability_precomputed(mean, variance, strength);
+    }
+
+    // The stored log variance saves the log of the analytic formula.
+    size_t i = size_t(point) * n_aps_ + ap;
+    double mean = mean_offset_[ap] + mean_scale_[ap] * fixed_data_[2 * i];
+    double log_variance = log_variance_offset_[ap] + log_variance_scale_[ap] * fixed_data_[2 * i + 1];
+    double residual = Process::normalize_observation(strength) - mean;
+    return -0.5 * (log(2.0 * M_PI) + log_variance) - 0.5 * residual * residual * exp(-log_variance);
+  }
+
+  bool empty() const { return n_points_ == 0; }
+
+  int points() const { return n_points_; }
+
+  int aps() const { return n_aps_; }
+
+  Precision precision() const { return precision_; }
+
+  size_t bytes() const;
+
+  /**
+   * Writes the scales and the values in the layout attach expects.
+   * @param out Stream to write to
+   * @return false if writing failed
+   */
+  bool write(std::ostream &out) const;
+
+  /**
+   * Uses values written by write without copying them. The memory has to stay valid and unchanged while the table is
+   * used, and has to be aligned to 8 bytes.
+   * @param begin Start of the written data
+   * @param size Size of the memory at begin
+   * @param n_points Number of points
+   * @param n_aps Number of access points
+   * @param precision Storage format the data was written with
+   * @return false if size does not match
+   */
+  bool attach(const char *begin, size_t size, int n_points, int n_aps, Precision precision);
+
+private:
+  Precision precision_;
+  int n_points_;
+  int n_aps_;
+
+  std::vector<PrecomputedDataPoint> doubles_;
+
+  /// Means and variances, interleaved
+  std::vector<float> floats_;
+
+  /// Quantized means and log variances, interleaved
+  std::vector<uint16_t> fixed_;
+
+  /// Values used by get, pointing into the vectors above or into attached memory
+  const PrecomputedDataPoint *doubles_data_;
+  const float *floats_data_;
+  const uint16_t *fixed_data_;
+
+  /// Bytes of the values, without the scales
+  size_t values_bytes() const;
+
+  void clear();
+
+  /// Value of a quantized mean or log variance is offset + scale * quantized, per access point
+  std::vector<double> mean_offset_;
+  std::vector<double> mean_scale_;
+  std::vector<double> log_variance_offset_;
+  std::vector<double> log_variance_scale_;
+};
+
+#endif //PROJECT_PRECOMPUTED_TABLE_H
@@ -0,0 +1,80 @@
+#ifndef PROJECT_RESULT_CACHE_H
+#define PROJECT_RESULT_CACHE_H
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <wifi_position_estimation/estimation_result.h>
+
+/**
+ * ResultCache class
+ * Least recently used cache of estimation results. Scans are canonicalized to their process indices in ascending
+ * order and their signal strengths rounded to multiples of the quantization, so that nearly identical scans share an
+ * entry. The class is not thread-safe.
+ */
+class ResultCache
+{
+public:
+  /// Canonical form of a scan: pairs of process indices and quantized signal strengths
+  typedef std::vector<std::pair<int, int>> Fingerprint;
+
+  /**
+   * Constructor
+   * @param capacity Maximum number of results. 0 or less disables the cache.
+   * @param quantization Width of the signal strength bins in dBm
+   */
+  ResultCache(int capacity = 0, double quantization = 3.0);
+
+  /**
+   * Computes the canonical form of a scan.
+   * @param observations Pairs of process indices and signal strengths in dBm
+   * @return Fingerprint of the scan
+   */
+  Fingerprint fingerprint(const std::vector<std::pair<int, double>> &observations) const;
+
+  /**
+   * Looks up the result of a scan and marks it as most recently used.
+   * @param fingerprint Fingerprint of the scan
+   * @param result Will be set to the cached result
+   * @return true on a hit
+   */
+  bool find(const Fingerprint &fingerprint, EstimationResult &result);
+
+  /**
+   * Stores a result, evicting the least recently used one if the cache is full.
+   * @param fingerprint Fingerprint of the scan
+   * @param result Result to store
+   */
+  void insert(const Fingerprint &fingerprint, const EstimationResult &result);
+
+  bool enabled() const { return capacity_ > 0; }
+  int size() const { return entries_.size(); }
+  long hits() const { return hits_; }
+  long misses() const { return misses_; }
+
+private:
+  struct Entry
+  {
+    uint64_t hash;
+    Fingerprint fingerprint;
+    EstimationResult result;
+  };
+
+  size_t capacity_;
+  double quantization_;
+  long hits_;
+  long misses_;
+
+  /// Entries, most recently used first
+  std::list<Entry> entries_;
+
+  /// Entries by the hash of their fingerprint. Entries with colliding hashes share a bucket.
+  std::unordered_multimap<uint64_t, std::list<Entry>::iterator> index_;
+
+  /// FNV-1a hash of a fingerprint
+  static uint64_t hash(const Fingerprint &fingerprint);
+};
+
+#endif //PROJECT_RESULT_CACHE_H
@@ -0,0 +1,35 @@
+#ifndef PROJECT_TRAINING_PARAMETERS_H
+#define PROJECT_TRAINING_PARAMETERS_H
+#include <cstdint>
+#include <string>
+#include <Eigen/Dense>
+
+/// Part of the key of stored parameters. Incremented whenever the training changes, so all processes are retrained.
+const uint32_t TRAINING_VERSION = 2;
+
+/**
+ * Hashes a training file together with the version of the training. The training starts from the parameters of the
+ * process and not from the configured initial hyperparameters, so those are not part of the key.
+ * @param file Path of the training file
+ * @return Key of the trained parameters
+ */
+uint64_t training_key(const std::string &file);
+
+/**
+ * Reads the stored hyperparameters of a process.
+ * @param file Path of the parameter file
+ * @param key Key of the current training data and configuration
+ * @param parameters Will be set to the hyperparameters
+ * @return false if the file does not exist or was written for another key
+ */
+bool read_parameters(const std::string &file, uint64_t key, Eigen::Vector4d &parameters);
+
+/**
+ * Stores the hyperparameters of a process together with the key they were trained for.
+ * @param file Path of the parameter file
+ * @param key Key of the training data and configuration
+ * @param parameters Trained hyperparameters
+ */
+void write_parameters(const std::string &file, uint64_t key, const Eigen::Vector4d &parameters);
+
+#endif //PROJECT_TRAINING_PARAMETERS_H
@@ -2,6 +2,7 @@
 #define PROJECT_WIFI_POSITION_ESTIMATION_H
 #include <ros/init.h>
 #include <ros/node_handle.h>
+#include <ros/callback_queue.h>
 #include "gaussian_process/gaussian_process.h"
 #include "csv_data_loader.h"
 #include <nav_msgs/GetMap.h>
@@ -9,22 +10,113 @@
 #include <boost/filesystem.hpp>
 #include <std_srvs/Empty.h>
 #include <wifi_localization/WifiState.h>
+#include <wifi_localization/WifiState2.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
 #include <fstream>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <functional>
 #include <boost/filesystem.hpp>
 #include <wifi_localization/MaxWeight.h>
 #include <wifi_localization/PlotGP.h>
 #include <wifi_localization/WifiPositionEstimation.h>
+#include <wifi_localization/EstimatePose.h>
+#include <wifi_localization/EstimatePoseBatch.h>
 #include <wifi_position_estimation/precomputedDataPoint.h>
+#include <wifi_position_estimation/precomputed_grid.h>
+#include <wifi_position_estimation/likelihood_pyramid.h>
+#include <wifi_position_estimation/estimation_scheduler.h>
+#include <wifi_position_estimation/incremental_scorer.h>
+#include <wifi_position_estimation/result_cache.h>
+#include <wifi_position_estimation/grid_filter.h>
+#include <wifi_position_estimation/particle_tracker.h>
+#include <wifi_position_estimation/kidnapping_monitor.h>
+#include <wifi_position_estimation/posterior_summary.h>
+#include <wifi_position_estimation/likelihood_table.h>
+#include <wifi_position_estimation/precomputed_table.h>
+#include <wifi_position_estimation/precompute_cache.h>
+#include <wifi_position_estimation/model_bundle.h>
+#include <wifi_position_estimation/training_parameters.h>
+#include <wifi_localization/WifiPoseHypotheses.h>
+#include <geometry_msgs/PoseArray.h>
+#include <nav_msgs/Odometry.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include "mac_dictionary.h"
 
 using namespace boost::filesystem;
 
-/// This typedef is used to hold the precomputed data.
-typedef std::map< Eigen::Vector2d, std::map<std::string, PrecomputedDataPoint>, std::function<bool(const Vector2d&, const Vector2d&)> > PrecomputedDataMap;
+/**
+ * ApBounds struct
+ * Range of the means and variances a Gaussian process can predict. Used to bound the log likelihood of an observation.
+ */
+struct ApBounds
+{
+  double mean_min;
+  double mean_max;
+  double variance_min;
+  double variance_max;
+};
+
+/// Indices of the macs of a scan that have a Gaussian process, with their signal strengths. Sorted with the strongest
+/// signal first.
+typedef std::vector<std::pair<int, double>> Scan;
+
+/**
+ * SearchWindow struct
+ * Disc the local search is restricted to.
+ */
+struct SearchWindow
+{
+  double x;
+  double y;
+  double radius;
+};
+
+/**
+ * EstimationRequest struct
+ * Position estimation queued for the worker thread. It holds a snapshot of the scan and the amcl position at the time
+ * it was requested.
+ */
+struct EstimationRequest
+{
+  /// What is published, once the estimation is finished
+  enum Target
+  {
+    /// Triggered by a high max weight, publishes the pose on initialpose
+    TRIGGERED,
+    /// Requested by the compute_amcl_start_point service, publishes the pose on initialpose
+    INITIAL_POSE,
+    /// Requested by the wifi_position_estimation service, publishes the comparison with amcl
+    ACCURACY_DATA,
+    /// Requested by the estimate_pose service, nothing is published
+    RESPONSE_ONLY
+  };
 
-///Comparison function for Vector2d. This is needed so that Vector2d can be used as a map key.
-auto cmp = [](const Vector2d& a, const Vector2d& b) { return a.norm() < b.norm(); };
+  Target target;
+  std::shared_ptr<const Scan> scan;
+  /// Key of the scan in the result cache
+  ResultCache::Fingerprint fingerprint;
+  double amcl_x;
+  double amcl_y;
+  /// Search within window first and only search globally, if the best position there is implausible
+  bool local;
+  SearchWindow window;
+  /// Use the anytime estimation, which stops at the deadline
+  bool anytime;
+  std::chrono::steady_clock::time_point deadline;
+  /// Publish improved estimates of the anytime estimation while it is running
+  bool publish_intermediate;
+  /// Set to the result by the worker thread
+  std::shared_ptr<std::promise<EstimationResult>> result;
+};
 
 /**
  * WifiPositionEstimation class
@@ -41,12 +133,25 @@ public:
    */
   WifiPositionEstimation(ros::NodeHandle &n);
 
+  /**
+   * Destructor
+   * Stops the worker thread. Requests that are still queued are dropped.
+   */
+  ~WifiPositionEstimation();
+
   /**
    * Computes a random position on the current map.
    * @return random position as Vector
    */
   Eigen::Vector2d random_position();
 
+  /**
+   * Computes a random position in the free space of the precomputed grid.
+   * @param position Will be set to the random position
+   * @return false if no free position was found within a number of tries
+   */
+  bool random_free_position(Eigen::Vector2d &position);
+
   bool publish_accuracy_data(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
 
 private:
@@ -67,12 +172,289 @@ private:
   /// When max_weight from amcl, exceeds this threshold, the wifi position estimation is started.
   double quality_threshold_;
 
-  /// Signals that a new position is already estimated, to stop it from starting multiple estimations.
-  bool computing_;
+  /// State of the worker thread
+  enum WorkerState
+  {
+    /// Waiting for requests
+    IDLE,
+    /// Requests are queued, but the worker did not take them yet
+    QUEUED,
+    /// Estimating a position
+    COMPUTING,
+    /// The worker thread is told to exit
+    STOPPING
+  };
+
+  /// Guarded by mutex_
+  WorkerState state_;
+
+  /// Decides which triggers by max weight start an estimation. Guarded by mutex_.
+  EstimationScheduler scheduler_;
+
+  /// Minimum time in seconds between two triggered estimations. 0 disables the limit.
+  double min_trigger_interval_;
+
+  /// Share of cpu time the triggered estimations may use within trigger_budget_window_. 0 disables the budget.
+  double trigger_cpu_budget_;
+
+  /// Length in seconds of the sliding window for trigger_cpu_budget_
+  double trigger_budget_window_;
+
+  /// Default deadline in seconds for all estimations. If it is greater than 0, the anytime estimation is used for
+  /// every request.
+  double anytime_deadline_;
+
+  /// Number of particles the anytime estimation scores between two checks of the deadline
+  int anytime_batch_size_;
+
+  /// Publish improved estimates of the anytime estimation on wifi_pos_estimation_intermediate
+  bool publish_intermediate_;
+
+  /// Results of previous scans. Guarded by mutex_.
+  ResultCache result_cache_;
+
+  /// Maximum number of cached results. 0 disables the cache.
+  int result_cache_size_;
+
+  /// Width of the signal strength bins of the cache keys in dBm
+  double result_cache_quantization_;
+
+  /// Fuse every scan into grid_filter_ and publish its estimate. Needs the grid precompute mode.
+  bool streaming_filter_;
+
+  /// Standard deviation in meters of the motion noise per meter traveled according to odometry
+  double filter_motion_noise_;
+
+  /// Standard deviation in meters of the motion assumed between two scans in addition to the odometry
+  double filter_scan_noise_;
+
+  /// Share of a uniform distribution mixed into the belief in every prediction step
+  double filter_uniform_mix_;
+
+  /// Belief over the nodes of precomputed_grid_. Guarded by filter_mutex_.
+  GridFilter grid_filter_;
+
+  /// Distance traveled according to odometry since the last scan. Guarded by filter_mutex_.
+  double odom_distance_;
+
+  /// Last odometry position, used to compute odom_distance_. Guarded by filter_mutex_.
+  Eigen::Vector2d last_odom_;
+  bool has_odom_;
+
+  /// Protects the grid filter and the odometry. Separate from mutex_, so the filter does not block queued requests.
+  std::mutex filter_mutex_;
+
+  /// Track the robot with the particle filter between relocalizations
+  bool tracking_;
+
+  /// Particle counts of the tracker once converged and while searching
+  int tracker_min_particles_;
+  int tracker_max_particles_;
+
+  /// Standard deviation of the tracker particles in meters, below which the tracker counts as converged
+  double tracker_converged_spread_;
+
+  /// Odometry noise of the tracker, per meter moved and per radian turned
+  double tracker_translation_noise_;
+  double tracker_rotation_noise_;
+
+  /// Particle filter, only used by the tracker thread
+  ParticleTracker tracker_;
+
+  /// Thread updating the tracker with every scan
+  std::thread tracker_thread_;
+
+  /// Latest scan the tracker did not process yet, nullptr if there is none. Guarded by tracker_mutex_.
+  std::shared_ptr<const Scan> tracker_scan_;
+  ros::Time tracker_scan_stamp_;
+
+  /// Latest odometry pose (x, y, yaw) and the one the tracker was last moved to. Guarded by tracker_mutex_.
+  Eigen::Vector3d latest_odom_pose_;
+  Eigen::Vector3d tracker_odom_pose_;
+  bool has_tracker_odom_;
+
+  /// Tells the tracker thread to exit. Guarded by tracker_mutex_.
+  bool tracker_stop_;
+
+  std::mutex tracker_mutex_;
+
+  /// Notifies the tracker thread about new scans and about stopping
+  std::condition_variable tracker_scan_added_;
+
+  /// Check every scan at the pose of amcl and start a global estimation, if it does not fit
+  bool kidnapping_monitor_;
+
+  /// Radius in meters of the ring of points around the amcl pose the monitor evaluates as well
+  double monitor_ring_radius_;
+
+  /// Number of points on the ring
+  int monitor_ring_points_;
+
+  /// Plausibility of the scans at the amcl pose. Guarded by mutex_.
+  KidnappingMonitor monitor_;
+
+  /// Whether an amcl pose was received. Guarded by mutex_.
+  bool has_amcl_pose_;
+
+  /// Latest max weight of amcl. amcl is trusted, while it does not exceed quality_threshold_. Guarded by mutex_.
+  double last_max_weight_;
+
+  /// Whether a max weight was received. amcl is not trusted before. Guarded by mutex_.
+  bool received_max_weight_;
+
+  /// Search around the last trusted amcl pose before searching the whole map
+  bool local_search_;
+
+  /// Radius of the search window in meters right after amcl was trusted
+  double local_search_radius_;
+
+  /// Growth of the radius in meters per second since amcl was trusted
+  double local_search_growth_;
+
+  /// Growth of the radius per meter traveled according to odometry since amcl was trusted
+  double local_search_odom_factor_;
+
+  /// Windows larger than this radius in meters are searched globally right away
+  double local_search_max_radius_;
+
+  /// Number of particles drawn in the window if the grid is not precomputed
+  int local_search_particles_;
+
+  /// Log likelihood per observation the best position of the window needs, unless the kidnapping monitor is
+  /// calibrated
+  double local_search_min_log_likelihood_;
+
+  /// Position and time of the last amcl pose received while amcl was trusted. Guarded by mutex_.
+  bool has_trusted_pose_;
+  Eigen::Vector2d trusted_position_;
+  ros::Time trusted_time_;
+
+  /// Distance traveled according to odometry since the last trusted amcl pose. Guarded by mutex_.
+  double trusted_odom_distance_;
+
+  /// Number of modes published as hypotheses, 0 disables the hypotheses
+  int hypotheses_;
+
+  /// Minimum distance between hypotheses in meters
+  double hypothesis_separation_;
+
+  /// Also publish the hypotheses as a PoseArray
+  bool publish_hypothesis_array_;
+
+  /// Lower bound of the variance of x and y in the published covariance, so a collapsed posterior does not make
+  /// consumers overconfident
+  double min_position_variance_;
+
+  /// Number of threads of the batch service, 0 uses one per core
+  int batch_threads_;
+
+  /// Number of threads that train the processes without valid stored parameters, 0 uses one per core
+  int training_threads_;
+
+  /// Number of positions whose means and variances are gathered at once by the batch service
+  int batch_block_size_;
+
+  /// Maximum number of likelihood heatmaps rendered per second, 0 disables the heatmap
+  double heatmap_rate_;
+
+  /// Size of the heatmap cells in meters
+  double heatmap_resolution_;
+
+  /// Score the precomputed random points with quantized lookup tables instead of the analytic log likelihood
+  bool likelihood_table_enabled_;
+
+  /// Memory budget of the lookup tables in megabytes
+  double likelihood_table_megabytes_;
+
+  /// Log likelihood of one quantization step of the lookup tables
+  double likelihood_table_resolution_;
+
+  LikelihoodTable likelihood_table_;
+
+  /// Scored positions of the current estimation, only used by the worker thread
+  PosteriorSummary posterior_;
+
+  /// Time of the last published diagnostics
+  ros::Time last_diagnostics_;
+
+  /// Requests waiting for the worker thread. Guarded by mutex_.
+  std::deque<EstimationRequest> requests_;
+
+  /// Protects the state of the worker, the queue, the latest scan and the amcl position
+  std::mutex mutex_;
+
+  /// Notifies the worker thread about new requests and about stopping
+  std::condition_variable request_added_;
+
+  /// Thread running the position estimations
+  std::thread worker_;
+
+  /// Seconds a service waits for its estimation, on top of the deadline of an anytime estimation. Negative values wait
+  /// until it is finished, 0 returns immediately. estimate_pose fails if its estimation did not finish in time.
+  double service_timeout_;
 
   /// Determines if the normal distributions for the random points on the map are going to be precomputed.
   bool precompute_;
 
+  /// Either "random_points" to precompute n_particles random points, or "grid" to precompute a regular lattice and
+  /// interpolate between its nodes.
+  std::string precompute_mode_;
+
+  /// Distance between the nodes of the precomputed grid in meters
+  double grid_resolution_;
+
+  /// Either "sampling" to evaluate n_particles random particles, or "branch_and_bound" to search the nodes of the
+  /// precomputed grid for the global maximum using the likelihood pyramid.
+  std::string search_mode_;
+
+  /// Number of importance resampling rounds after the initial particles. 0 disables the refinement.
+  int refinement_rounds_;
+
+  /// Number of particles per refinement round, including the initial round
+  int refinement_particles_;
+
+  /// Standard deviation in meters of the noise added to resampled particles in the first round
+  double refinement_spread_;
+
+  /// Factor the spread is multiplied with after each round
+  double refinement_shrink_;
+
+  /// The refinement stops, when the standard deviation of the particles falls below this value in meters
+  double refinement_min_spread_;
+
+  /// Number of the best particles the gradient refinement is started from. 0 disables the refinement.
+  int gradient_refinement_top_k_;
+
+  /// Maximum number of quasi-Newton steps per refined particle
+  int gradient_refinement_steps_;
+
+  /// Abandon particles as soon as the bounds of the remaining observations show, that they can not beat the best one.
+  /// The posterior covariance is not available then. Disabled if hypotheses are published.
+  bool early_termination_;
+
+  /// Maximum number of observed access points used per scan, the most informative ones are kept. 0 keeps all.
+  int max_aps_;
+
+  /// Access points are added in the order of their information, until their summed information reaches this budget.
+  /// 0 disables the budget.
+  double ap_information_budget_;
+
+  /// Keep the log likelihoods of a fixed particle set between scans and only rescore the access points that changed
+  bool incremental_scoring_;
+
+  /// Number of incremental updates after which all access points are rescored. 0 never rescores.
+  int incremental_full_rescore_;
+
+  /// Scores incremental_particles_, only used by the worker thread
+  IncrementalScorer incremental_scorer_;
+
+  /// Fixed particles of the incremental scoring. These are the random points or the free grid nodes if they are
+  /// precomputed, otherwise n_particles random positions.
+  std::vector<Eigen::Vector2d> incremental_particles_;
+
+  /// Random number generator used for the resampling noise
+  std::mt19937 random_engine_;
+
   /// Initial value for the noise parameter of the gaussian processes
   double init_noise_;
   /// Initial value for the variance parameter of the gaussian processes
@@ -85,41 +467,470 @@ private:
   /// Initial resolution for the plot of the gaussian process
   double gp_plot_resolution_;
 
-  /// Map of the precomputed data. Basic structure: map<position, std::map<mac, data_point>>
-  PrecomputedDataMap precomputed_data_;
+  /// Keep the precomputed random points and their table in a file in the cache directory of the training data
+  bool precompute_cache_enabled_;
+
+  /// Mapping of the cache file, which precomputed_table_ may point into. Declared first, so it is unmapped last.
+  PrecomputeCache precompute_cache_;
+
+  /// Precomputed data of the random points. Stored point after point, each point holding the data of all processes.
+  PrecomputedTable precomputed_table_;
+
+  /// Storage format of precomputed_table_: "double", "float" or "fixed16"
+  std::string precompute_precision_;
 
-  /// map of macs and corresponding Gaussian processes.
-  std::map<std::string, Process> gp_map_;
+  /// Number of recorded scans, whose most likely point is compared between doubles and a reduced precision at startup
+  int precision_check_scans_;
 
-  /// Vector of incoming signal strengths and the corresponding mac-addresses.
-  std::vector<std::pair<std::string, double>> macs_and_strengths_;
+  /// Path of the bundle of trained processes. Loaded instead of the csv files if it exists, written after them if not.
+  std::string model_bundle_file_;
+
+  /// Mapping of the model bundle, which processes_ may point into. Declared first, so it is unmapped last.
+  ModelBundle model_bundle_;
+
+  /// Gaussian processes, in the order of the indices of their macs in mac_dictionary_
+  std::vector<Process> processes_;
+
+  /// Assigns the index of its Gaussian process to each mac
+  MacDictionary mac_dictionary_;
+
+  /// Lattice of precomputed means and variances, used when precompute_mode_ is "grid"
+  PrecomputedGrid precomputed_grid_;
+
+  /// Range of the means and variances of each process, in the order of their indices
+  std::vector<ApBounds> ap_bounds_;
+
+  /// Expected information of an observation of each process, in the order of their indices
+  std::vector<double> ap_information_;
+
+  /// Pyramid over precomputed_grid_, used when search_mode_ is "branch_and_bound"
+  LikelihoodPyramid likelihood_pyramid_;
+
+  /// Latest scan. It is never modified after it was set, requests share it as their snapshot. Guarded by mutex_.
+  std::shared_ptr<const Scan> latest_scan_;
+
+  /// Header stamp of latest_scan_. Guarded by mutex_.
+  double latest_scan_stamp_;
 
   /// Vector of random points
   std::vector<Eigen::Vector2d> random_points_;
 
+  /// Mean and variance of a process, plotted by publish_gp_map_service. Guarded by gp_grid_map_mutex_.
   grid_map::GridMap gp_grid_map_;
 
+  /// Protects gp_grid_map_ against service calls of both spinner threads at once
+  std::mutex gp_grid_map_mutex_;
+
+  /// Log likelihood and posterior of the latest scan over the map, only used by heatmap_callback
+  grid_map::GridMap heatmap_grid_map_;
+
+  /// Cells of heatmap_grid_map_ in free space, the only ones that are rendered
+  std::vector<grid_map::Index> heatmap_cells_;
+
+  /// Means and variances of all processes at heatmap_cells_, stored cell after cell like in PrecomputedGrid
+  std::vector<double> heatmap_means_;
+  std::vector<double> heatmap_variances_;
+
+  /// Scan the heatmap was last rendered for
+  std::shared_ptr<const Scan> heatmap_scan_;
+
+  ros::Timer heatmap_timer_;
+
   ros::Publisher initialpose_pub_;
   ros::Publisher wifi_pos_estimation_pub_;
   ros::Publisher grid_map_publisher_;
+  ros::Publisher heatmap_pub_;
+  ros::Publisher diagnostics_pub_;
+  ros::Publisher intermediate_pub_;
+  ros::Publisher filter_pub_;
+  ros::Publisher tracker_pub_;
+  ros::Publisher hypotheses_pub_;
+  ros::Publisher hypothesis_array_pub_;
   ros::Subscriber wifi_sub_;
+  ros::Subscriber wifi_compact_sub_;
   ros::Subscriber max_weight_sub_;
   ros::Subscriber amcl_sub_;
+  ros::Subscriber odom_sub_;
   ros::ServiceServer compute_starting_point_service_;
   ros::ServiceServer publish_accuracy_data_service_;
   ros::ServiceServer publish_grid_map_service_;
+  ros::ServiceServer estimate_pose_service_;
+  ros::ServiceServer estimate_pose_batch_service_;
+
+  /// Queue of the services that wait for an estimation. A spinner thread of its own serves it, so waiting services,
+  /// however many and however long, never occupy the thread of the global queue and the subscribers keep running.
+  ros::CallbackQueue service_queue_;
+  std::unique_ptr<ros::AsyncSpinner> service_spinner_;
+
+  /// Queue of the batch service. A spinner thread of its own serves it, so a long batch neither occupies one of the
+  /// threads of the global queue nor delays the subscribers.
+  ros::CallbackQueue batch_queue_;
+  std::unique_ptr<ros::AsyncSpinner> batch_spinner_;
+
+  /**
+   * Advertises a service whose callbacks are served from the given queue instead of the global one.
+   * @param n Node handle
+   * @param name Name of the service
+   * @param callback Member function handling the calls
+   * @param queue Queue the calls are added to
+   * @return Server of the service
+   */
+  template<class Service>
+  ros::ServiceServer advertise_service(
+          ros::NodeHandle &n, const std::string &name,
+          bool (WifiPositionEstimation::*callback)(typename Service::Request &, typename Service::Response &),
+          ros::CallbackQueue *queue);
 
   bool publish_pose_service(std_srvs::Empty::Request  &req, std_srvs::Empty::Response &res);
   bool publish_gp_map_service(wifi_localization::PlotGP::Request &req, wifi_localization::PlotGP::Response &res);
+  bool estimate_pose_service(wifi_localization::EstimatePose::Request &req,
+                             wifi_localization::EstimatePose::Response &res);
+  bool estimate_pose_batch_service(wifi_localization::EstimatePoseBatch::Request &req,
+                                   wifi_localization::EstimatePoseBatch::Response &res);
   void wifi_callback(const wifi_localization::WifiState::ConstPtr& msg);
+  void wifi_compact_callback(const wifi_localization::WifiState2::ConstPtr& msg);
   void max_weight_callback(const wifi_localization::MaxWeight::ConstPtr& msg);
   void amcl_callback(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr& msg);
+  void odom_callback(const nav_msgs::Odometry::ConstPtr& msg);
+
+  /**
+   * Makes a scan the latest one and hands it to the streaming filter, the tracker and the kidnapping monitor.
+   * @param scan Scan resolved to process indices
+   * @param stamp Header stamp of the scan
+   */
+  void add_scan(const std::shared_ptr<const Scan> &scan, const ros::Time &stamp);
+
+  /**
+   * Asks the scheduler to start a global estimation and queues it if it may.
+   */
+  void trigger_estimation();
+
+  /**
+   * Checks whether the latest max weight of amcl was received and does not exceed quality_threshold_. mutex_ has to be
+   * locked.
+   * @return true if the pose of amcl can be trusted
+   */
+  bool amcl_trusted() const;
+
+  /**
+   * Evaluates a scan only at the amcl pose and a ring around it. Scans at trusted poses calibrate the monitor, and a
+   * global estimation is triggered if the scans do not fit the pose of amcl anymore.
+   * @param scan Latest scan
+   */
+  void monitor_scan(const Scan &scan);
+
+  /**
+   * Fuses a scan into the grid filter and publishes the mode and covariance of the belief. The belief is blurred by
+   * the odometry distance since the previous scan first.
+   * @param scan Scan to fuse
+   * @param stamp Time of the scan
+   */
+  void filter_scan(const Scan &scan, const ros::Time &stamp);
+
+  /**
+   * Main loop of the tracker thread. Moves the particles by the odometry since the previous scan, reweights them with
+   * the latest scan and publishes their mean and covariance. Scans arriving while the tracker is busy replace each
+   * other, so only the latest one is used.
+   */
+  void tracker_loop();
+
+  /**
+   * Computes the most likely pose. Only called by the worker thread.
+   * @param scan Scan to estimate the pose for
+   * @param result Will be set to the most likely pose and the hypotheses of the posterior. The remaining fields are
+   * left unchanged.
+   * @param window If not nullptr, the window is searched first and the whole map only if the result is implausible
+   * @return false if no position could be scored, for example because the map contains no free node
+   */
+  bool compute_pose(const Scan &scan, EstimationResult &result, const SearchWindow *window = nullptr);
+
+  /**
+   * Searches the free grid nodes within a window, or random particles within it if the grid is not precomputed.
+   * @param observations Pairs of indices and signal strengths
+   * @param window Window to search
+   * @param position Will be set to the best position
+   * @param log_likelihood Will be set to the log likelihood of the best position
+   * @return true if the best position is plausible
+   */
+  bool local_search(const std::vector<std::pair<int, double>> &observations, const SearchWindow &window,
+                    Eigen::Vector2d &position, double &log_likelihood);
+
+  /**
+   * Estimates the pose with coarse-to-fine particles that can be stopped at any time. Uniform particles are scored
+   * first, then resampling rounds refine the best ones. The deadline is checked after every anytime_batch_size_
+   * particles. The scored uniform particles make up the posterior, like the particles of compute_pose.
+   * @param scan Scan to estimate the pose for
+   * @param deadline The estimation returns the best position found so far, once this time has passed
+   * @param publish_intermediate Publish the best position, whenever it improved within a batch
+   * @return Best position, its log likelihood and the convergence of the particles
+   */
+  EstimationResult anytime_estimation(const Scan &scan, std::chrono::steady_clock::time_point deadline,
+                                      bool publish_intermediate);
+
+  /**
+   * Compares the most likely random point of recorded scans between the precomputed doubles and precomputed_table_,
+   * and reports how many changed.
+   * @param data Precomputed doubles
+   * @param recorded_scans Scans of the training data by their coordinates
+   */
+  void check_precision(const std::vector<PrecomputedDataPoint> &data,
+                       const std::map<std::pair<double, double>, Scan> &recorded_scans);
+
+  /**
+   * Resolves the macs of a scan message to the indices of their processes. Unknown macs are dropped.
+   * @param msg Scan message
+   * @return Scan sorted by descending signal strength
+   */
+  Scan scan_from_message(const wifi_localization::WifiState &msg);
+
+  /// Same as above for the compact message with packed bssids
+  Scan scan_from_message(const wifi_localization::WifiState2 &msg);
+
+  /**
+   * Resolves macs to the indices of their processes and sorts the scan, shared by both message types.
+   * @param macs mac addresses as strings or packed
+   * @param strengths Signal strengths in dBm, in the order of the macs
+   * @return Scan sorted by descending signal strength
+   */
+  template<class Macs, class Strengths>
+  Scan resolve_scan(const Macs &macs, const Strengths &strengths);
+
+  /**
+   * Estimates the positions of several scans at once. The scored positions are the precomputed points, the free nodes
+   * of the precomputed grid or n_particles_ random positions shared by all scans. Every thread scores a share of the
+   * scans with score_blocks.
+   * Does not use any state of the worker thread, so it can run next to it.
+   * @param scans Scans to localize
+   * @param positions Will be set to the most likely position of every scan
+   * @param log_likelihoods Will be set to the log likelihood of every position, minus infinity if a scan has no known
+   * access point
+   */
+  void batch_estimate(const std::vector<Scan> &scans, std::vector<Eigen::Vector2d> &positions,
+                      std::vector<double> &log_likelihoods);
+
+  /// Mean and variance of an access point at a scored position
+  typedef std::function<void(int point, int ap, double &mean, double &variance)> PositionData;
+
+  /// Receives the log likelihoods of a scan for a block of consecutive positions
+  typedef std::function<void(int scan, int first_point, const double *log_likelihoods, int n)> BlockScores;
+
+  /**
+   * Scoring engine of the batch service and the heatmap. The positions are processed in blocks of batch_block_size_.
+   * The means and variances of a block are gathered once for the access points of all scans, then every scan is
+   * scored against them while they are in the cache.
+   * @param observations Observations of the scans
+   * @param first_scan First scan to score
+   * @param last_scan One past the last scan to score
+   * @param first_point First position to score
+   * @param last_point One past the last position to score
+   * @param data Provides the means and variances of the positions
+   * @param scores Called with the log likelihoods of every scan for every block
+   */
+  void score_blocks(const std::vector<std::vector<std::pair<int, double>>> &observations, int first_scan,
+                    int last_scan, int first_point, int last_point, const PositionData &data,
+                    const BlockScores &scores);
+
+  /**
+   * Finds the cells of heatmap_grid_map_ in free space and computes the means and variances of all processes there
+   * once, interpolated from the precomputed grid if the grid is used. Called by the constructor.
+   * @param map Map of the environment
+   */
+  void precompute_heatmap(const nav_msgs::OccupancyGrid &map);
+
+  /**
+   * Checks whether a position lies in a free cell of a map. Unknown cells are not free.
+   * @param map Map of the environment
+   * @param position Position in map coordinates
+   * @return true if the position is inside the map and free
+   */
+  static bool map_free(const nav_msgs::OccupancyGrid &map, const Eigen::Vector2d &position);
+
+  /**
+   * Renders the log likelihood and the posterior of the latest scan over the free cells of the map and publishes them
+   * as layers on the wifi_heatmap topic. Skipped if there is no new scan.
+   */
+  void heatmap_callback(const ros::TimerEvent &event);
+
+  /**
+   * Creates the published pose message for a position.
+   * @param position Estimated position
+   * @return Pose with the default covariance of the estimation
+   */
+  geometry_msgs::PoseWithCovarianceStamped pose_from_position(const Eigen::Vector2d &position);
+
+  /**
+   * Replaces the default covariance of a pose with the covariance of posterior_ and summarizes its modes as hypotheses.
+   * The default covariance is kept, if the search did not record enough scored positions.
+   * @param pose Pose of the estimation
+   * @param hypotheses Will be set to the mean, covariance and modes of the posterior
+   * @return false if the hypotheses were not set, because there are too few scored positions or none are published
+   */
+  bool apply_posterior(geometry_msgs::PoseWithCovarianceStamped &pose,
+                       wifi_localization::WifiPoseHypotheses &hypotheses);
+
+  /**
+   * Queues a position estimation for the latest scan. Uses the anytime estimation if anytime_deadline_ is set.
+   * @param target What is published when the estimation is finished
+   * @return Future that becomes ready with the result
+   */
+  std::shared_future<EstimationResult> enqueue_request(EstimationRequest::Target target);
+
+  /**
+   * Queues a position estimation for the latest scan.
+   * @param target What is published when the estimation is finished
+   * @param anytime Use the anytime estimation
+   * @param deadline Seconds the anytime estimation may take from now on. 0 or less for no deadline.
+   * @param publish_intermediate Publish improved estimates of the anytime estimation
+   * @return Future that becomes ready with the result
+   */
+  std::shared_future<EstimationResult> enqueue_request(EstimationRequest::Target target, bool anytime, double deadline,
+                                                       bool publish_intermediate);
+
+  /// enqueue_request for callers that hold mutex_ already
+  std::shared_future<EstimationResult> enqueue_request_locked(EstimationRequest::Target target, bool anytime,
+                                                              double deadline, bool publish_intermediate);
+
+  /**
+   * Waits for the result of a request according to service_timeout_.
+   * @param result Future returned by enqueue_request
+   * @param deadline Seconds the estimation may take on top of service_timeout_, for anytime estimations
+   * @return false if the result did not become ready in time
+   */
+  bool wait_for_result(const std::shared_future<EstimationResult> &result, double deadline = 0.0);
+
+  /**
+   * Main loop of the worker thread. Takes the requests from the queue one after another, computes and publishes them.
+   */
+  void worker();
+
+  /**
+   * Publishes the trigger outcomes counted by the scheduler and the hits and misses of the result cache, at most once
+   * per second. mutex_ has to be locked.
+   * @param force Publish even if the last diagnostics were published less than a second ago
+   */
+  void publish_diagnostics(bool force);
+
+  /**
+   * Publishes the estimated pose of a request and the hypotheses of its posterior.
+   * @param request Finished request
+   * @param result Valid result of the request
+   */
+  void publish_result(const EstimationRequest &request, const EstimationResult &result);
+
+  /**
+   * Returns the observations of a scan. If max_aps_ or ap_information_budget_ are set, only the most informative
+   * access points are kept, sorted by their information.
+   * @param scan Scan to select the observations from
+   * @return Pairs of indices and signal strengths
+   */
+  std::vector<std::pair<int, double>> indexed_observations(const Scan &scan);
+
+  /**
+   * Computes ap_bounds_ from the precomputed data, or from the noise of the processes if nothing is precomputed.
+   */
+  void compute_ap_bounds();
+
+  /**
+   * Computes ap_information_. The information of a process grows with the variation of its mean over the map relative
+   * to its average predicted variance, and is reduced for processes trained on few observations.
+   */
+  void compute_ap_information();
+
+  /**
+   * Chooses incremental_particles_ and sets up incremental_scorer_ to read their means and variances.
+   */
+  void setup_incremental_scoring();
+
+  /**
+   * Upper bounds on the log likelihood that the observations from each position onwards can still contribute.
+   * @param observations Pairs of indices and signal strengths
+   * @return Vector with one more element than observations, the last one being 0
+   */
+  std::vector<double> remaining_log_likelihood_bounds(const std::vector<std::pair<int, double>> &observations);
+
+  /**
+   * Score a particle has to reach to be of any use.
+   * @param candidates Candidates kept for the gradient refinement
+   * @param highest_log_likelihood Highest log likelihood so far
+   */
+  double pruning_threshold(const std::vector<std::pair<double, Eigen::Vector2d>> &candidates,
+                           double highest_log_likelihood);
+
+  /**
+   * Log likelihood of the observations at an arbitrary position. Uses the precomputed grid if available, otherwise
+   * the Gaussian processes are evaluated directly.
+   * @param observations Pairs of indices and signal strengths
+   * @param position Position to evaluate
+   * @return log likelihood, or -infinity if the position is outside of the precomputed grid
+   */
+  double log_likelihood(const std::vector<std::pair<int, double>> &observations, const Eigen::Vector2d &position);
+
+  /**
+   * Log likelihood of the observations at a precomputed point, looked up in likelihood_table_ if it was built and in
+   * precomputed_table_ otherwise.
+   * @param observations Pairs of indices and signal strengths
+   * @param point Index of the point in random_points_
+   * @return log likelihood
+   */
+  double point_log_likelihood(const std::vector<std::pair<int, double>> &observations, int point);
+
+  /**
+   * Scores an initial set of random particles, then repeatedly resamples particles around the ones with the highest
+   * weights with a shrinking spread.
+   * @param observations Pairs of indices and signal strengths
+   * @param best_log_likelihood Will be set to the log likelihood of the most likely position, -inf if none was scored
+   * @return Most likely position
+   */
+  Eigen::Vector2d importance_resampling(const std::vector<std::pair<int, double>> &observations,
+                                        double &best_log_likelihood);
+
+  /**
+   * Draws particles proportional to the weights with systematic resampling and moves them by gaussian noise. Particles
+   * that would be moved out of free space keep the position of their parent.
+   * @param particles Particles to draw from
+   * @param log_weights Log weights of the particles
+   * @param n Number of particles to draw
+   * @param spread Standard deviation of the noise in meters
+   * @return Resampled particles
+   */
+  std::vector<Eigen::Vector2d> resample(const std::vector<Eigen::Vector2d> &particles,
+                                        const std::vector<double> &log_weights, int n, double spread);
+
+  /**
+   * Standard deviation of the particles around their weighted mean.
+   * @param particles Particles
+   * @param log_weights Log weights of the particles
+   * @return Spread in meters, infinity if all weights are 0
+   */
+  double weighted_spread(const std::vector<Eigen::Vector2d> &particles, const std::vector<double> &log_weights);
+
+  /**
+   * Log likelihood of the observations and its gradient, computed with the Gaussian processes.
+   * @param observations Pairs of indices and signal strengths
+   * @param position Position to evaluate
+   * @param gradient Will be set to the derivative of the log likelihood with respect to the position
+   * @return log likelihood
+   */
+  double log_likelihood_gradient(const std::vector<std::pair<int, double>> &observations,
+                                 const Eigen::Vector2d &position, Eigen::Vector2d &gradient);
+
+  /**
+   * Keeps the gradient_refinement_top_k_ candidates with the highest scores, sorted in descending order.
+   * @param candidates Pairs of scores and positions
+   * @param score Score of the new candidate
+   * @param position Position of the new candidate
+   */
+  void insert_candidate(std::vector<std::pair<double, Eigen::Vector2d>> &candidates, double score,
+                        const Eigen::Vector2d &position);
 
   /**
-   * Computes the most likely pose.
-   * @return Most likely pose.
+   * Moves each candidate to the nearby maximum of the log likelihood with BFGS steps.
+   * @param observations Pairs of indices and signal strengths
+   * @param candidates Pairs of scores and starting positions
+   * @return Refined position with the highest log likelihood
    */
-  geometry_msgs::PoseWithCovarianceStamped compute_pose();
+  Eigen::Vector2d gradient_refinement(const std::vector<std::pair<int, double>> &observations,
+                                      const std::vector<std::pair<double, Eigen::Vector2d>> &candidates);
 
 };
 #endif //PROJECT_WIFI_POSITION_ESTIMATION_H
@@ -2,8 +2,11 @@
 #define PROJECT_WIFIPUBLISHER_H
 
 #include <wifi_localization/WifiState.h>
+#include <wifi_localization/WifiState2.h>
+#include <wifi_localization/WifiSsidDictionary.h>
 #include "ros/ros.h"
 #include <wifi_publisher/wifi_scan.h>
+#include <unordered_map>
 
 struct WifiDataPoint
 {
@@ -18,15 +21,22 @@ struct WifiDataPoint
 class WifiPublisher
 {
 public:
-  WifiPublisher(ros::NodeHandle &nh, std::string wifi_interface, std::vector<unsigned int> channel_list, int ms_till_discard, int chans_per_scan);
+  WifiPublisher(ros::NodeHandle &nh, std::string wifi_interface, std::vector<unsigned int> channel_list, int ms_till_discard, int chans_per_scan, std::string message_format = "legacy");
   ~WifiPublisher();
   bool scan();
   void reset();
 private:
   unsigned int channel_to_freq(unsigned int channel);
   int freq_to_channel(unsigned int channel);
+  uint16_t ssid_index(const std::string &ssid);
   std::string wifi_interface_;
   ros::Publisher wifi_pub_;
+  ros::Publisher wifi_compact_pub_;
+  ros::Publisher ssid_dictionary_pub_;
+  bool publish_legacy_;
+  bool publish_compact_;
+  wifi_localization::WifiSsidDictionary ssid_dictionary_;
+  std::unordered_map<std::string, uint16_t> ssid_indices_;
   wifi_localization::WifiState wifi_data_old_;
   struct netlink_channel* channel_;
   struct bss_infos* scan_data_;
@@ -35,7 +45,7 @@ private:
   int chans_per_scan_;
   int current_frequency_;
   int sequential_failures_;
-  std::map<std::string, int> previous_signal_strength_;
+  std::unordered_map<uint64_t, int> previous_signal_strength_;
 };
 
 #endif //PROJECT_WIFIPUBLISHER_H
\ No newline at end of file
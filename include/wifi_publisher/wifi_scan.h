@@ -23,6 +23,7 @@ struct netlink_channel
 struct bss_info
 {
 	char bssid[BSSID_STRING_LENGTH]; //this is hardware mac address of your AP
+	uint64_t bssid_packed; //the same mac address packed into the lower 48 bits
 	char ssid[SSID_MAX_LENGTH_WITH_NULL]; //this is the name of your AP as you see it when connecting
 	int32_t frequency;
 	int32_t signal_mbm;  //signal strength in mBm, divide it by 100 to get signal in dBm
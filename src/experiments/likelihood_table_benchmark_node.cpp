@@ -0,0 +1,146 @@
+#include <ros/init.h>
+#include <ros/node_handle.h>
+#include <ros/ros.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <wifi_position_estimation/gaussian_process/gaussian_process.h>
+#include <wifi_position_estimation/likelihood_table.h>
+
+/**
+ * Compares the throughput and the accuracy of the likelihood tables with the analytic log likelihood on synthetic
+ * precomputed data, for several memory budgets.
+ */
+
+typedef std::vector<std::pair<int, double>> Scan;
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "likelihood_table_benchmark");
+  ros::NodeHandle n("~");
+
+  int n_points = 10000;
+  int n_aps = 200;
+  int n_scans = 50;
+  int observations_per_scan = 20;
+  double resolution = 0.01;
+  std::vector<double> budgets_megabytes = {4.5, 8.0, 16.0, 64.0};
+  n.param("points", n_points, n_points);
+  n.param("aps", n_aps, n_aps);
+  n.param("scans", n_scans, n_scans);
+  n.param("observations_per_scan", observations_per_scan, observations_per_scan);
+  n.param("resolution", resolution, resolution);
+  n.param("budgets_megabytes", budgets_megabytes, budgets_megabytes);
+
+  // Means and variances in the normalized units of the processes, about -100 to -30 dBm.
+  std::mt19937 random_engine(42);
+  std::uniform_real_distribution<double> mean_distribution(0.0, 0.7);
+  std::uniform_real_distribution<double> log_variance_distribution(log(0.001), log(0.05));
+  std::vector<PrecomputedDataPoint> data(size_t(n_points) * n_aps);
+  for(auto& it:data)
+    it = {mean_distribution(random_engine), exp(log_variance_distribution(random_engine))};
+
+  std::uniform_int_distribution<int> ap_distribution(0, n_aps - 1);
+  std::uniform_int_distribution<int> dbm_distribution(-95, -30);
+  std::vector<Scan> scans(n_scans);
+  for(auto& scan:scans)
+    for(int i = 0; i < observations_per_scan; i++)
+      scan.push_back(std::make_pair(ap_distribution(random_engine), double(dbm_distribution(random_engine))));
+
+  // Analytic path as in compute_pose
+  std::vector<double> analytic(size_t(n_scans) * n_points);
+  std::vector<int> analytic_best(n_scans);
+  auto start = std::chrono::steady_clock::now();
+  for(int s = 0; s < n_scans; s++)
+  {
+    double best = -std::numeric_limits<double>::infinity();
+    for(int point = 0; point < n_points; point++)
+    {
+      const PrecomputedDataPoint *point_data = &data[size_t(point) * n_aps];
+      double total = 0.0;
+      for(auto& observation:scans[s])
+      {
+        double log_prob = Process::log_probability_precomputed(point_data[observation.first].mean_,
+                                                               point_data[observation.first].variance_,
+                                                               observation.second);
+        if(!std::isnan(log_prob))
+          total += log_prob;
+      }
+      analytic[size_t(s) * n_points + point] = total;
+      if(total > best)
+      {
+        best = total;
+        analytic_best[s] = point;
+      }
+    }
+  }
+  double analytic_seconds = seconds_since(start);
+  double lookups = double(n_scans) * n_points * observations_per_scan;
+  ROS_INFO("analytic: %.1f MB, %.1f M observations/s", data.size() * sizeof(PrecomputedDataPoint) / 1048576.0,
+           lookups / analytic_seconds / 1e6);
+
+  for(auto& budget:budgets_megabytes)
+  {
+    LikelihoodTable table;
+    start = std::chrono::steady_clock::now();
+    if(!table.build(data, n_points, n_aps, size_t(budget * 1048576.0), resolution))
+    {
+      ROS_INFO("table, budget %.1f MB: does not fit", budget);
+      continue;
+    }
+    double build_seconds = seconds_since(start);
+
+    // Only the scoring is timed. The errors are computed from the stored totals afterwards.
+    std::vector<double> totals(size_t(n_scans) * n_points);
+    std::vector<int> table_best(n_scans);
+    start = std::chrono::steady_clock::now();
+    for(int s = 0; s < n_scans; s++)
+    {
+      std::vector<int> columns;
+      for(auto& observation:scans[s])
+        columns.push_back(LikelihoodTable::column(observation.second));
+
+      int best = 0;
+      int32_t best_quantized = std::numeric_limits<int32_t>::min();
+      for(int point = 0; point < n_points; point++)
+      {
+        int32_t quantized = 0;
+        for(size_t j = 0; j < scans[s].size(); j++)
+          quantized += table.row(point, scans[s][j].first)[columns[j]];
+        totals[size_t(s) * n_points + point] = table.log_likelihood(quantized);
+        if(quantized > best_quantized)
+        {
+          best_quantized = quantized;
+          best = point;
+        }
+      }
+      table_best[s] = best;
+    }
+    double table_seconds = seconds_since(start);
+
+    double max_error = 0.0;
+    double error_sum = 0.0;
+    int same_best = 0;
+    for(int s = 0; s < n_scans; s++)
+    {
+      same_best += table_best[s] == analytic_best[s];
+      for(size_t i = size_t(s) * n_points; i < size_t(s + 1) * n_points; i++)
+      {
+        double error = fabs(totals[i] - analytic[i]);
+        max_error = std::max(max_error, error);
+        error_sum += error;
+      }
+    }
+
+    ROS_INFO("table, budget %.1f MB: %.1f MB, %i clusters, step %.2f, built in %.2f s, %.1f M observations/s, "
+             "mean error %.3f, max error %.3f, same best point in %i of %i scans",
+             budget, table.bytes() / 1048576.0, table.clusters(), table.cluster_step(), build_seconds,
+             lookups / table_seconds / 1e6, error_sum / (double(n_scans) * n_points), max_error, same_best, n_scans);
+  }
+  return 0;
+}
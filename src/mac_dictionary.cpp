@@ -0,0 +1,88 @@
+#include "mac_dictionary.h"
+#include <set>
+#include <boost/filesystem.hpp>
+
+bool pack_mac(const std::string &mac, uint64_t &packed)
+{
+  packed = 0;
+  int digits = 0;
+  for(char c:mac)
+  {
+    int value;
+    if(c >= '0' && c <= '9')
+      value = c - '0';
+    else if(c >= 'a' && c <= 'f')
+      value = c - 'a' + 10;
+    else if(c >= 'A' && c <= 'F')
+      value = c - 'A' + 10;
+    else if((c == ':' || c == '_' || c == '-') && digits % 2 == 0)
+      continue;
+    else
+      return false;
+    packed = (packed << 4) | value;
+    digits++;
+  }
+  return digits == 12;
+}
+
+std::string unpack_mac(uint64_t packed, char separator)
+{
+  static const char hex[] = "0123456789abcdef";
+  std::string mac;
+  for(int byte = 5; byte >= 0; byte--)
+  {
+    int value = (packed >> (8 * byte)) & 0xff;
+    mac += hex[value >> 4];
+    mac += hex[value & 0xf];
+    if(byte > 0)
+      mac += separator;
+  }
+  return mac;
+}
+
+std::map<uint64_t, std::string> mac_files(const std::string &directory, std::vector<std::string> &ignored)
+{
+  // Sorted, so which of several files of one mac address is kept does not depend on the order of the directory.
+  std::set<std::string> names;
+  for(boost::filesystem::directory_iterator it(directory); it != boost::filesystem::directory_iterator(); ++it)
+  {
+    if(boost::filesystem::is_regular_file(it->status()))
+      names.insert(it->path().filename().generic_string());
+  }
+
+  std::map<uint64_t, std::string> files;
+  ignored.clear();
+  for(auto& name:names)
+  {
+    uint64_t packed;
+    std::string path = directory + "/" + name;
+    if(!pack_mac(name.substr(0, name.find_last_of(".")), packed) || !files.insert(std::make_pair(packed, path)).second)
+      ignored.push_back(path);
+  }
+  return files;
+}
+
+int MacDictionary::insert(uint64_t mac)
+{
+  auto it = indices_.find(mac);
+  if(it != indices_.end())
+    return it->second;
+  int index = macs_.size();
+  indices_[mac] = index;
+  macs_.push_back(mac);
+  return index;
+}
+
+int MacDictionary::index(uint64_t mac) const
+{
+  auto it = indices_.find(mac);
+  return it == indices_.end() ? -1 : it->second;
+}
+
+int MacDictionary::index(const std::string &mac) const
+{
+  uint64_t packed;
+  if(!pack_mac(mac, packed))
+    return -1;
+  return index(packed);
+}
@@ -91,7 +91,19 @@ MapCollection::MapCollection(ros::NodeHandle &n, std::string path_to_csv) : n_(n
 void MapCollection::add_data(int timestamp, std::string mac, double wifi_signal, int channel, std::string ssid,
                              geometry_msgs::PoseWithCovarianceStamped pose)
 {
-  std::map<std::string, MapData>::iterator data = get_map(mac);
+  uint64_t packed_mac;
+  if(!pack_mac(mac, packed_mac))
+  {
+    ROS_WARN("Ignoring malformed mac address: %s", mac.c_str());
+    return;
+  }
+  add_data(timestamp, packed_mac, wifi_signal, channel, ssid, pose);
+}
+
+void MapCollection::add_data(int timestamp, uint64_t packed_mac, double wifi_signal, int channel,
+                             const std::string &ssid, const geometry_msgs::PoseWithCovarianceStamped &pose)
+{
+  std::map<uint64_t, MapData>::iterator data = get_map(packed_mac);
   data->second.insert_data(timestamp, wifi_signal, channel, pose, ssid);
 }
 
@@ -106,20 +118,24 @@ void MapCollection::add_csv_data(std::string path)
       std::string file_path = path+"/"+itr->path().filename().generic_string();
       std::string mac = file_path.substr( file_path.find_last_of("/") + 1 );
       mac = mac.substr(0, mac.find_last_of("."));
-      std::map<std::string, MapData>::iterator data = get_map(mac);
+      uint64_t packed_mac;
+      if(!pack_mac(mac, packed_mac))
+        continue;
+      std::map<uint64_t, MapData>::iterator data = get_map(packed_mac);
       data->second.load_csv_data(file_path);
     }
   }
   ROS_INFO("Finished loading from csv-files.");
 }
 
-std::map<std::string, MapData>::iterator MapCollection::get_map(std::string mac)
+std::map<uint64_t, MapData>::iterator MapCollection::get_map(uint64_t packed_mac)
 {
-  std::map<std::string, MapData>::iterator data = mac_map_.find(mac);
+  std::map<uint64_t, MapData>::iterator data = mac_map_.find(packed_mac);
 
   // If there is no entry for this mac address yet, it is going to be created.
   if(data == mac_map_.end())
   {
+    std::string mac = unpack_mac(packed_mac);
     boost::shared_ptr<std::ofstream> new_mac = boost::make_shared<std::ofstream>();
     std::string filename = dir_ + mac + ".csv";
     bool new_file = true;
@@ -145,14 +161,14 @@ std::map<std::string, MapData>::iterator MapCollection::get_map(std::string mac)
 
     MapData temp(new_mac, wifi_map_pub, wifi_map_pub_2, wifi_map_pub_3, wifi_map_pub_4);
 
-    data = mac_map_.insert(mac_map_.begin(), std::make_pair(mac, temp));
+    data = mac_map_.insert(mac_map_.begin(), std::make_pair(packed_mac, temp));
   }
   return data;
 }
 
 bool MapCollection::publish_map_service(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
 {
-  for(std::map<std::string, MapData>::iterator i = mac_map_.begin(); i != mac_map_.end(); i++)
+  for(std::map<uint64_t, MapData>::iterator i = mac_map_.begin(); i != mac_map_.end(); i++)
   {
     i->second.publish_maps();
   }
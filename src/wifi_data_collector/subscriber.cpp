@@ -48,6 +48,8 @@ Subscriber::Subscriber(ros::NodeHandle &n, float map_resolution, std::string pat
   max_weight_sub_ = new message_filters::Subscriber<wifi_localization::MaxWeight>(n, "max_weight", 100);
   pose_sub_ = new message_filters::Subscriber<geometry_msgs::PoseWithCovarianceStamped>(n, "amcl_pose", 100);
   wifi_data_sub_ = n.subscribe("wifi_data", 1, &Subscriber::wifiCallbackMethod, this);
+  wifi_compact_data_sub_ = n.subscribe("wifi_data_compact", 1, &Subscriber::wifiCompactCallbackMethod, this);
+  ssid_dictionary_sub_ = n.subscribe("wifi_ssid_dictionary", 1, &Subscriber::ssidDictionaryCallbackMethod, this);
   odom_sub_ = n.subscribe("odom",1, &Subscriber::odomCallbackMethod, this);
   gps_sub_ = n.subscribe("gps_odom", 1, &Subscriber::gpsCallbackMethod, this);
 
@@ -78,7 +80,8 @@ void Subscriber::gpsCallbackMethod(const nav_msgs::Odometry::ConstPtr &msg)
 
 void Subscriber::wifiCallbackMethod(const wifi_localization::WifiState::ConstPtr& wifi_data_msg)
 {
-  if(use_gps_)
+  const geometry_msgs::PoseWithCovarianceStamped *pose = recording_pose(wifi_data_msg->macs.empty());
+  if(pose != nullptr)
   {
     for (int i = 0; i < wifi_data_msg->macs.size(); i++)
     {
@@ -86,21 +89,54 @@ void Subscriber::wifiCallbackMethod(const wifi_localization::WifiState::ConstPtr
       double wifi_dbm = wifi_data_msg->strengths.at(i);
       std::string ssid = wifi_data_msg->ssids.at(i);
 
-      maps.add_data(wifi_data_msg->header.stamp.sec, mac_name, wifi_dbm, wifi_data_msg->channels.at(i), ssid, gps_pose_);
+      maps.add_data(wifi_data_msg->header.stamp.sec, mac_name, wifi_dbm, wifi_data_msg->channels.at(i), ssid, *pose);
     }
   }
+  finish_wifi_data(pose);
+}
 
-  // Only record the data if max_weight is big enough and if user input mode is activated only if the user pressed the key to record.
-  else if ((((max_weight_ < threshold_ && record_) || (max_weight_ < threshold_ && record_next_)) && (!record_only_stopped_||(stands_still_ && wifi_data_since_stop_ > 1))) && !wifi_data_msg->macs.empty())
+void Subscriber::wifiCompactCallbackMethod(const wifi_localization::WifiState2::ConstPtr& wifi_data_msg)
+{
+  if(wifi_data_msg->ssid_dictionary_version > ssids_.version)
+    ROS_WARN("Received wifi data for ssid dictionary version %u, but only know version %u.",
+             wifi_data_msg->ssid_dictionary_version, ssids_.version);
+
+  const geometry_msgs::PoseWithCovarianceStamped *pose = recording_pose(wifi_data_msg->bssids.empty());
+  if(pose != nullptr)
   {
-    for (int i = 0; i < wifi_data_msg->macs.size(); i++)
+    for (int i = 0; i < wifi_data_msg->bssids.size(); i++)
     {
-      std::string mac_name = wifi_data_msg->macs.at(i);
-      double wifi_dbm = wifi_data_msg->strengths.at(i);
-      std::string ssid = wifi_data_msg->ssids.at(i);
+      int ssid_index = wifi_data_msg->ssid_indices.at(i);
+      std::string ssid = ssid_index < ssids_.ssids.size() ? ssids_.ssids.at(ssid_index) : "";
 
-      maps.add_data(wifi_data_msg->header.stamp.sec, mac_name, wifi_dbm, wifi_data_msg->channels.at(i), ssid, pose_);
+      maps.add_data(wifi_data_msg->header.stamp.sec, wifi_data_msg->bssids.at(i), wifi_data_msg->strengths.at(i),
+                    wifi_data_msg->channels.at(i), ssid, *pose);
     }
+  }
+  finish_wifi_data(pose);
+}
+
+void Subscriber::ssidDictionaryCallbackMethod(const wifi_localization::WifiSsidDictionary::ConstPtr& msg)
+{
+  ssids_ = *msg;
+}
+
+const geometry_msgs::PoseWithCovarianceStamped *Subscriber::recording_pose(bool empty_scan)
+{
+  if(use_gps_)
+    return &gps_pose_;
+
+  // Only record the data if max_weight is big enough and if user input mode is activated only if the user pressed the key to record.
+  if ((((max_weight_ < threshold_ && record_) || (max_weight_ < threshold_ && record_next_)) && (!record_only_stopped_||(stands_still_ && wifi_data_since_stop_ > 1))) && !empty_scan)
+    return &pose_;
+
+  return nullptr;
+}
+
+void Subscriber::finish_wifi_data(const geometry_msgs::PoseWithCovarianceStamped *pose)
+{
+  if(pose == &pose_)
+  {
     if(record_next_)
     {
       record_next_ = false;
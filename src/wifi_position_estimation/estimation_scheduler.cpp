@@ -0,0 +1,68 @@
+#include "wifi_position_estimation/estimation_scheduler.h"
+
+EstimationScheduler::EstimationScheduler(double min_interval, double cpu_budget, double budget_window)
+        : min_interval_(min_interval), cpu_budget_(cpu_budget), budget_window_(budget_window), running_(false),
+          pending_(false), last_start_(-1.0), last_scan_stamp_(-1.0), last_outcome_(NO_FRESH_SCAN)
+{
+  for(int i = 0; i < N_OUTCOMES; i++)
+    counts_[i] = 0;
+}
+
+EstimationScheduler::Outcome EstimationScheduler::trigger(double now, double scan_stamp)
+{
+  Outcome outcome = STARTED;
+  if(running_)
+    outcome = COALESCED;
+  else if(scan_stamp <= last_scan_stamp_)
+    outcome = NO_FRESH_SCAN;
+  else if(min_interval_ > 0.0 && last_start_ >= 0.0 && now - last_start_ < min_interval_)
+    outcome = TOO_SOON;
+  else if(cpu_budget_ > 0.0 && cpu_usage(now) >= cpu_budget_)
+    outcome = OVER_BUDGET;
+
+  if(outcome == COALESCED)
+    pending_ = true;
+  else if(outcome == STARTED)
+  {
+    running_ = true;
+    last_start_ = now;
+    last_scan_stamp_ = scan_stamp;
+  }
+  counts_[outcome]++;
+  last_outcome_ = outcome;
+  return outcome;
+}
+
+bool EstimationScheduler::finished(double now, double cpu_time, double scan_stamp)
+{
+  running_ = false;
+  history_.push_back(std::make_pair(now, cpu_time));
+  if(!pending_)
+    return false;
+  pending_ = false;
+  return trigger(now, scan_stamp) == STARTED;
+}
+
+double EstimationScheduler::cpu_usage(double now)
+{
+  while(!history_.empty() && history_.front().first < now - budget_window_)
+    history_.pop_front();
+
+  double cpu_time = 0.0;
+  for(auto& it:history_)
+    cpu_time += it.second;
+  return cpu_time / budget_window_;
+}
+
+std::string EstimationScheduler::outcome_name(Outcome outcome)
+{
+  switch(outcome)
+  {
+    case STARTED: return "started";
+    case COALESCED: return "coalesced";
+    case TOO_SOON: return "too_soon";
+    case OVER_BUDGET: return "over_budget";
+    case NO_FRESH_SCAN: return "no_fresh_scan";
+    default: return "unknown";
+  }
+}
@@ -11,7 +11,7 @@ ARD_SE_Kernel::ARD_SE_Kernel(double signal_noise, double signal_var, double leng
   set_parameters(signal_noise, signal_var, {lengthscale, lengthscale2});
 }
 
-double ARD_SE_Kernel::covariance(Vector2d &pos1, Vector2d &pos2)
+double ARD_SE_Kernel::covariance(const Vector2d &pos1, const Vector2d &pos2) const
 {
   int comp = 0;
   if(pos1 == pos2)
@@ -39,6 +39,13 @@ Matrix<double, 4, 1> ARD_SE_Kernel::gradient(Vector2d &pos1, Vector2d &pos2)
   return gradient;
 }
 
+Vector2d ARD_SE_Kernel::position_gradient(const Vector2d &pos1, const Vector2d &pos2) const
+{
+  Vector2d scaled = (pos1-pos2).cwiseQuotient(lengthscale_);
+  double k = signal_var_*exp(-0.5*scaled.squaredNorm());
+  return -k * scaled.cwiseQuotient(lengthscale_);
+}
+
 void ARD_SE_Kernel::set_parameters(double signal_noise, double signal_var, Vector2d lengthscale)
 {
   signal_noise_ = exp(signal_noise);
@@ -64,7 +71,7 @@ void ARD_SE_Kernel::set_parameters(double signal_noise, double signal_var, doubl
   orig_lengthscale_(1) = lengthscale2;
 }
 
-Vector4d ARD_SE_Kernel::get_parameters()
+Vector4d ARD_SE_Kernel::get_parameters() const
 {
   Vector4d parameters = {orig_signal_noise_, orig_signal_var_, orig_lengthscale_(0), orig_lengthscale_(1)};
   return parameters;
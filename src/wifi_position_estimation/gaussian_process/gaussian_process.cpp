@@ -4,8 +4,18 @@
 #include <grid_map_ros/grid_map_ros.hpp>
 #include <boost/progress.hpp>
 
+Process::Process(const Model &model) : ard_se_kernel_(model.params[0], model.params[1], model.params[2], model.params[3]),
+                                       n(model.n), x_mean_(model.x_mean), y_mean_(model.y_mean), x_std_(model.x_std),
+                                       y_std_(model.y_std), mapped_(true), mapped_coordinates_(model.coordinates),
+                                       mapped_observations_(model.observations), mapped_cholesky_(model.cholesky),
+                                       mapped_alpha_(model.alpha)
+{
+}
+
 Process::Process(Matrix<double, Dynamic, 2> &training_coords, Matrix<double, Dynamic, 1> &training_observs,
-                 double signal_noise, double signal_var, Vector2d lengthscale) : ard_se_kernel_(signal_noise, signal_var, lengthscale)
+                 double signal_noise, double signal_var, Vector2d lengthscale) : ard_se_kernel_(signal_noise, signal_var, lengthscale),
+                 mapped_(false), mapped_coordinates_(nullptr), mapped_observations_(nullptr), mapped_cholesky_(nullptr),
+                 mapped_alpha_(nullptr)
 {
   set_training_values(training_coords, training_observs);
   update_covariance_matrix();
@@ -20,6 +30,13 @@ void Process::train_params(Matrix<double, Dynamic, 1> starting_point)
 
 void Process::update_covariance_matrix()
 {
+  // A wrapped model has no covariance matrix to update, its arrays belong to someone else.
+  if(mapped_)
+  {
+    ROS_WARN("Parameters of a process that wraps a trained model cannot be changed");
+    return;
+  }
+
   for(int i = 0; i < n; i++)
   {
     for(int j = 0; j < n; j++)
@@ -33,59 +50,140 @@ void Process::update_covariance_matrix()
   }
 
   K_inv_ = K_.fullPivLu().solve(MatrixXd::Identity(n,n));
+  alpha_ = K_inv_ * training_observs_;
   //K_inv_ = K_.colPivHouseholderQr().solve(MatrixXd::Identity(n,n));
 }
 
-void Process::compute_cov_vector(double x, double y)
+Matrix<double, Dynamic, 1> Process::solve(const Matrix<double, Dynamic, 1> &vector) const
 {
-  Matrix<double, 2 ,1> pos1;
-  pos1 << x, y;
-  for(int i = 0; i < n; i++)
-  {
-    Matrix<double, 2, 1> pos2;
-    pos2 << training_coords_(i,0), training_coords_(i,1);
-    cov_vector_(i,0) = ard_se_kernel_.covariance(pos1, pos2);
-  }
+  if(!mapped_)
+    return K_inv_ * vector;
+
+  // K = L * L^T, so K^-1 * v = L^-T * (L^-1 * v)
+  Map<const Matrix<double, Dynamic, Dynamic>> L(mapped_cholesky_, n, n);
+  Matrix<double, Dynamic, 1> result = L.triangularView<Lower>().solve(vector);
+  L.transpose().triangularView<Upper>().solveInPlace(result);
+  return result;
 }
 
-double Process::probability(double x, double y, double z)
+Process::Model Process::model(Matrix<double, Dynamic, Dynamic> &cholesky) const
 {
-  x = (x - x_mean_)/x_std_;
-  y = (y- y_mean_)/y_std_;
-  z = (z+100.0)/(100.0);
-  Matrix<double, 2, 1> pos;
-  pos << x, y;
+  if(mapped_)
+    cholesky = Map<const Matrix<double, Dynamic, Dynamic>>(mapped_cholesky_, n, n);
+  else
+    cholesky = K_.llt().matrixL();
+
+  Vector4d params = ard_se_kernel_.get_parameters();
+  Model model;
+  model.n = n;
+  model.x_mean = x_mean_;
+  model.y_mean = y_mean_;
+  model.x_std = x_std_;
+  model.y_std = y_std_;
+  for(int i = 0; i < 4; i++)
+    model.params[i] = params(i);
+  model.coordinates = coordinates().data();
+  model.observations = training_observations().data();
+  model.cholesky = cholesky.data();
+  model.alpha = alpha().data();
+  return model;
+}
 
+double Process::probability(double x, double y, double z)
+{
   double mean;
   double variance;
-
-  compute_cov_vector(x, y);
-  mean = cov_vector_.transpose() * K_inv_ * training_observs_;
-  variance = ard_se_kernel_.covariance(pos, pos) - cov_vector_.transpose() * K_inv_ * cov_vector_;
+  predict(x, y, mean, variance);
+  z = normalize_observation(z);
 
   return ((1.0 / sqrt(2.0 * M_PI * fabs(variance))) * exp(-(pow(z-mean,2.0)/(2.0*fabs(variance)))));
 }
 
 double Process::probability_precomputed(double mean, double variance, double z)
 {
-  z = (z+100.0)/(100.0);
+  z = normalize_observation(z);
   return ((1.0 / sqrt(2.0 * M_PI * fabs(variance))) * exp(-(pow(z-mean,2.0)/(2.0*fabs(variance)))));
 }
 
+double Process::log_probability_precomputed(double mean, double variance, double z)
+{
+  z = normalize_observation(z);
+  return -0.5 * log(2.0 * M_PI * fabs(variance)) - (z-mean)*(z-mean)/(2.0*fabs(variance));
+}
+
+double Process::log_probability_bound(double mean_min, double mean_max, double variance_min, double variance_max,
+                                      double z)
+{
+  z = normalize_observation(z);
+  double distance = 0.0;
+  if(z < mean_min)
+    distance = mean_min - z;
+  else if(z > mean_max)
+    distance = z - mean_max;
+
+  // The log probability -0.5*log(2*pi*v) - d^2/(2v) is maximal for v = d^2, so the variance is clamped to its range.
+  double variance = std::max(std::min(distance * distance, variance_max), std::max(variance_min, 1e-12));
+  return -0.5 * log(2.0 * M_PI * variance) - distance * distance / (2.0 * variance);
+}
+
+double Process::noise_variance() const
+{
+  return exp(ard_se_kernel_.get_parameters()(0));
+}
+
 void Process::precompute_data(PrecomputedDataPoint& data, Eigen::Vector2d position)
 {
-  position(0) = (position(0) - x_mean_)/x_std_;
-  position(1) = (position(1) - y_mean_)/y_std_;
-  Matrix<double, 2, 1> pos;
-  pos << position(0), position(1);
-  compute_cov_vector(position(0), position(1));
-  data.mean_ = cov_vector_.transpose() * K_inv_ * training_observs_;
-  data.variance_ = ard_se_kernel_.covariance(position, position) - cov_vector_.transpose() * K_inv_ * cov_vector_;
+  predict(position(0), position(1), data.mean_, data.variance_);
+}
+
+void Process::predict(double x, double y, double &mean, double &variance) const
+{
+  Vector2d pos((x - x_mean_)/x_std_, (y - y_mean_)/y_std_);
+  Map<const Matrix<double, Dynamic, 2>> coords = coordinates();
+  Matrix<double, Dynamic, 1> cov_vector(n, 1);
+  for(int i = 0; i < n; i++)
+  {
+    Vector2d pos2(coords(i,0), coords(i,1));
+    cov_vector(i,0) = ard_se_kernel_.covariance(pos, pos2);
+  }
+  mean = cov_vector.dot(alpha());
+  if(mapped_)
+  {
+    // With K = L * L^T, cov^T * K^-1 * cov is the squared norm of L^-1 * cov.
+    Map<const Matrix<double, Dynamic, Dynamic>> L(mapped_cholesky_, n, n);
+    variance = ard_se_kernel_.covariance(pos, pos) - L.triangularView<Lower>().solve(cov_vector).squaredNorm();
+  }
+  else
+    variance = ard_se_kernel_.covariance(pos, pos) - cov_vector.dot(K_inv_ * cov_vector);
+}
+
+void Process::predict_with_gradient(double x, double y, double &mean, double &variance, Vector2d &mean_gradient,
+                                    Vector2d &variance_gradient) const
+{
+  Vector2d pos((x - x_mean_)/x_std_, (y - y_mean_)/y_std_);
+  Map<const Matrix<double, Dynamic, 2>> coords = coordinates();
+  Matrix<double, Dynamic, 1> cov_vector(n, 1);
+  Matrix<double, Dynamic, 2> cov_gradient(n, 2);
+  for(int i = 0; i < n; i++)
+  {
+    Vector2d pos2(coords(i,0), coords(i,1));
+    cov_vector(i,0) = ard_se_kernel_.covariance(pos, pos2);
+    cov_gradient.row(i) = ard_se_kernel_.position_gradient(pos, pos2).transpose();
+  }
+  Matrix<double, Dynamic, 1> k_inv_cov = solve(cov_vector);
+  mean = cov_vector.dot(alpha());
+  variance = ard_se_kernel_.covariance(pos, pos) - cov_vector.dot(k_inv_cov);
+
+  // The coordinates were normalized, so the chain rule adds the inverse standard deviations.
+  Vector2d normalization(1.0/x_std_, 1.0/y_std_);
+  mean_gradient = (cov_gradient.transpose() * alpha()).cwiseProduct(normalization);
+  variance_gradient = (-2.0 * cov_gradient.transpose() * k_inv_cov).cwiseProduct(normalization);
 }
 
 void Process::set_training_values(Matrix<double, Dynamic, 2> &training_coords, Matrix<double, Dynamic, 1> &training_observs)
 {
   n = training_coords.rows();
+  mapped_ = false;
   training_coords_.resize(n, 2);
   training_observs_.resize(n, 1);
 
@@ -100,7 +198,6 @@ void Process::set_training_values(Matrix<double, Dynamic, 2> &training_coords, M
   training_observs_ = (training_observs.array()+100.0)/(100.0);
 
   K_.resize(n,n);
-  cov_vector_.resize(n,1);
 }
 
 void Process::set_params(const Matrix<double, Dynamic, 1> &params)
@@ -186,25 +283,12 @@ void Process::create_gp_mean_map(grid_map::GridMap &map)
   for (grid_map::GridMapIterator it(map); !it.isPastEnd(); ++it) {
     grid_map::Position position;
     map.getPosition(*it, position);
-    double x = (position.x() - x_mean_)/x_std_;
-    double y = (position.y() - y_mean_)/y_std_;
-    compute_cov_vector(x,y);
-
-    double mean = cov_vector_.transpose() * K_inv_ * training_observs_;
-    //if(!(mean < 0.00001 && mean > -0.00001))
-    //{
-    //std::cout << mean << std::endl;
+    double mean;
+    double variance;
+    predict(position.x(), position.y(), mean, variance);
     map.at("gp_mean", *it) = mean;
     ++show_progress;
   }
-
-  //ros::Time time = ros::Time::now();
-
-  // Publish grid map.
-  //map.setTimestamp(time.toNSec());
-  //grid_map_msgs::GridMap message;
-  //grid_map::GridMapRosConverter::toMessage(map, message);
-  //return message;
 }
 
 void Process::create_gp_variance_map(grid_map::GridMap &map)
@@ -215,23 +299,10 @@ void Process::create_gp_variance_map(grid_map::GridMap &map)
   for (grid_map::GridMapIterator it(map); !it.isPastEnd(); ++it) {
     grid_map::Position position;
     map.getPosition(*it, position);
-    double x = (position.x() - x_mean_)/x_std_;
-    double y = (position.y() - y_mean_)/y_std_;
-    compute_cov_vector(x,y);
-    Matrix<double, 2, 1> pos;
-    pos << x, y;
-    double variance = 0.0;
-    variance = sqrt(ard_se_kernel_.covariance(pos, pos) - cov_vector_.transpose() * K_inv_ * cov_vector_);
-
-    map.at("gp_variance", *it) = variance;
+    double mean;
+    double variance;
+    predict(position.x(), position.y(), mean, variance);
+    map.at("gp_variance", *it) = sqrt(variance);
     ++show_progress;
   }
-
-  //ros::Time time = ros::Time::now();
-
-  // Publish grid map.
-  //map.setTimestamp(time.toNSec());
-  //grid_map_msgs::GridMap message;
-  //grid_map::GridMapRosConverter::toMessage(map, message);
-  //return message;
 }
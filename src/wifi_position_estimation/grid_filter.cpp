@@ -0,0 +1,145 @@
+#include "wifi_position_estimation/grid_filter.h"
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <cmath>
+#include <limits>
+
+void GridFilter::reset(const PrecomputedGrid &grid, double uniform_mix)
+{
+  grid_ = &grid;
+  uniform_mix_ = uniform_mix;
+  n_free_ = 0;
+  log_belief_.assign(grid.cols() * grid.rows(), -std::numeric_limits<double>::infinity());
+  for(int row = 0; row < grid.rows(); row++)
+  {
+    for(int col = 0; col < grid.cols(); col++)
+    {
+      if(grid.is_free_node(col, row))
+      {
+        log_belief_[row * grid.cols() + col] = 0.0;
+        n_free_++;
+      }
+    }
+  }
+}
+
+void GridFilter::normalize()
+{
+  double max_log_belief = -std::numeric_limits<double>::infinity();
+  for(auto& it:log_belief_)
+    max_log_belief = std::max(max_log_belief, it);
+  if(std::isinf(max_log_belief))
+    return;
+  for(auto& it:log_belief_)
+    it -= max_log_belief;
+}
+
+void GridFilter::predict(double sigma)
+{
+  int cols = grid_->cols();
+  int rows = grid_->rows();
+  double sigma_nodes = sigma / grid_->resolution();
+
+  std::vector<double> belief(log_belief_.size());
+  for(size_t i = 0; i < log_belief_.size(); i++)
+    belief[i] = exp(log_belief_[i]);
+
+  if(sigma_nodes > 0.1)
+  {
+    int radius = int(ceil(3.0 * sigma_nodes));
+    std::vector<double> kernel(2 * radius + 1);
+    for(int k = -radius; k <= radius; k++)
+      kernel[k + radius] = exp(-0.5 * k * k / (sigma_nodes * sigma_nodes));
+
+    // The gaussian is separable, so blurring the rows and then the columns costs O(nodes * radius).
+    std::vector<double> blurred(belief.size(), 0.0);
+    for(int row = 0; row < rows; row++)
+      for(int col = 0; col < cols; col++)
+        for(int k = std::max(-radius, -col); k <= std::min(radius, cols - 1 - col); k++)
+          blurred[row * cols + col] += kernel[k + radius] * belief[row * cols + col + k];
+
+    belief.assign(belief.size(), 0.0);
+    for(int row = 0; row < rows; row++)
+      for(int col = 0; col < cols; col++)
+        for(int k = std::max(-radius, -row); k <= std::min(radius, rows - 1 - row); k++)
+          belief[row * cols + col] += kernel[k + radius] * blurred[(row + k) * cols + col];
+  }
+
+  // Probability that was moved into obstacles is dropped, then a share of a uniform distribution is mixed in.
+  double sum = 0.0;
+  for(int row = 0; row < rows; row++)
+    for(int col = 0; col < cols; col++)
+      if(grid_->is_free_node(col, row))
+        sum += belief[row * cols + col];
+
+  for(int row = 0; row < rows; row++)
+  {
+    for(int col = 0; col < cols; col++)
+    {
+      int node = row * cols + col;
+      if(!grid_->is_free_node(col, row))
+        log_belief_[node] = -std::numeric_limits<double>::infinity();
+      else if(sum > 0.0)
+        log_belief_[node] = log((1.0 - uniform_mix_) * belief[node] / sum + uniform_mix_ / n_free_);
+      else
+        log_belief_[node] = 0.0;
+    }
+  }
+  normalize();
+}
+
+void GridFilter::update(const std::vector<std::pair<int, double>> &observations)
+{
+  for(int row = 0; row < grid_->rows(); row++)
+  {
+    for(int col = 0; col < grid_->cols(); col++)
+    {
+      if(!grid_->is_free_node(col, row))
+        continue;
+
+      double &log_belief = log_belief_[row * grid_->cols() + col];
+      for(auto& observation:observations)
+      {
+        double log_prob = Process::log_probability_precomputed(grid_->node_mean(col, row, observation.first),
+                                                               grid_->node_variance(col, row, observation.first),
+                                                               observation.second);
+        if(!std::isnan(log_prob))
+          log_belief += log_prob;
+      }
+    }
+  }
+  normalize();
+}
+
+bool GridFilter::estimate(Eigen::Vector2d &mode, Eigen::Vector2d &mean, Eigen::Matrix2d &covariance) const
+{
+  if(empty() || n_free_ == 0)
+    return false;
+
+  double sum = 0.0;
+  double best = -std::numeric_limits<double>::infinity();
+  mean = Eigen::Vector2d::Zero();
+  Eigen::Matrix2d second_moment = Eigen::Matrix2d::Zero();
+  for(int row = 0; row < grid_->rows(); row++)
+  {
+    for(int col = 0; col < grid_->cols(); col++)
+    {
+      double log_belief = log_belief_[row * grid_->cols() + col];
+      if(std::isinf(log_belief))
+        continue;
+
+      Eigen::Vector2d position = grid_->node_position(col, row);
+      double weight = exp(log_belief);
+      sum += weight;
+      mean += weight * position;
+      second_moment += weight * position * position.transpose();
+      if(log_belief > best)
+      {
+        best = log_belief;
+        mode = position;
+      }
+    }
+  }
+  mean /= sum;
+  covariance = second_moment / sum - mean * mean.transpose();
+  return true;
+}
@@ -0,0 +1,97 @@
+#include "wifi_position_estimation/incremental_scorer.h"
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <cmath>
+#include <limits>
+
+IncrementalScorer::IncrementalScorer() : n_particles_(0), full_rescore_interval_(0), updates_since_rescore_(0)
+{
+}
+
+void IncrementalScorer::reset(int n_particles, const Predictor &predictor, int full_rescore_interval)
+{
+  n_particles_ = n_particles;
+  predictor_ = predictor;
+  full_rescore_interval_ = full_rescore_interval;
+  updates_since_rescore_ = 0;
+  totals_.assign(n_particles_, 0.0);
+  scored_.clear();
+  columns_.clear();
+}
+
+const std::vector<PrecomputedDataPoint> &IncrementalScorer::column(int ap)
+{
+  auto it = columns_.find(ap);
+  if(it != columns_.end())
+    return it->second;
+
+  std::vector<PrecomputedDataPoint> &data = columns_[ap];
+  data.resize(n_particles_);
+  for(int particle = 0; particle < n_particles_; particle++)
+    predictor_(particle, ap, data[particle].mean_, data[particle].variance_);
+  return data;
+}
+
+void IncrementalScorer::add(int ap, double strength, double sign)
+{
+  const std::vector<PrecomputedDataPoint> &data = column(ap);
+  for(int particle = 0; particle < n_particles_; particle++)
+  {
+    double log_prob = Process::log_probability_precomputed(data[particle].mean_, data[particle].variance_, strength);
+    if(!std::isnan(log_prob))
+      totals_[particle] += sign * log_prob;
+  }
+}
+
+int IncrementalScorer::update(const std::vector<std::pair<int, double>> &observations)
+{
+  std::map<int, double> observed(observations.begin(), observations.end());
+  int updated = 0;
+
+  if(full_rescore_interval_ > 0 && ++updates_since_rescore_ >= full_rescore_interval_)
+  {
+    updates_since_rescore_ = 0;
+    totals_.assign(n_particles_, 0.0);
+    scored_.clear();
+  }
+
+  // Remove the terms of access points that disappeared or changed their signal strength.
+  for(auto it = scored_.begin(); it != scored_.end();)
+  {
+    auto current = observed.find(it->first);
+    if(current == observed.end() || current->second != it->second)
+    {
+      add(it->first, it->second, -1.0);
+      it = scored_.erase(it);
+      updated++;
+    }
+    else
+      ++it;
+  }
+
+  // Add the terms of new and changed access points.
+  for(auto& it:observed)
+  {
+    if(scored_.count(it.first) == 0)
+    {
+      add(it.first, it.second, 1.0);
+      scored_[it.first] = it.second;
+      updated++;
+    }
+  }
+  return updated;
+}
+
+int IncrementalScorer::best_particle() const
+{
+  int best = -1;
+  double best_log_likelihood = -std::numeric_limits<double>::infinity();
+  for(int particle = 0; particle < n_particles_; particle++)
+  {
+    if(totals_[particle] > best_log_likelihood)
+    {
+      best_log_likelihood = totals_[particle];
+      best = particle;
+    }
+  }
+  return best;
+}
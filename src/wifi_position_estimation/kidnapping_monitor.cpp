@@ -0,0 +1,44 @@
+#include "wifi_position_estimation/kidnapping_monitor.h"
+#include <algorithm>
+#include <cmath>
+
+KidnappingMonitor::KidnappingMonitor(double threshold, int min_samples, int consecutive_failures, double adaptation)
+        : threshold_(threshold), min_samples_(min_samples), consecutive_failures_(consecutive_failures),
+          adaptation_(adaptation), samples_(0), mean_(0.0), variance_(0.0), failures_(0), last_passed_(true)
+{
+}
+
+void KidnappingMonitor::calibrate(double statistic)
+{
+  if(std::isinf(statistic) || std::isnan(statistic))
+    return;
+
+  samples_++;
+  // Plain averages until the window of the exponential weights is filled, so the first samples are not overweighted.
+  double weight = std::max(adaptation_, 1.0 / samples_);
+  double difference = statistic - mean_;
+  mean_ += weight * difference;
+  variance_ = (1.0 - weight) * (variance_ + weight * difference * difference);
+}
+
+bool KidnappingMonitor::check(double statistic)
+{
+  last_passed_ = true;
+  if(!calibrated())
+    return false;
+
+  last_passed_ = statistic >= mean_ - threshold_ * sqrt(variance_);
+  if(last_passed_)
+  {
+    failures_ = 0;
+    return false;
+  }
+
+  failures_++;
+  if(failures_ >= consecutive_failures_)
+  {
+    failures_ = 0;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,176 @@
+#include "wifi_position_estimation/likelihood_pyramid.h"
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <ros/ros.h>
+
+void LikelihoodPyramid::build(const PrecomputedGrid &grid)
+{
+  grid_ = &grid;
+  levels_.clear();
+  int n_aps = grid.n_aps();
+  int child_cols = grid.cols();
+  int child_rows = grid.rows();
+
+  while(child_cols > 1 || child_rows > 1)
+  {
+    Level level;
+    level.cols = (child_cols + 1) / 2;
+    level.rows = (child_rows + 1) / 2;
+    int n_tiles = level.cols * level.rows;
+    level.mean_min.assign(n_tiles * n_aps, std::numeric_limits<double>::infinity());
+    level.mean_max.assign(n_tiles * n_aps, -std::numeric_limits<double>::infinity());
+    level.variance_min.assign(n_tiles * n_aps, std::numeric_limits<double>::infinity());
+    level.variance_max.assign(n_tiles * n_aps, -std::numeric_limits<double>::infinity());
+    level.free.assign(n_tiles, 0);
+
+    const Level *child_level = levels_.empty() ? nullptr : &levels_.back();
+
+    for(int row = 0; row < level.rows; row++)
+    {
+      for(int col = 0; col < level.cols; col++)
+      {
+        int tile = row * level.cols + col;
+        for(int child_row = 2 * row; child_row < std::min(2 * row + 2, child_rows); child_row++)
+        {
+          for(int child_col = 2 * col; child_col < std::min(2 * col + 2, child_cols); child_col++)
+          {
+            if(child_level == nullptr)
+            {
+              if(!grid.is_computed_node(child_col, child_row))
+                continue;
+              level.free[tile] |= grid.is_free_node(child_col, child_row);
+              for(int ap = 0; ap < n_aps; ap++)
+              {
+                double mean = grid.node_mean(child_col, child_row, ap);
+                double variance = fabs(grid.node_variance(child_col, child_row, ap));
+                int i = tile * n_aps + ap;
+                level.mean_min[i] = std::min(level.mean_min[i], mean);
+                level.mean_max[i] = std::max(level.mean_max[i], mean);
+                level.variance_min[i] = std::min(level.variance_min[i], variance);
+                level.variance_max[i] = std::max(level.variance_max[i], variance);
+              }
+            }
+            else
+            {
+              int child = child_row * child_level->cols + child_col;
+              level.free[tile] |= child_level->free[child];
+              for(int ap = 0; ap < n_aps; ap++)
+              {
+                int i = tile * n_aps + ap;
+                int j = child * n_aps + ap;
+                level.mean_min[i] = std::min(level.mean_min[i], child_level->mean_min[j]);
+                level.mean_max[i] = std::max(level.mean_max[i], child_level->mean_max[j]);
+                level.variance_min[i] = std::min(level.variance_min[i], child_level->variance_min[j]);
+                level.variance_max[i] = std::max(level.variance_max[i], child_level->variance_max[j]);
+              }
+            }
+          }
+        }
+      }
+    }
+
+    child_cols = level.cols;
+    child_rows = level.rows;
+    levels_.push_back(level);
+  }
+  ROS_INFO("Built likelihood pyramid with %i levels.", int(levels_.size()));
+}
+
+double LikelihoodPyramid::tile_bound(const std::vector<std::pair<int, double>> &observations, int level, int col,
+                                     int row) const
+{
+  double total = 0.0;
+  if(level == 0)
+  {
+    for(auto& observation:observations)
+    {
+      double log_prob = Process::log_probability_precomputed(grid_->node_mean(col, row, observation.first),
+                                                             grid_->node_variance(col, row, observation.first),
+                                                             observation.second);
+      if(!std::isnan(log_prob))
+        total += log_prob;
+    }
+    return total;
+  }
+
+  const Level &l = levels_[level - 1];
+  int tile = (row * l.cols + col) * grid_->n_aps();
+  for(auto& observation:observations)
+  {
+    int i = tile + observation.first;
+    double log_prob = Process::log_probability_bound(l.mean_min[i], l.mean_max[i], l.variance_min[i],
+                                                     l.variance_max[i], observation.second);
+    if(!std::isnan(log_prob))
+      total += log_prob;
+  }
+  return total;
+}
+
+int LikelihoodPyramid::search(const std::vector<std::pair<int, double>> &observations, Eigen::Vector2d &position,
+                              double &log_likelihood) const
+{
+  struct Tile
+  {
+    double bound;
+    int level;
+    int col;
+    int row;
+    bool operator<(const Tile &other) const { return bound < other.bound; }
+  };
+
+  // A grid of a single node has no levels.
+  if(levels_.empty())
+    return -1;
+
+  std::priority_queue<Tile> queue;
+  int evaluated = 0;
+
+  int top = levels_.size();
+  const Level &top_level = levels_.back();
+  for(int row = 0; row < top_level.rows; row++)
+  {
+    for(int col = 0; col < top_level.cols; col++)
+    {
+      if(top_level.free[row * top_level.cols + col])
+      {
+        queue.push({tile_bound(observations, top, col, row), top, col, row});
+        evaluated++;
+      }
+    }
+  }
+
+  // Best-first search: the bound of a node is its exact log likelihood, so the first node taken from the queue has a
+  // log likelihood at least as high as the bound of every tile that is still left.
+  while(!queue.empty())
+  {
+    Tile tile = queue.top();
+    queue.pop();
+
+    if(tile.level == 0)
+    {
+      position = grid_->node_position(tile.col, tile.row);
+      log_likelihood = tile.bound;
+      return evaluated;
+    }
+
+    int child_level = tile.level - 1;
+    int child_cols = child_level == 0 ? grid_->cols() : levels_[child_level - 1].cols;
+    int child_rows = child_level == 0 ? grid_->rows() : levels_[child_level - 1].rows;
+    for(int row = 2 * tile.row; row < std::min(2 * tile.row + 2, child_rows); row++)
+    {
+      for(int col = 2 * tile.col; col < std::min(2 * tile.col + 2, child_cols); col++)
+      {
+        bool free = child_level == 0 ? grid_->is_free_node(col, row)
+                                     : levels_[child_level - 1].free[row * child_cols + col];
+        if(free)
+        {
+          queue.push({tile_bound(observations, child_level, col, row), child_level, col, row});
+          evaluated++;
+        }
+      }
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,106 @@
+#include "wifi_position_estimation/likelihood_table.h"
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+// Definitions of the constants, which std::min and std::max bind to references
+const int LikelihoodTable::MIN_DBM;
+const int LikelihoodTable::MAX_DBM;
+const int LikelihoodTable::ROW_LENGTH;
+
+LikelihoodTable::LikelihoodTable() : n_aps_(0), resolution_(1.0), cluster_step_(0.0)
+{
+}
+
+void LikelihoodTable::clear()
+{
+  clusters_.clear();
+  values_.clear();
+}
+
+int LikelihoodTable::column(double strength)
+{
+  return std::min(std::max(int(lround(strength)), MIN_DBM), MAX_DBM) - MIN_DBM;
+}
+
+bool LikelihoodTable::build(const std::vector<PrecomputedDataPoint> &data, int n_points, int n_aps, size_t max_bytes,
+                            double resolution)
+{
+  clear();
+  n_aps_ = n_aps;
+  resolution_ = resolution;
+
+  size_t n_pairs = size_t(n_points) * n_aps;
+  if(n_pairs * sizeof(uint16_t) + ROW_LENGTH * sizeof(int16_t) > max_bytes)
+    return false;
+
+  std::vector<uint16_t> clusters(n_pairs);
+  std::vector<double> mean_sums;
+  std::vector<double> log_variance_sums;
+  std::vector<int> members;
+  for(cluster_step_ = 0.01; cluster_step_ < 100.0; cluster_step_ *= 2.0)
+  {
+    std::unordered_map<uint64_t, int> cluster_of_key;
+    mean_sums.clear();
+    log_variance_sums.clear();
+    members.clear();
+    size_t max_clusters = std::min((max_bytes - n_pairs * sizeof(uint16_t)) / (ROW_LENGTH * sizeof(int16_t)),
+                                   size_t(std::numeric_limits<uint16_t>::max()) + 1);
+
+    bool fits = true;
+    for(size_t pair = 0; pair < n_pairs && fits; pair++)
+    {
+      // The mean is quantized in units of the standard deviation, so the error of the log likelihood does not depend
+      // on the variance.
+      double log_variance = log(std::max(fabs(data[pair].variance_), 1e-12));
+      int64_t variance_bin = llround(log_variance / cluster_step_);
+      double deviation = exp(0.5 * variance_bin * cluster_step_);
+      int64_t mean_bin = llround(data[pair].mean_ / (cluster_step_ * deviation));
+      uint64_t key = bin_key(variance_bin, mean_bin);
+
+      auto it = cluster_of_key.find(key);
+      if(it == cluster_of_key.end())
+      {
+        if(members.size() == max_clusters)
+        {
+          fits = false;
+          break;
+        }
+        it = cluster_of_key.insert(std::make_pair(key, int(members.size()))).first;
+        mean_sums.push_back(0.0);
+        log_variance_sums.push_back(0.0);
+        members.push_back(0);
+      }
+      clusters[pair] = it->second;
+      mean_sums[it->second] += data[pair].mean_;
+      log_variance_sums[it->second] += log_variance;
+      members[it->second]++;
+    }
+    if(fits)
+      break;
+  }
+  if(cluster_step_ >= 100.0)
+    return false;
+
+  // Every cluster is represented by the average of its members.
+  values_.resize(members.size() * ROW_LENGTH);
+  for(size_t cluster = 0; cluster < members.size(); cluster++)
+  {
+    double mean = mean_sums[cluster] / members[cluster];
+    double variance = exp(log_variance_sums[cluster] / members[cluster]);
+    for(int dbm = MIN_DBM; dbm <= MAX_DBM; dbm++)
+    {
+      double log_prob = Process::log_probability_precomputed(mean, variance, dbm);
+      // Unusable values are skipped by the analytic path, which adds nothing.
+      if(std::isnan(log_prob))
+        log_prob = 0.0;
+      double quantized = std::min(std::max(round(log_prob / resolution_), double(std::numeric_limits<int16_t>::min())),
+                                  double(std::numeric_limits<int16_t>::max()));
+      values_[cluster * ROW_LENGTH + dbm - MIN_DBM] = int16_t(quantized);
+    }
+  }
+  clusters_.swap(clusters);
+  return true;
+}
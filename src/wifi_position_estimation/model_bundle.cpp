@@ -0,0 +1,210 @@
+#include "wifi_position_estimation/model_bundle.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+/// Start of every bundle. All fields are 8 bytes wide, so the entries after it stay aligned.
+struct Header
+{
+  char magic[8];
+  uint64_t version;
+  /// Written as ENDIAN_MARKER, reads back differently on a host of another byte order
+  uint64_t byte_order;
+  uint64_t key;
+  uint64_t n_models;
+};
+
+const char MAGIC[8] = {'W', 'I', 'F', 'I', 'M', 'O', 'D', 'L'};
+const uint64_t ENDIAN_MARKER = 0x0102030405060708ull;
+const size_t ALIGNMENT = 64;
+
+size_t align(size_t offset)
+{
+  return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+/// Whether an array of count doubles at offset is aligned and lies within a file of the given size
+bool fits(uint64_t offset, uint64_t count, size_t size)
+{
+  return offset % sizeof(double) == 0 && offset <= size && count <= (size - offset) / sizeof(double);
+}
+}
+
+/// Index entry of one model. The offsets are counted from the start of the file.
+struct ModelBundle::Entry
+{
+  uint64_t mac;
+  uint64_t n;
+  double x_mean;
+  double y_mean;
+  double x_std;
+  double y_std;
+  double params[4];
+  uint64_t coordinates;
+  uint64_t observations;
+  uint64_t cholesky;
+  uint64_t alpha;
+};
+
+ModelBundle::ModelBundle() : mapping_(nullptr), size_(0)
+{
+}
+
+ModelBundle::~ModelBundle()
+{
+  unmap();
+}
+
+void ModelBundle::unmap()
+{
+  if(mapping_ != nullptr)
+    munmap(mapping_, size_);
+  mapping_ = nullptr;
+  size_ = 0;
+  entries_.clear();
+}
+
+bool ModelBundle::write(const std::string &file, uint64_t key, const std::vector<uint64_t> &macs,
+                        const std::vector<Process> &processes)
+{
+  if(macs.size() != processes.size())
+    return false;
+
+  // The layout is planned first, so the index can be written before the arrays.
+  std::vector<Entry> entries(processes.size());
+  std::vector<Eigen::MatrixXd> choleskys(processes.size());
+  std::vector<Process::Model> models(processes.size());
+  size_t offset = sizeof(Header) + entries.size() * sizeof(Entry);
+  for(size_t i = 0; i < processes.size(); i++)
+  {
+    models[i] = processes[i].model(choleskys[i]);
+    Entry &entry = entries[i];
+    entry.mac = macs[i];
+    entry.n = models[i].n;
+    entry.x_mean = models[i].x_mean;
+    entry.y_mean = models[i].y_mean;
+    entry.x_std = models[i].x_std;
+    entry.y_std = models[i].y_std;
+    memcpy(entry.params, models[i].params, sizeof(entry.params));
+    entry.coordinates = offset = align(offset);
+    offset += 2 * entry.n * sizeof(double);
+    entry.observations = offset = align(offset);
+    offset += entry.n * sizeof(double);
+    entry.cholesky = offset = align(offset);
+    offset += entry.n * entry.n * sizeof(double);
+    entry.alpha = offset = align(offset);
+    offset += entry.n * sizeof(double);
+  }
+
+  std::string temporary = file + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byte_order = ENDIAN_MARKER;
+    header.key = key;
+    header.n_models = entries.size();
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(Entry));
+
+    const char padding[ALIGNMENT] = {};
+    auto write_array = [&](uint64_t position, const double *array, size_t size)
+    {
+      out.write(padding, position - out.tellp());
+      out.write(reinterpret_cast<const char *>(array), size * sizeof(double));
+    };
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+      write_array(entries[i].coordinates, models[i].coordinates, 2 * entries[i].n);
+      write_array(entries[i].observations, models[i].observations, entries[i].n);
+      write_array(entries[i].cholesky, models[i].cholesky, entries[i].n * entries[i].n);
+      write_array(entries[i].alpha, models[i].alpha, entries[i].n);
+    }
+    if(!out)
+    {
+      out.close();
+      remove(temporary.c_str());
+      return false;
+    }
+  }
+  return rename(temporary.c_str(), file.c_str()) == 0;
+}
+
+bool ModelBundle::load(const std::string &file, uint64_t key)
+{
+  unmap();
+  int fd = open(file.c_str(), O_RDONLY);
+  if(fd == -1)
+    return false;
+
+  struct stat status;
+  if(fstat(fd, &status) != 0 || size_t(status.st_size) < sizeof(Header))
+  {
+    close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mapping == MAP_FAILED)
+    return false;
+  mapping_ = mapping;
+  size_ = status.st_size;
+
+  const char *begin = static_cast<const char *>(mapping_);
+  const Header *header = reinterpret_cast<const Header *>(begin);
+  // The counts of a corrupt file are bounded by the file size before they are multiplied, so no check can overflow.
+  if(memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION ||
+     header->byte_order != ENDIAN_MARKER || header->key != key ||
+     header->n_models > (size_ - sizeof(Header)) / sizeof(Entry))
+  {
+    unmap();
+    return false;
+  }
+
+  const Entry *entries = reinterpret_cast<const Entry *>(begin + sizeof(Header));
+  for(uint64_t i = 0; i < header->n_models; i++)
+  {
+    const Entry &entry = entries[i];
+    if(entry.n > uint64_t(std::numeric_limits<int>::max()) || !fits(entry.coordinates, 2 * entry.n, size_) ||
+       !fits(entry.observations, entry.n, size_) || !fits(entry.cholesky, entry.n * entry.n, size_) ||
+       !fits(entry.alpha, entry.n, size_))
+    {
+      unmap();
+      return false;
+    }
+    entries_.push_back(&entry);
+  }
+  return true;
+}
+
+uint64_t ModelBundle::mac(int index) const
+{
+  return entries_[index]->mac;
+}
+
+Process::Model ModelBundle::model(int index) const
+{
+  const Entry &entry = *entries_[index];
+  const char *begin = static_cast<const char *>(mapping_);
+  Process::Model model;
+  model.n = entry.n;
+  model.x_mean = entry.x_mean;
+  model.y_mean = entry.y_mean;
+  model.x_std = entry.x_std;
+  model.y_std = entry.y_std;
+  memcpy(model.params, entry.params, sizeof(model.params));
+  model.coordinates = reinterpret_cast<const double *>(begin + entry.coordinates);
+  model.observations = reinterpret_cast<const double *>(begin + entry.observations);
+  model.cholesky = reinterpret_cast<const double *>(begin + entry.cholesky);
+  model.alpha = reinterpret_cast<const double *>(begin + entry.alpha);
+  return model;
+}
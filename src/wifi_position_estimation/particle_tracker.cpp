@@ -0,0 +1,157 @@
+#include "wifi_position_estimation/particle_tracker.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+ParticleTracker::ParticleTracker() : random_engine_(std::random_device()()), min_particles_(200), max_particles_(5000),
+                                     converged_spread_(2.0), translation_noise_(0.2), rotation_noise_(0.2)
+{
+}
+
+void ParticleTracker::configure(int min_particles, int max_particles, double converged_spread,
+                                double translation_noise, double rotation_noise)
+{
+  min_particles_ = std::max(min_particles, 1);
+  max_particles_ = std::max(max_particles, min_particles_);
+  converged_spread_ = converged_spread;
+  translation_noise_ = translation_noise;
+  rotation_noise_ = rotation_noise;
+}
+
+void ParticleTracker::reset(const PositionSampler &sampler)
+{
+  std::uniform_real_distribution<double> heading(-M_PI, M_PI);
+  particles_.clear();
+  for(int i = 0; i < max_particles_; i++)
+  {
+    Particle particle;
+    if(!sampler(particle.position))
+      continue;
+    particle.theta = heading(random_engine_);
+    particle.log_weight = 0.0;
+    particles_.push_back(particle);
+  }
+}
+
+void ParticleTracker::predict(double dx, double dy, double dtheta)
+{
+  double distance = sqrt(dx * dx + dy * dy);
+  std::normal_distribution<double> translation(0.0, translation_noise_ * distance + 1e-3);
+  std::normal_distribution<double> rotation(0.0, rotation_noise_ * fabs(dtheta) + 0.1 * translation_noise_ * distance + 1e-3);
+  for(auto& particle:particles_)
+  {
+    double c = cos(particle.theta);
+    double s = sin(particle.theta);
+    double nx = dx + translation(random_engine_);
+    double ny = dy + translation(random_engine_);
+    particle.position += Eigen::Vector2d(c * nx - s * ny, s * nx + c * ny);
+    particle.theta = remainder(particle.theta + dtheta + rotation(random_engine_), 2.0 * M_PI);
+  }
+}
+
+std::vector<double> ParticleTracker::weights() const
+{
+  double max_log_weight = -std::numeric_limits<double>::infinity();
+  for(auto& particle:particles_)
+    max_log_weight = std::max(max_log_weight, particle.log_weight);
+
+  std::vector<double> weights(particles_.size(), 0.0);
+  if(std::isinf(max_log_weight))
+    return weights;
+
+  double sum = 0.0;
+  for(size_t i = 0; i < particles_.size(); i++)
+  {
+    weights[i] = exp(particles_[i].log_weight - max_log_weight);
+    sum += weights[i];
+  }
+  for(auto& weight:weights)
+    weight /= sum;
+  return weights;
+}
+
+void ParticleTracker::update(const LikelihoodFunction &log_likelihood, const PositionSampler &sampler)
+{
+  if(particles_.empty())
+    reset(sampler);
+
+  bool any_finite = false;
+  for(auto& particle:particles_)
+  {
+    particle.log_weight += log_likelihood(particle.position);
+    any_finite |= !std::isinf(particle.log_weight) && !std::isnan(particle.log_weight);
+  }
+
+  // All particles left the map or were moved into positions without data.
+  if(!any_finite)
+  {
+    reset(sampler);
+    return;
+  }
+
+  std::vector<double> w = weights();
+  double squared_sum = 0.0;
+  for(auto& weight:w)
+    squared_sum += weight * weight;
+  double effective_sample_size = 1.0 / squared_sum;
+
+  // Grow only once the spread clearly exceeds the threshold, so the particle count does not flip with every scan.
+  size_t n = particles_.size();
+  double current_spread = spread();
+  if(current_spread < converged_spread_)
+    n = min_particles_;
+  else if(current_spread > 2.0 * converged_spread_)
+    n = max_particles_;
+  if(effective_sample_size < 0.5 * particles_.size() || n != particles_.size())
+    resample(n);
+}
+
+void ParticleTracker::resample(size_t n)
+{
+  std::vector<double> w = weights();
+  std::vector<Particle> parents = particles_;
+  particles_.resize(n);
+
+  double step = 1.0 / n;
+  double u = std::uniform_real_distribution<double>(0.0, step)(random_engine_);
+  double cumulative = w[0];
+  size_t parent = 0;
+  for(size_t i = 0; i < n; i++, u += step)
+  {
+    while(parent < parents.size() - 1 && cumulative < u)
+      cumulative += w[++parent];
+    particles_[i] = parents[parent];
+    particles_[i].log_weight = 0.0;
+  }
+}
+
+void ParticleTracker::estimate(Eigen::Vector3d &mean, Eigen::Matrix3d &covariance) const
+{
+  std::vector<double> w = weights();
+  Eigen::Vector2d position = Eigen::Vector2d::Zero();
+  double heading_x = 0.0;
+  double heading_y = 0.0;
+  for(size_t i = 0; i < particles_.size(); i++)
+  {
+    position += w[i] * particles_[i].position;
+    heading_x += w[i] * cos(particles_[i].theta);
+    heading_y += w[i] * sin(particles_[i].theta);
+  }
+  mean = Eigen::Vector3d(position(0), position(1), atan2(heading_y, heading_x));
+
+  covariance = Eigen::Matrix3d::Zero();
+  for(size_t i = 0; i < particles_.size(); i++)
+  {
+    Eigen::Vector3d difference(particles_[i].position(0) - mean(0), particles_[i].position(1) - mean(1),
+                               remainder(particles_[i].theta - mean(2), 2.0 * M_PI));
+    covariance += w[i] * difference * difference.transpose();
+  }
+}
+
+double ParticleTracker::spread() const
+{
+  Eigen::Vector3d mean;
+  Eigen::Matrix3d covariance;
+  estimate(mean, covariance);
+  return sqrt(covariance(0, 0) + covariance(1, 1));
+}
@@ -0,0 +1,137 @@
+#include "wifi_position_estimation/posterior_summary.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+void PosteriorSummary::clear()
+{
+  positions_.clear();
+  log_likelihoods_.clear();
+}
+
+void PosteriorSummary::add(const Eigen::Vector2d &position, double log_likelihood)
+{
+  positions_.push_back(position);
+  log_likelihoods_.push_back(std::isnan(log_likelihood) ? -std::numeric_limits<double>::infinity() : log_likelihood);
+}
+
+double PosteriorSummary::log_sum() const
+{
+  double max_log_likelihood = -std::numeric_limits<double>::infinity();
+  for(auto& it:log_likelihoods_)
+    max_log_likelihood = std::max(max_log_likelihood, it);
+  if(std::isinf(max_log_likelihood))
+    return max_log_likelihood;
+
+  double sum = 0.0;
+  for(auto& it:log_likelihoods_)
+    sum += exp(it - max_log_likelihood);
+  return max_log_likelihood + log(sum);
+}
+
+std::vector<double> PosteriorSummary::weights() const
+{
+  double normalizer = log_sum();
+  std::vector<double> weights(log_likelihoods_.size(), 0.0);
+  if(std::isinf(normalizer))
+    return weights;
+  for(size_t i = 0; i < log_likelihoods_.size(); i++)
+    weights[i] = exp(log_likelihoods_[i] - normalizer);
+  return weights;
+}
+
+double PosteriorSummary::log_mean_likelihood() const
+{
+  if(log_likelihoods_.empty())
+    return -std::numeric_limits<double>::infinity();
+  return log_sum() - log(double(log_likelihoods_.size()));
+}
+
+bool PosteriorSummary::moments(Eigen::Vector2d &mean, Eigen::Matrix2d &covariance) const
+{
+  int finite = 0;
+  for(auto& it:log_likelihoods_)
+    if(!std::isinf(it))
+      finite++;
+  if(finite < 2)
+    return false;
+
+  std::vector<double> w = weights();
+  mean = Eigen::Vector2d::Zero();
+  for(size_t i = 0; i < positions_.size(); i++)
+    mean += w[i] * positions_[i];
+
+  covariance = Eigen::Matrix2d::Zero();
+  for(size_t i = 0; i < positions_.size(); i++)
+  {
+    Eigen::Vector2d difference = positions_[i] - mean;
+    covariance += w[i] * difference * difference.transpose();
+  }
+  return true;
+}
+
+std::vector<PosteriorSummary::Mode> PosteriorSummary::modes(int k, double separation) const
+{
+  struct Cell
+  {
+    double weight;
+    double best_log_likelihood;
+    int best_particle;
+  };
+
+  if(k <= 0 || !(separation > 0.0))
+    return {};
+
+  std::vector<double> w = weights();
+  std::map<std::pair<int, int>, Cell> cells;
+  for(size_t i = 0; i < positions_.size(); i++)
+  {
+    if(std::isinf(log_likelihoods_[i]))
+      continue;
+    std::pair<int, int> key(int(floor(positions_[i](0) / separation)), int(floor(positions_[i](1) / separation)));
+    auto it = cells.find(key);
+    if(it == cells.end())
+    {
+      cells[key] = {w[i], log_likelihoods_[i], int(i)};
+      continue;
+    }
+    it->second.weight += w[i];
+    if(log_likelihoods_[i] > it->second.best_log_likelihood)
+    {
+      it->second.best_log_likelihood = log_likelihoods_[i];
+      it->second.best_particle = i;
+    }
+  }
+
+  std::vector<Mode> modes;
+  for(auto& cell:cells)
+  {
+    bool maximum = true;
+    double neighborhood_weight = cell.second.weight;
+    for(int dx = -1; dx <= 1 && maximum; dx++)
+    {
+      for(int dy = -1; dy <= 1 && maximum; dy++)
+      {
+        if(dx == 0 && dy == 0)
+          continue;
+        auto neighbor = cells.find(std::make_pair(cell.first.first + dx, cell.first.second + dy));
+        if(neighbor == cells.end())
+          continue;
+        // Ties are broken by the cell index, so a plateau yields a single mode.
+        if(neighbor->second.weight > cell.second.weight ||
+           (neighbor->second.weight == cell.second.weight && neighbor->first < cell.first))
+          maximum = false;
+        neighborhood_weight += neighbor->second.weight;
+      }
+    }
+    // A peak usually spreads over several cells, so the mode is weighted with its neighborhood.
+    if(maximum)
+      modes.push_back(std::make_pair(positions_[cell.second.best_particle], neighborhood_weight));
+  }
+
+  std::sort(modes.begin(), modes.end(), [](const Mode &a, const Mode &b) { return a.second > b.second; });
+  if(modes.size() > size_t(k))
+    modes.resize(k);
+  return modes;
+}
@@ -0,0 +1,138 @@
+#include "wifi_position_estimation/precompute_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+/// Start of every cache file. All fields are 8 bytes wide, so the data after it stays aligned.
+struct Header
+{
+  char magic[8];
+  uint64_t version;
+  uint64_t key;
+  uint64_t precision;
+  uint64_t n_points;
+  uint64_t n_aps;
+};
+
+const char MAGIC[8] = {'W', 'I', 'F', 'I', 'P', 'R', 'E', 'C'};
+}
+
+void CacheKey::add(const void *data, size_t size)
+{
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for(size_t i = 0; i < size; i++)
+  {
+    hash_ ^= bytes[i];
+    hash_ *= 1099511628211ull;
+  }
+}
+
+PrecomputeCache::PrecomputeCache() : mapping_(nullptr), size_(0)
+{
+}
+
+PrecomputeCache::~PrecomputeCache()
+{
+  unmap();
+}
+
+void PrecomputeCache::unmap()
+{
+  if(mapping_ != nullptr)
+    munmap(mapping_, size_);
+  mapping_ = nullptr;
+  size_ = 0;
+}
+
+std::string PrecomputeCache::file_name(const std::string &directory, uint64_t key)
+{
+  char name[40];
+  snprintf(name, sizeof(name), "precompute_%016llx.bin", (unsigned long long)key);
+  return directory + "/" + name;
+}
+
+bool PrecomputeCache::load(const std::string &file, uint64_t key, int n_aps, PrecomputedTable::Precision precision,
+                           std::vector<Eigen::Vector2d> &points, PrecomputedTable &table)
+{
+  unmap();
+  int fd = open(file.c_str(), O_RDONLY);
+  if(fd == -1)
+    return false;
+
+  struct stat status;
+  if(fstat(fd, &status) != 0 || size_t(status.st_size) < sizeof(Header))
+  {
+    close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mapping == MAP_FAILED)
+    return false;
+  mapping_ = mapping;
+  size_ = status.st_size;
+
+  const char *begin = static_cast<const char *>(mapping_);
+  const Header *header = reinterpret_cast<const Header *>(begin);
+  // n_points is bounded by the file size before it is multiplied, so a corrupt header can not overflow the size check.
+  if(memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION || header->key != key ||
+     header->precision != uint64_t(precision) || header->n_aps != uint64_t(n_aps) ||
+     header->n_points > (size_ - sizeof(Header)) / (2 * sizeof(double)) ||
+     header->n_points > uint64_t(std::numeric_limits<int>::max()))
+  {
+    unmap();
+    return false;
+  }
+  size_t points_bytes = header->n_points * 2 * sizeof(double);
+
+  const char *values = begin + sizeof(Header) + points_bytes;
+  if(!table.attach(values, size_ - sizeof(Header) - points_bytes, header->n_points, n_aps, precision))
+  {
+    unmap();
+    return false;
+  }
+
+  // The points are small next to the table, so they are copied into the usual vector.
+  const double *coordinates = reinterpret_cast<const double *>(begin + sizeof(Header));
+  points.resize(header->n_points);
+  for(size_t i = 0; i < points.size(); i++)
+    points[i] = Eigen::Vector2d(coordinates[2 * i], coordinates[2 * i + 1]);
+  return true;
+}
+
+bool PrecomputeCache::save(const std::string &file, uint64_t key, const std::vector<Eigen::Vector2d> &points,
+                           const PrecomputedTable &table)
+{
+  std::string temporary = file + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.key = key;
+    header.precision = table.precision();
+    header.n_points = points.size();
+    header.n_aps = table.aps();
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for(auto& point:points)
+    {
+      double coordinates[2] = {point(0), point(1)};
+      out.write(reinterpret_cast<const char *>(coordinates), sizeof(coordinates));
+    }
+    if(!table.write(out))
+    {
+      out.close();
+      remove(temporary.c_str());
+      return false;
+    }
+  }
+  return rename(temporary.c_str(), file.c_str()) == 0;
+}
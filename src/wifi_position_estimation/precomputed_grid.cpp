@@ -0,0 +1,127 @@
+#include "wifi_position_estimation/precomputed_grid.h"
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <cmath>
+#include <ros/ros.h>
+
+PrecomputedGrid::PrecomputedGrid() : origin_x_(0.0), origin_y_(0.0), resolution_(1.0), cols_(0), rows_(0), n_aps_(0)
+{
+}
+
+void PrecomputedGrid::set_geometry(const nav_msgs::OccupancyGrid &map, double resolution)
+{
+  resolution_ = resolution;
+  origin_x_ = map.info.origin.position.x;
+  origin_y_ = map.info.origin.position.y;
+  cols_ = int(map.info.width * map.info.resolution / resolution_) + 1;
+  rows_ = int(map.info.height * map.info.resolution / resolution_) + 1;
+
+  free_.assign(cols_ * rows_, 0);
+  for(int row = 0; row < rows_; row++)
+  {
+    for(int col = 0; col < cols_; col++)
+    {
+      // Look up the cell of the occupancy grid the node lies in. Unknown cells (-1) are not considered free.
+      int map_x = std::min(int(col * resolution_ / map.info.resolution), int(map.info.width) - 1);
+      int map_y = std::min(int(row * resolution_ / map.info.resolution), int(map.info.height) - 1);
+      int8_t occupancy = map.data[map_y * map.info.width + map_x];
+      free_[row * cols_ + col] = occupancy >= 0 && occupancy < 50;
+    }
+  }
+
+  // The free nodes and their neighbours are needed, so that every cell touching free space can be interpolated.
+  computed_.assign(cols_ * rows_, 0);
+  for(int row = 0; row < rows_; row++)
+  {
+    for(int col = 0; col < cols_; col++)
+    {
+      if(!free_[row * cols_ + col])
+        continue;
+      for(int r = std::max(row - 1, 0); r <= std::min(row + 1, rows_ - 1); r++)
+        for(int c = std::max(col - 1, 0); c <= std::min(col + 1, cols_ - 1); c++)
+          computed_[r * cols_ + c] = 1;
+    }
+  }
+}
+
+void PrecomputedGrid::compute(const std::vector<Process> &processes)
+{
+  n_aps_ = processes.size();
+  mean_.assign(cols_ * rows_ * n_aps_, 0.0);
+  variance_.assign(cols_ * rows_ * n_aps_, 0.0);
+
+  int n_computed = 0;
+  for(int row = 0; row < rows_; row++)
+  {
+    for(int col = 0; col < cols_; col++)
+    {
+      int node = row * cols_ + col;
+      if(!computed_[node])
+        continue;
+      Eigen::Vector2d position = node_position(col, row);
+      for(int ap = 0; ap < n_aps_; ap++)
+      {
+        processes[ap].predict(position(0), position(1), mean_[node * n_aps_ + ap], variance_[node * n_aps_ + ap]);
+      }
+      n_computed++;
+    }
+  }
+  ROS_INFO("Precomputed %i grid nodes for %i access points.", n_computed, n_aps_);
+}
+
+bool PrecomputedGrid::cell(double x, double y, int &col, int &row, double &u, double &v) const
+{
+  double gx = (x - origin_x_) / resolution_;
+  double gy = (y - origin_y_) / resolution_;
+  col = int(std::floor(gx));
+  row = int(std::floor(gy));
+  if(col < 0 || row < 0 || col >= cols_ - 1 || row >= rows_ - 1)
+    return false;
+
+  int node = row * cols_ + col;
+  if(!computed_[node] || !computed_[node + 1] || !computed_[node + cols_] || !computed_[node + cols_ + 1])
+    return false;
+
+  u = gx - col;
+  v = gy - row;
+  return true;
+}
+
+bool PrecomputedGrid::interpolate(int ap, double x, double y, double &mean, double &variance) const
+{
+  int col, row;
+  double u, v;
+  if(!cell(x, y, col, row, u, v))
+    return false;
+
+  int i00 = (row * cols_ + col) * n_aps_ + ap;
+  int i10 = i00 + n_aps_;
+  int i01 = i00 + cols_ * n_aps_;
+  int i11 = i01 + n_aps_;
+
+  double w00 = (1.0 - u) * (1.0 - v);
+  double w10 = u * (1.0 - v);
+  double w01 = (1.0 - u) * v;
+  double w11 = u * v;
+
+  mean = w00 * mean_[i00] + w10 * mean_[i10] + w01 * mean_[i01] + w11 * mean_[i11];
+  variance = w00 * variance_[i00] + w10 * variance_[i10] + w01 * variance_[i01] + w11 * variance_[i11];
+  return true;
+}
+
+bool PrecomputedGrid::is_free(double x, double y) const
+{
+  int col, row;
+  double u, v;
+  if(!cell(x, y, col, row, u, v))
+    return false;
+
+  // Use the nearest node to decide, whether the position is in free space.
+  int c = col + (u > 0.5 ? 1 : 0);
+  int r = row + (v > 0.5 ? 1 : 0);
+  return free_[r * cols_ + c];
+}
+
+Eigen::Vector2d PrecomputedGrid::node_position(int col, int row) const
+{
+  return {origin_x_ + col * resolution_, origin_y_ + row * resolution_};
+}
@@ -0,0 +1,170 @@
+#include "wifi_position_estimation/precomputed_table.h"
+#include <algorithm>
+#include <limits>
+
+PrecomputedTable::PrecomputedTable() : precision_(DOUBLE), n_points_(0), n_aps_(0), doubles_data_(nullptr),
+                                       floats_data_(nullptr), fixed_data_(nullptr)
+{
+}
+
+void PrecomputedTable::clear()
+{
+  n_points_ = 0;
+  n_aps_ = 0;
+  doubles_.clear();
+  floats_.clear();
+  fixed_.clear();
+  mean_offset_.clear();
+  mean_scale_.clear();
+  log_variance_offset_.clear();
+  log_variance_scale_.clear();
+  doubles_data_ = nullptr;
+  floats_data_ = nullptr;
+  fixed_data_ = nullptr;
+}
+
+bool PrecomputedTable::parse_precision(const std::string &name, Precision &precision)
+{
+  if(name == "double")
+    precision = DOUBLE;
+  else if(name == "float")
+    precision = FLOAT;
+  else if(name == "fixed16")
+    precision = FIXED16;
+  else
+    return false;
+  return true;
+}
+
+size_t PrecomputedTable::values_bytes() const
+{
+  size_t n_pairs = size_t(n_points_) * n_aps_;
+  if(precision_ == DOUBLE)
+    return n_pairs * sizeof(PrecomputedDataPoint);
+  if(precision_ == FLOAT)
+    return n_pairs * 2 * sizeof(float);
+  return n_pairs * 2 * sizeof(uint16_t);
+}
+
+size_t PrecomputedTable::bytes() const
+{
+  return values_bytes() + 4 * mean_offset_.size() * sizeof(double);
+}
+
+bool PrecomputedTable::write(std::ostream &out) const
+{
+  // The scales are always written, so the values start at the same offset for every precision.
+  std::vector<double> scales(4 * n_aps_, 0.0);
+  for(size_t ap = 0; ap < mean_offset_.size(); ap++)
+  {
+    scales[4 * ap] = mean_offset_[ap];
+    scales[4 * ap + 1] = mean_scale_[ap];
+    scales[4 * ap + 2] = log_variance_offset_[ap];
+    scales[4 * ap + 3] = log_variance_scale_[ap];
+  }
+  out.write(reinterpret_cast<const char *>(scales.data()), scales.size() * sizeof(double));
+
+  const char *values = precision_ == DOUBLE ? reinterpret_cast<const char *>(doubles_data_) :
+                       precision_ == FLOAT ? reinterpret_cast<const char *>(floats_data_) :
+                       reinterpret_cast<const char *>(fixed_data_);
+  out.write(values, values_bytes());
+  return bool(out);
+}
+
+bool PrecomputedTable::attach(const char *begin, size_t size, int n_points, int n_aps, Precision precision)
+{
+  clear();
+  precision_ = precision;
+  n_points_ = n_points;
+  n_aps_ = n_aps;
+  size_t scales_bytes = 4 * size_t(n_aps) * sizeof(double);
+  if(size != scales_bytes + values_bytes())
+  {
+    clear();
+    return false;
+  }
+
+  const double *scales = reinterpret_cast<const double *>(begin);
+  if(precision == FIXED16)
+  {
+    for(int ap = 0; ap < n_aps; ap++)
+    {
+      mean_offset_.push_back(scales[4 * ap]);
+      mean_scale_.push_back(scales[4 * ap + 1]);
+      log_variance_offset_.push_back(scales[4 * ap + 2]);
+      log_variance_scale_.push_back(scales[4 * ap + 3]);
+    }
+  }
+
+  const char *values = begin + scales_bytes;
+  if(precision == DOUBLE)
+    doubles_data_ = reinterpret_cast<const PrecomputedDataPoint *>(values);
+  else if(precision == FLOAT)
+    floats_data_ = reinterpret_cast<const float *>(values);
+  else
+    fixed_data_ = reinterpret_cast<const uint16_t *>(values);
+  return true;
+}
+
+void PrecomputedTable::build(const std::vector<PrecomputedDataPoint> &data, int n_points, int n_aps,
+                             Precision precision)
+{
+  clear();
+  precision_ = precision;
+  n_points_ = n_points;
+  n_aps_ = n_aps;
+
+  if(precision == DOUBLE)
+  {
+    doubles_ = data;
+    doubles_data_ = doubles_.data();
+    return;
+  }
+
+  if(precision == FLOAT)
+  {
+    floats_.resize(2 * data.size());
+    for(size_t i = 0; i < data.size(); i++)
+    {
+      floats_[2 * i] = data[i].mean_;
+      floats_[2 * i + 1] = data[i].variance_;
+    }
+    floats_data_ = floats_.data();
+    return;
+  }
+
+  // The range of every access point is mapped onto the 16 bit range.
+  const double max_quantized = std::numeric_limits<uint16_t>::max();
+  std::vector<double> min_mean(n_aps, std::numeric_limits<double>::infinity());
+  std::vector<double> max_mean(n_aps, -std::numeric_limits<double>::infinity());
+  std::vector<double> min_log_variance(n_aps, std::numeric_limits<double>::infinity());
+  std::vector<double> max_log_variance(n_aps, -std::numeric_limits<double>::infinity());
+  for(size_t i = 0; i < data.size(); i++)
+  {
+    int ap = i % n_aps;
+    double log_variance = log(std::max(fabs(data[i].variance_), 1e-300));
+    min_mean[ap] = std::min(min_mean[ap], data[i].mean_);
+    max_mean[ap] = std::max(max_mean[ap], data[i].mean_);
+    min_log_variance[ap] = std::min(min_log_variance[ap], log_variance);
+    max_log_variance[ap] = std::max(max_log_variance[ap], log_variance);
+  }
+  for(int ap = 0; ap < n_aps; ap++)
+  {
+    mean_offset_.push_back(std::isinf(min_mean[ap]) ? 0.0 : min_mean[ap]);
+    mean_scale_.push_back(max_mean[ap] > min_mean[ap] ? (max_mean[ap] - min_mean[ap]) / max_quantized : 0.0);
+    log_variance_offset_.push_back(std::isinf(min_log_variance[ap]) ? 0.0 : min_log_variance[ap]);
+    log_variance_scale_.push_back(max_log_variance[ap] > min_log_variance[ap] ?
+                                  (max_log_variance[ap] - min_log_variance[ap]) / max_quantized : 0.0);
+  }
+
+  fixed_.resize(2 * data.size());
+  for(size_t i = 0; i < data.size(); i++)
+  {
+    int ap = i % n_aps;
+    double log_variance = log(std::max(fabs(data[i].variance_), 1e-300));
+    fixed_[2 * i] = mean_scale_[ap] > 0.0 ? uint16_t(lround((data[i].mean_ - mean_offset_[ap]) / mean_scale_[ap])) : 0;
+    fixed_[2 * i + 1] = log_variance_scale_[ap] > 0.0 ?
+                        uint16_t(lround((log_variance - log_variance_offset_[ap]) / log_variance_scale_[ap])) : 0;
+  }
+  fixed_data_ = fixed_.data();
+}
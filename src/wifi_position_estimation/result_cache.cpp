@@ -0,0 +1,93 @@
+#include "wifi_position_estimation/result_cache.h"
+#include <algorithm>
+#include <cmath>
+
+ResultCache::ResultCache(int capacity, double quantization)
+        : capacity_(capacity > 0 ? capacity : 0), quantization_(quantization > 0.0 ? quantization : 1.0), hits_(0), misses_(0)
+{
+}
+
+ResultCache::Fingerprint ResultCache::fingerprint(const std::vector<std::pair<int, double>> &observations) const
+{
+  Fingerprint fingerprint;
+  for(auto& observation:observations)
+    fingerprint.push_back(std::make_pair(observation.first, int(std::floor(observation.second / quantization_ + 0.5))));
+  std::sort(fingerprint.begin(), fingerprint.end());
+  return fingerprint;
+}
+
+uint64_t ResultCache::hash(const Fingerprint &fingerprint)
+{
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](uint32_t value)
+  {
+    for(int byte = 0; byte < 4; byte++)
+    {
+      hash ^= (value >> (8 * byte)) & 0xff;
+      hash *= 1099511628211ull;
+    }
+  };
+  for(auto& it:fingerprint)
+  {
+    add(uint32_t(it.first));
+    add(uint32_t(it.second));
+  }
+  return hash;
+}
+
+bool ResultCache::find(const Fingerprint &fingerprint, EstimationResult &result)
+{
+  if(!enabled())
+    return false;
+
+  uint64_t h = hash(fingerprint);
+  auto range = index_.equal_range(h);
+  for(auto it = range.first; it != range.second; ++it)
+  {
+    if(it->second->fingerprint == fingerprint)
+    {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      result = it->second->result;
+      hits_++;
+      return true;
+    }
+  }
+  misses_++;
+  return false;
+}
+
+void ResultCache::insert(const Fingerprint &fingerprint, const EstimationResult &result)
+{
+  if(!enabled())
+    return;
+
+  uint64_t h = hash(fingerprint);
+  auto range = index_.equal_range(h);
+  for(auto it = range.first; it != range.second; ++it)
+  {
+    if(it->second->fingerprint == fingerprint)
+    {
+      it->second->result = result;
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return;
+    }
+  }
+
+  if(entries_.size() >= capacity_)
+  {
+    // Evict the least recently used entry.
+    auto range = index_.equal_range(entries_.back().hash);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+      if(it->second == std::prev(entries_.end()))
+      {
+        index_.erase(it);
+        break;
+      }
+    }
+    entries_.pop_back();
+  }
+
+  entries_.push_front({h, fingerprint, result});
+  index_.insert(std::make_pair(h, entries_.begin()));
+}
@@ -0,0 +1,56 @@
+#include "wifi_position_estimation/training_parameters.h"
+#include <cstdio>
+#include <fstream>
+#include <wifi_position_estimation/precompute_cache.h>
+
+uint64_t training_key(const std::string &file)
+{
+  CacheKey key;
+  key.add(uint32_t(TRAINING_VERSION));
+  std::ifstream in(file.c_str(), std::ios::binary);
+  char buffer[4096];
+  while(in.read(buffer, sizeof(buffer)) || in.gcount() > 0)
+    key.add(buffer, in.gcount());
+  return key.value();
+}
+
+bool read_parameters(const std::string &file, uint64_t key, Eigen::Vector4d &parameters)
+{
+  std::ifstream in(file);
+  std::string value;
+  std::string signal_noise;
+  std::string signal_var;
+  std::string lengthscale;
+  std::string lengthscale2;
+  std::string stored_key;
+  getline(in, value, '\n');
+  getline(in, signal_noise, ',');
+  getline(in, signal_var, ',');
+  getline(in, lengthscale, ',');
+  getline(in, lengthscale2, '\n');
+  getline(in, value, ',');
+  getline(in, stored_key, '\n');
+
+  // Missing files and files written before the parameters were keyed fail to parse, so they count as changed.
+  try
+  {
+    if(std::stoull(stored_key, nullptr, 16) != key)
+      return false;
+    parameters = {std::stod(signal_noise), std::stod(signal_var), std::stod(lengthscale), std::stod(lengthscale2)};
+  }
+  catch(const std::exception &)
+  {
+    return false;
+  }
+  return true;
+}
+
+void write_parameters(const std::string &file, uint64_t key, const Eigen::Vector4d &parameters)
+{
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+  std::ofstream out(file.c_str());
+  out << "signal_noise, signal_var, lengthscale" << "\n";
+  out << std::to_string(parameters(0))+", "+std::to_string(parameters(1))+", "+std::to_string(parameters(2))+", "+std::to_string(parameters(3)) << "\n";
+  out << "training_key, " << hex << "\n";
+}
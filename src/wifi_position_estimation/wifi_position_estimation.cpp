@@ -1,13 +1,109 @@
 #include <grid_map_ros/GridMapRosConverter.hpp>
 #include "wifi_position_estimation/wifi_position_estimation.h"
+#include <time.h>
+#include <algorithm>
+#include <numeric>
 
-WifiPositionEstimation::WifiPositionEstimation(ros::NodeHandle &n):precomputed_data_(cmp),
-                                                                   gp_grid_map_({"gp_mean", "gp_variance"})
+/// Cpu time used by the calling thread in seconds
+static double thread_cpu_time()
+{
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+template<class Service>
+ros::ServiceServer WifiPositionEstimation::advertise_service(
+        ros::NodeHandle &n, const std::string &name,
+        bool (WifiPositionEstimation::*callback)(typename Service::Request &, typename Service::Response &),
+        ros::CallbackQueue *queue)
+{
+  ros::AdvertiseServiceOptions options = ros::AdvertiseServiceOptions::create<Service>(
+          name, boost::bind(callback, this, _1, _2), ros::VoidConstPtr(), queue);
+  return n.advertiseService(options);
+}
+
+WifiPositionEstimation::WifiPositionEstimation(ros::NodeHandle &n):gp_grid_map_({"gp_mean", "gp_variance"}),
+                                                                     heatmap_grid_map_({"log_likelihood", "posterior"})
 {
   std::string path = "";
   n_particles_ = 100;
-  computing_ = false;
+  state_ = IDLE;
+  latest_scan_ = std::make_shared<const Scan>();
+  latest_scan_stamp_ = -1.0;
+  min_trigger_interval_ = 0.0;
+  anytime_deadline_ = 0.0;
+  result_cache_size_ = 0;
+  streaming_filter_ = false;
+  tracking_ = false;
+  kidnapping_monitor_ = false;
+  local_search_ = false;
+  local_search_radius_ = 3.0;
+  local_search_growth_ = 0.5;
+  local_search_odom_factor_ = 1.0;
+  local_search_max_radius_ = 30.0;
+  local_search_particles_ = 1000;
+  local_search_min_log_likelihood_ = -5.0;
+  has_trusted_pose_ = false;
+  hypotheses_ = 5;
+  batch_threads_ = 0;
+  training_threads_ = 0;
+  batch_block_size_ = 256;
+  heatmap_rate_ = 0.0;
+  likelihood_table_enabled_ = false;
+  precompute_precision_ = "double";
+  precompute_cache_enabled_ = false;
+  model_bundle_file_ = "";
+  precision_check_scans_ = 100;
+  likelihood_table_megabytes_ = 64.0;
+  likelihood_table_resolution_ = 0.01;
+  heatmap_resolution_ = 0.5;
+  hypothesis_separation_ = 3.0;
+  publish_hypothesis_array_ = false;
+  min_position_variance_ = 0.25;
+  trusted_odom_distance_ = 0.0;
+  monitor_ring_radius_ = 1.0;
+  monitor_ring_points_ = 8;
+  has_amcl_pose_ = false;
+  last_max_weight_ = 0.0;
+  received_max_weight_ = false;
+  double monitor_threshold = 3.0;
+  int monitor_min_samples = 20;
+  int monitor_consecutive_failures = 2;
+  tracker_min_particles_ = 200;
+  tracker_max_particles_ = 5000;
+  tracker_converged_spread_ = 2.0;
+  tracker_translation_noise_ = 0.2;
+  tracker_rotation_noise_ = 0.2;
+  has_tracker_odom_ = false;
+  tracker_stop_ = false;
+  filter_motion_noise_ = 0.3;
+  filter_scan_noise_ = 0.5;
+  filter_uniform_mix_ = 0.001;
+  odom_distance_ = 0.0;
+  has_odom_ = false;
+  result_cache_quantization_ = 3.0;
+  anytime_batch_size_ = 100;
+  publish_intermediate_ = false;
+  trigger_cpu_budget_ = 0.0;
+  trigger_budget_window_ = 60.0;
+  service_timeout_ = -1.0;
   precompute_ = true;
+  precompute_mode_ = "random_points";
+  grid_resolution_ = 1.0;
+  search_mode_ = "sampling";
+  refinement_rounds_ = 0;
+  refinement_particles_ = 500;
+  refinement_spread_ = 5.0;
+  refinement_shrink_ = 0.5;
+  refinement_min_spread_ = 0.25;
+  gradient_refinement_top_k_ = 0;
+  gradient_refinement_steps_ = 10;
+  early_termination_ = false;
+  max_aps_ = 0;
+  ap_information_budget_ = 0.0;
+  incremental_scoring_ = false;
+  incremental_full_rescore_ = 100;
 
   init_noise_ = 2.3;
   init_var_ = 2.3;
@@ -20,11 +116,105 @@ WifiPositionEstimation::WifiPositionEstimation(ros::NodeHandle &n):precomputed_d
   n.param("/wifi_position_estimation/n_particles", n_particles_, n_particles_);
   n.param("/wifi_position_estimation/quality_threshold", quality_threshold_, quality_threshold_);
   n.param("/wifi_position_estimation/precompute", precompute_, precompute_);
+  n.param("/wifi_position_estimation/precompute_mode", precompute_mode_, precompute_mode_);
+  n.param("/wifi_position_estimation/grid_resolution", grid_resolution_, grid_resolution_);
+  n.param("/wifi_position_estimation/search_mode", search_mode_, search_mode_);
+  n.param("/wifi_position_estimation/refinement_rounds", refinement_rounds_, refinement_rounds_);
+  n.param("/wifi_position_estimation/refinement_particles", refinement_particles_, refinement_particles_);
+  n.param("/wifi_position_estimation/refinement_spread", refinement_spread_, refinement_spread_);
+  n.param("/wifi_position_estimation/refinement_shrink", refinement_shrink_, refinement_shrink_);
+  n.param("/wifi_position_estimation/refinement_min_spread", refinement_min_spread_, refinement_min_spread_);
+  n.param("/wifi_position_estimation/gradient_refinement_top_k", gradient_refinement_top_k_, gradient_refinement_top_k_);
+  n.param("/wifi_position_estimation/gradient_refinement_steps", gradient_refinement_steps_, gradient_refinement_steps_);
+  n.param("/wifi_position_estimation/early_termination", early_termination_, early_termination_);
+  n.param("/wifi_position_estimation/max_aps", max_aps_, max_aps_);
+  n.param("/wifi_position_estimation/ap_information_budget", ap_information_budget_, ap_information_budget_);
+  n.param("/wifi_position_estimation/incremental_scoring", incremental_scoring_, incremental_scoring_);
+  n.param("/wifi_position_estimation/incremental_full_rescore", incremental_full_rescore_, incremental_full_rescore_);
   n.param("/wifi_position_estimation/init_noise", init_noise_, init_noise_);
   n.param("/wifi_position_estimation/init_var", init_var_, init_var_);
   n.param("/wifi_position_estimation/init_l1", init_l1_, init_l1_);
   n.param("/wifi_position_estimation/init_l2", init_l2_, init_l2_);
   n.param("/wifi_position_estimation/gp_plot_resolution", gp_plot_resolution_, gp_plot_resolution_);
+  n.param("/wifi_position_estimation/service_timeout", service_timeout_, service_timeout_);
+  n.param("/wifi_position_estimation/min_trigger_interval", min_trigger_interval_, min_trigger_interval_);
+  n.param("/wifi_position_estimation/anytime_deadline", anytime_deadline_, anytime_deadline_);
+  n.param("/wifi_position_estimation/anytime_batch_size", anytime_batch_size_, anytime_batch_size_);
+  n.param("/wifi_position_estimation/publish_intermediate", publish_intermediate_, publish_intermediate_);
+  n.param("/wifi_position_estimation/trigger_cpu_budget", trigger_cpu_budget_, trigger_cpu_budget_);
+  n.param("/wifi_position_estimation/trigger_budget_window", trigger_budget_window_, trigger_budget_window_);
+
+  n.param("/wifi_position_estimation/result_cache_size", result_cache_size_, result_cache_size_);
+  n.param("/wifi_position_estimation/result_cache_quantization", result_cache_quantization_,
+          result_cache_quantization_);
+
+  n.param("/wifi_position_estimation/streaming_filter", streaming_filter_, streaming_filter_);
+  n.param("/wifi_position_estimation/filter_motion_noise", filter_motion_noise_, filter_motion_noise_);
+  n.param("/wifi_position_estimation/filter_scan_noise", filter_scan_noise_, filter_scan_noise_);
+  n.param("/wifi_position_estimation/filter_uniform_mix", filter_uniform_mix_, filter_uniform_mix_);
+
+  n.param("/wifi_position_estimation/tracking", tracking_, tracking_);
+  n.param("/wifi_position_estimation/tracker_min_particles", tracker_min_particles_, tracker_min_particles_);
+  n.param("/wifi_position_estimation/tracker_max_particles", tracker_max_particles_, tracker_max_particles_);
+  n.param("/wifi_position_estimation/tracker_converged_spread", tracker_converged_spread_, tracker_converged_spread_);
+  n.param("/wifi_position_estimation/tracker_translation_noise", tracker_translation_noise_,
+          tracker_translation_noise_);
+  n.param("/wifi_position_estimation/tracker_rotation_noise", tracker_rotation_noise_, tracker_rotation_noise_);
+
+  n.param("/wifi_position_estimation/kidnapping_monitor", kidnapping_monitor_, kidnapping_monitor_);
+  n.param("/wifi_position_estimation/monitor_ring_radius", monitor_ring_radius_, monitor_ring_radius_);
+  n.param("/wifi_position_estimation/monitor_ring_points", monitor_ring_points_, monitor_ring_points_);
+  n.param("/wifi_position_estimation/monitor_threshold", monitor_threshold, monitor_threshold);
+  n.param("/wifi_position_estimation/monitor_min_samples", monitor_min_samples, monitor_min_samples);
+  n.param("/wifi_position_estimation/monitor_consecutive_failures", monitor_consecutive_failures,
+          monitor_consecutive_failures);
+
+  n.param("/wifi_position_estimation/local_search", local_search_, local_search_);
+  n.param("/wifi_position_estimation/local_search_radius", local_search_radius_, local_search_radius_);
+  n.param("/wifi_position_estimation/local_search_growth", local_search_growth_, local_search_growth_);
+  n.param("/wifi_position_estimation/local_search_odom_factor", local_search_odom_factor_, local_search_odom_factor_);
+  n.param("/wifi_position_estimation/local_search_max_radius", local_search_max_radius_, local_search_max_radius_);
+  n.param("/wifi_position_estimation/local_search_particles", local_search_particles_, local_search_particles_);
+  n.param("/wifi_position_estimation/local_search_min_log_likelihood", local_search_min_log_likelihood_,
+          local_search_min_log_likelihood_);
+  n.param("/wifi_position_estimation/batch_threads", batch_threads_, batch_threads_);
+  n.param("/wifi_position_estimation/training_threads", training_threads_, training_threads_);
+  n.param("/wifi_position_estimation/batch_block_size", batch_block_size_, batch_block_size_);
+  n.param("/wifi_position_estimation/precompute_precision", precompute_precision_, precompute_precision_);
+  n.param("/wifi_position_estimation/precompute_cache", precompute_cache_enabled_, precompute_cache_enabled_);
+  n.param("/wifi_position_estimation/model_bundle", model_bundle_file_, model_bundle_file_);
+  n.param("/wifi_position_estimation/precision_check_scans", precision_check_scans_, precision_check_scans_);
+  n.param("/wifi_position_estimation/likelihood_table", likelihood_table_enabled_, likelihood_table_enabled_);
+  n.param("/wifi_position_estimation/likelihood_table_megabytes", likelihood_table_megabytes_,
+          likelihood_table_megabytes_);
+  n.param("/wifi_position_estimation/likelihood_table_resolution", likelihood_table_resolution_,
+          likelihood_table_resolution_);
+  n.param("/wifi_position_estimation/heatmap_rate", heatmap_rate_, heatmap_rate_);
+  n.param("/wifi_position_estimation/heatmap_resolution", heatmap_resolution_, heatmap_resolution_);
+  n.param("/wifi_position_estimation/hypotheses", hypotheses_, hypotheses_);
+  n.param("/wifi_position_estimation/hypothesis_separation", hypothesis_separation_, hypothesis_separation_);
+  n.param("/wifi_position_estimation/publish_hypothesis_array", publish_hypothesis_array_, publish_hypothesis_array_);
+  n.param("/wifi_position_estimation/min_position_variance", min_position_variance_, min_position_variance_);
+
+  if(refinement_rounds_ > 0 && refinement_particles_ <= 0)
+  {
+    ROS_WARN("refinement_particles has to be greater than 0. Disabling the refinement rounds.");
+    refinement_rounds_ = 0;
+  }
+  if(hypotheses_ > 0 && hypothesis_separation_ <= 0.0)
+  {
+    ROS_WARN("hypothesis_separation has to be greater than 0. Not publishing hypotheses.");
+    hypotheses_ = 0;
+  }
+  if(hypotheses_ > 0 && early_termination_)
+  {
+    ROS_WARN("The hypotheses need the full log likelihood of every particle. Disabling early_termination.");
+    early_termination_ = false;
+  }
+
+  monitor_ = KidnappingMonitor(monitor_threshold, monitor_min_samples, monitor_consecutive_failures);
+  scheduler_ = EstimationScheduler(min_trigger_interval_, trigger_cpu_budget_, trigger_budget_window_);
+  result_cache_ = ResultCache(result_cache_size_, result_cache_quantization_);
 
   ROS_INFO("particle count: %i", n_particles_);
   if(!path.empty())
@@ -75,7 +265,11 @@ WifiPositionEstimation::WifiPositionEstimation(ros::NodeHandle &n):precomputed_d
   AB_ = B - A_;
   AC_ = C - A_;
 
-  if(precompute_)
+  if(precompute_ && precompute_mode_ == "grid")
+  {
+    precomputed_grid_.set_geometry(amcl_map_, grid_resolution_);
+  }
+  else if(precompute_)
   {
     for(int i=0;i<n_particles_;i++)
     {
@@ -88,74 +282,236 @@ WifiPositionEstimation::WifiPositionEstimation(ros::NodeHandle &n):precomputed_d
 
   starting_point = {init_noise_, init_var_, init_l1_, init_l2_};
 
-  bool existing_params = true;
   boost::filesystem::path param_path(path+"/parameters");
+  boost::filesystem::create_directory(param_path);
+
+  // Scans of the training data, assembled from the files of all access points by their coordinates. Only collected
+  // for the accuracy check of the reduced precision storage.
+  std::map<std::pair<double, double>, Scan> recorded_scans;
+  bool collect_recorded_scans = precompute_ && precompute_mode_ != "grid" && precompute_precision_ != "double" &&
+                                precision_check_scans_ > 0;
+
+  // Everything the precomputed random points and their table depend on. The training data is added per file below.
+  CacheKey cache_key;
+  cache_key.add(amcl_map_.info.resolution);
+  cache_key.add(amcl_map_.info.width);
+  cache_key.add(amcl_map_.info.height);
+  cache_key.add(amcl_map_.info.origin.position.x);
+  cache_key.add(amcl_map_.info.origin.position.y);
+  cache_key.add(amcl_map_.data.data(), amcl_map_.data.size() * sizeof(amcl_map_.data[0]));
+  cache_key.add(n_particles_);
+  cache_key.add(precompute_precision_);
+
+  // Training files by packed mac. File names use '_' instead of ':', pack_mac accepts both.
+  std::vector<std::string> ignored_files;
+  std::map<uint64_t, std::string> training_files = mac_files(path, ignored_files);
+  for(auto& file:ignored_files)
+    ROS_WARN("Skipping file, whose name is not a mac address or names the mac address of another file: %s",
+             file.c_str());
 
-  if (!(boost::filesystem::exists(param_path)))
+  // Parameters are stored under the name of their training file.
+  auto parameter_file = [&path](const std::string &training_file)
   {
-    existing_params = false;
-    boost::filesystem::create_directory(param_path);
+    std::string name = training_file.substr(training_file.find_last_of("/") + 1);
+    return path + "/parameters/" + name.substr(0, name.find_last_of(".")) + ".csv";
+  };
+
+  std::map<uint64_t, uint64_t> training_keys;
+  CacheKey bundle_key;
+  for(auto& file:training_files)
+  {
+    training_keys[file.first] = training_key(file.second);
+    bundle_key.add(file.first);
+    bundle_key.add(training_keys[file.first]);
   }
 
-  for(directory_iterator itr(path); itr!=directory_iterator(); ++itr)
+  bool bundle_loaded = !model_bundle_file_.empty() && model_bundle_.load(model_bundle_file_, bundle_key.value());
+  if(bundle_loaded)
+  {
+    ROS_INFO("Mapped %i trained processes from %s.", model_bundle_.size(), model_bundle_file_.c_str());
+    for(int i = 0; i < model_bundle_.size(); i++)
+    {
+      if(mac_dictionary_.insert(model_bundle_.mac(i)) == int(processes_.size()))
+        processes_.push_back(Process(model_bundle_.model(i)));
+    }
+    // The bundle holds the normalized training data and the parameters, which is all the precomputation depends on.
+    cache_key.add(model_bundle_.data(), model_bundle_.bytes());
+    collect_recorded_scans = false;
+  }
+  else
   {
-    if(is_regular_file(itr->status()))
+    std::vector<uint64_t> macs;
+    std::vector<CSVDataLoader> data;
+    std::vector<Process> gps;
+    // Indices of the processes without stored parameters for their current training data and configuration
+    std::vector<int> stale;
+    for(auto& file:training_files)
     {
-      std::string file_path = path+"/"+itr->path().filename().generic_string();
-      std::string mac = file_path.substr( file_path.find_last_of("/") + 1 );
-      mac = mac.substr(0, mac.find_last_of("."));
-      CSVDataLoader data(file_path);
-      Process gp(data.coordinates_matrix_, data.observations_matrix_, 0.0, 0.0,  {0.0,0.0});
+      macs.push_back(file.first);
+      data.push_back(CSVDataLoader(file.second));
+      gps.push_back(Process(data.back().coordinates_matrix_, data.back().observations_matrix_, 0.0, 0.0, {0.0,0.0}));
 
-      if(!existing_params)
-      {
-        ROS_INFO("Training Gaussian process with data from path: %s", file_path.c_str());
-        gp.train_params(starting_point);
+      Eigen::Vector4d parameters;
+      if(read_parameters(parameter_file(file.second), training_keys[file.first], parameters))
+        gps.back().set_params(parameters(0), parameters(1), parameters(2), parameters(3));
+      else
+        stale.push_back(gps.size() - 1);
+    }
+
+    if(!stale.empty())
+    {
+      int n_threads = training_threads_ > 0 ? training_threads_ : std::max(int(std::thread::hardware_concurrency()), 1);
+      n_threads = std::min(n_threads, int(stale.size()));
+      ROS_INFO("Training %i of %i Gaussian processes with %i threads.", int(stale.size()), int(gps.size()), n_threads);
 
-        boost::shared_ptr<std::ofstream> new_params = boost::make_shared<std::ofstream>();
-        new_params->open(std::string(path+"/parameters/"+mac+".csv").c_str());
-        *new_params << "signal_noise, signal_var, lengthscale" << "\n";
-        Eigen::Vector4d parameters = gp.get_params();
-        *new_params << std::to_string(parameters(0))+", "+std::to_string(parameters(1))+", "+std::to_string(parameters(2))+", "+std::to_string(parameters(3)) << "\n";
-        new_params->flush();
+      // The processes are independent, so every thread trains every n_threads-th of them.
+      std::vector<std::thread> threads;
+      for(int t = 0; t < n_threads; t++)
+      {
+        threads.push_back(std::thread([&, t]()
+        {
+          for(size_t i = t; i < stale.size(); i += n_threads)
+          {
+            ROS_INFO("Training Gaussian process with data from path: %s", training_files.at(macs[stale[i]]).c_str());
+            gps[stale[i]].train_params(starting_point);
+          }
+        }));
       }
-      else
+      for(auto& thread:threads)
+        thread.join();
+
+      for(auto& i:stale)
+        write_parameters(parameter_file(training_files.at(macs[i])), training_keys[macs[i]], gps[i].get_params());
+    }
+
+    for(int i = 0; i < gps.size(); i++)
+    {
+      Eigen::Vector4d parameters = gps[i].get_params();
+      if(parameters(0) != 0.0 || parameters(1) != 0.0 || parameters(2) != 0.0 || parameters(3) != 0.0)
       {
-        std::ifstream file(path+"/parameters/"+mac+".csv");
-        std::string value;
-        std::string signal_noise;
-        std::string signal_var;
-        std::string lengthscale;
-        std::string lengthscale2;
-        getline(file, value, '\n');
-        getline(file, signal_noise, ',');
-        getline(file, signal_var, ',');
-        getline(file, lengthscale, ',');
-        getline(file, lengthscale2, '\n');
+        // The files are unique by mac, so every mac is new here. The index of its process has to be its index anyway.
+        if(mac_dictionary_.insert(macs[i]) != int(processes_.size()))
+          continue;
+        processes_.push_back(gps[i]);
 
-        gp.set_params(std::stod(signal_noise), std::stod(signal_var), std::stod(lengthscale), std::stod(lengthscale2));
-      }
+        cache_key.add(macs[i]);
+        cache_key.add(parameters.data(), 4 * sizeof(double));
+        cache_key.add(data[i].coordinates_matrix_.data(), data[i].coordinates_matrix_.size() * sizeof(double));
+        cache_key.add(data[i].observations_matrix_.data(), data[i].observations_matrix_.size() * sizeof(double));
 
-      //std::cout << "loaded params: " << gp.get_params() << std::endl;
+        for(int j = 0; collect_recorded_scans && j < data[i].coordinates_matrix_.rows(); j++)
+          recorded_scans[std::make_pair(data[i].coordinates_matrix_(j, 0), data[i].coordinates_matrix_(j, 1))].push_back(
+                  std::make_pair(int(processes_.size()) - 1, data[i].observations_matrix_(j)));
+      }
+    }
 
+    if(!model_bundle_file_.empty())
+    {
+      std::vector<uint64_t> packed_macs;
+      for(int i = 0; i < mac_dictionary_.size(); i++)
+        packed_macs.push_back(mac_dictionary_.mac(i));
+      if(ModelBundle::write(model_bundle_file_, bundle_key.value(), packed_macs, processes_))
+        ROS_INFO("Saved %i trained processes to %s.", int(processes_.size()), model_bundle_file_.c_str());
+      else
+        ROS_WARN("Could not save the trained processes to %s.", model_bundle_file_.c_str());
+    }
+  }
 
-      std::replace(mac.begin(),mac.end(),'_',':');
-      Eigen::Vector4d parameters = gp.get_params();
+  if(precompute_ && precompute_mode_ != "grid")
+  {
+    PrecomputedTable::Precision precision;
+    if(!PrecomputedTable::parse_precision(precompute_precision_, precision))
+    {
+      ROS_WARN("Unknown precompute precision %s. Using double.", precompute_precision_.c_str());
+      precision = PrecomputedTable::DOUBLE;
+    }
 
-      if(parameters(0) != 0.0 || parameters(1) != 0.0 || parameters(2) != 0.0 || parameters(3) != 0.0)
+    std::vector<PrecomputedDataPoint> precomputed_data;
+    std::string cache_file = PrecomputeCache::file_name(path + "/cache", cache_key.value());
+    if(precompute_cache_enabled_ &&
+       precompute_cache_.load(cache_file, cache_key.value(), processes_.size(), precision, random_points_,
+                              precomputed_table_))
+    {
+      ROS_INFO("Mapped %i precomputed points from %s.", int(random_points_.size()), cache_file.c_str());
+      // Only the likelihood tables need the values as doubles.
+      for(int point = 0; likelihood_table_enabled_ && point < random_points_.size(); point++)
       {
-        auto current_gp_it = gp_map_.insert(gp_map_.begin(), std::make_pair(mac, gp));
-        if(precompute_)
+        for(int ap = 0; ap < processes_.size(); ap++)
         {
-          for(auto& random_position:random_points_)
-          {
-            PrecomputedDataPoint data_point{&current_gp_it->second, 0.0, 0.0};
-            data_point.gp_->precompute_data(data_point, random_position);
-            precomputed_data_[random_position][mac] = data_point;
-          }
+          PrecomputedDataPoint point_data;
+          precomputed_table_.get(point, ap, point_data.mean_, point_data.variance_);
+          precomputed_data.push_back(point_data);
+        }
+      }
+    }
+    else
+    {
+      precomputed_data.resize(random_points_.size() * processes_.size());
+      for(int point = 0; point < random_points_.size(); point++)
+      {
+        for(int ap = 0; ap < processes_.size(); ap++)
+        {
+          processes_[ap].precompute_data(precomputed_data[point * processes_.size() + ap], random_points_[point]);
         }
       }
+
+      precomputed_table_.build(precomputed_data, random_points_.size(), processes_.size(), precision);
+      ROS_INFO("Precomputed table uses %f megabytes.", precomputed_table_.bytes() / (1024.0 * 1024.0));
+      if(!recorded_scans.empty())
+        check_precision(precomputed_data, recorded_scans);
+
+      if(precompute_cache_enabled_)
+      {
+        boost::filesystem::create_directory(path + "/cache");
+        if(PrecomputeCache::save(cache_file, cache_key.value(), random_points_, precomputed_table_))
+          ROS_INFO("Saved the precomputed points to %s.", cache_file.c_str());
+        else
+          ROS_WARN("Could not save the precomputed points to %s.", cache_file.c_str());
+      }
     }
+
+    if(likelihood_table_enabled_ &&
+       likelihood_table_.build(precomputed_data, random_points_.size(), processes_.size(),
+                               size_t(likelihood_table_megabytes_ * 1024.0 * 1024.0), likelihood_table_resolution_))
+      ROS_INFO("Built likelihood tables with %i clusters in %f megabytes, cluster step %f.",
+               likelihood_table_.clusters(), likelihood_table_.bytes() / (1024.0 * 1024.0),
+               likelihood_table_.cluster_step());
+    else if(likelihood_table_enabled_)
+      ROS_WARN("The likelihood tables do not fit into %f megabytes. Using the analytic log likelihood.",
+               likelihood_table_megabytes_);
+  }
+  else if(likelihood_table_enabled_)
+  {
+    ROS_WARN("The likelihood tables need the random_points precompute mode. Using the analytic log likelihood.");
+  }
+
+  if(precompute_ && precompute_mode_ == "grid")
+  {
+    ROS_INFO("Precomputing grid with a resolution of %f meters.", grid_resolution_);
+    precomputed_grid_.compute(processes_);
+
+    if(search_mode_ == "branch_and_bound")
+      likelihood_pyramid_.build(precomputed_grid_);
+  }
+  else if(search_mode_ == "branch_and_bound")
+  {
+    ROS_WARN("The branch_and_bound search mode needs the grid precompute mode. Sampling particles instead.");
+  }
+
+  compute_ap_bounds();
+  compute_ap_information();
+
+  if(incremental_scoring_)
+    setup_incremental_scoring();
+
+  if(streaming_filter_ && precompute_ && precompute_mode_ == "grid")
+  {
+    grid_filter_.reset(precomputed_grid_, filter_uniform_mix_);
+  }
+  else if(streaming_filter_)
+  {
+    ROS_WARN("The streaming filter needs the grid precompute mode. It is disabled.");
+    streaming_filter_ = false;
   }
 
   gp_grid_map_.setFrameId("map");
@@ -166,18 +522,88 @@ WifiPositionEstimation::WifiPositionEstimation(ros::NodeHandle &n):precomputed_d
 
   grid_map_publisher_ = n.advertise<grid_map_msgs::GridMap>("grid_map", 1000, true);
 
-  compute_starting_point_service_ = n.advertiseService("compute_amcl_start_point", &WifiPositionEstimation::publish_pose_service, this);
-  publish_accuracy_data_service_ = n.advertiseService("wifi_position_estimation", &WifiPositionEstimation::publish_accuracy_data, this);
+  if(heatmap_rate_ > 0.0)
+  {
+    heatmap_grid_map_.setFrameId("map");
+    grid_map::GridMapRosConverter::fromOccupancyGrid(amcl_map_, "log_likelihood", heatmap_grid_map_);
+    heatmap_grid_map_.setGeometry(heatmap_grid_map_.getLength(), heatmap_resolution_, heatmap_grid_map_.getPosition());
+    heatmap_grid_map_.add("posterior");
+    precompute_heatmap(amcl_map_);
+    heatmap_pub_ = n.advertise<grid_map_msgs::GridMap>("wifi_heatmap", 1);
+    heatmap_timer_ = n.createTimer(ros::Duration(1.0 / heatmap_rate_), &WifiPositionEstimation::heatmap_callback, this);
+  }
+
+  compute_starting_point_service_ = advertise_service<std_srvs::Empty>(
+          n, "compute_amcl_start_point", &WifiPositionEstimation::publish_pose_service, &service_queue_);
+  publish_accuracy_data_service_ = advertise_service<std_srvs::Empty>(
+          n, "wifi_position_estimation", &WifiPositionEstimation::publish_accuracy_data, &service_queue_);
   publish_grid_map_service_ = n.advertiseService("create_map_of_gp", &WifiPositionEstimation::publish_gp_map_service, this);
+  estimate_pose_service_ = advertise_service<wifi_localization::EstimatePose>(
+          n, "estimate_pose", &WifiPositionEstimation::estimate_pose_service, &service_queue_);
+  service_spinner_.reset(new ros::AsyncSpinner(1, &service_queue_));
+  service_spinner_->start();
+  estimate_pose_batch_service_ = advertise_service<wifi_localization::EstimatePoseBatch>(
+          n, "estimate_pose_batch", &WifiPositionEstimation::estimate_pose_batch_service, &batch_queue_);
+  batch_spinner_.reset(new ros::AsyncSpinner(1, &batch_queue_));
+  batch_spinner_->start();
+  intermediate_pub_ = n.advertise<geometry_msgs::PoseWithCovarianceStamped>("wifi_pos_estimation_intermediate", 10);
   initialpose_pub_ = n.advertise<geometry_msgs::PoseWithCovarianceStamped>("initialpose", 1000);
   wifi_sub_ = n.subscribe("wifi_data", 1000, &WifiPositionEstimation::wifi_callback, this);
+  wifi_compact_sub_ = n.subscribe("wifi_data_compact", 1000, &WifiPositionEstimation::wifi_compact_callback, this);
   max_weight_sub_ = n.subscribe("max_weight", 1000, &WifiPositionEstimation::max_weight_callback, this);
   wifi_pos_estimation_pub_ = n.advertise<wifi_localization::WifiPositionEstimation>("wifi_pos_estimation_data", 1000);
   amcl_sub_ = n.subscribe("amcl_pose", 1000, &WifiPositionEstimation::amcl_callback, this);
+  diagnostics_pub_ = n.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+  if(streaming_filter_)
+    filter_pub_ = n.advertise<geometry_msgs::PoseWithCovarianceStamped>("wifi_pos_filter", 10);
+  if(tracking_)
+    tracker_pub_ = n.advertise<geometry_msgs::PoseWithCovarianceStamped>("wifi_pos_tracker", 10);
+  if(hypotheses_ > 0)
+    hypotheses_pub_ = n.advertise<wifi_localization::WifiPoseHypotheses>("wifi_pos_hypotheses", 10);
+  if(hypotheses_ > 0 && publish_hypothesis_array_)
+    hypothesis_array_pub_ = n.advertise<geometry_msgs::PoseArray>("wifi_pos_hypotheses_array", 10);
+  if(streaming_filter_ || tracking_ || local_search_)
+    odom_sub_ = n.subscribe("odom", 100, &WifiPositionEstimation::odom_callback, this);
+
+  worker_ = std::thread(&WifiPositionEstimation::worker, this);
+  if(tracking_)
+  {
+    tracker_.configure(tracker_min_particles_, tracker_max_particles_, tracker_converged_spread_,
+                       tracker_translation_noise_, tracker_rotation_noise_);
+    tracker_thread_ = std::thread(&WifiPositionEstimation::tracker_loop, this);
+  }
 
   ROS_INFO("Finished initialization.");
 }
 
+WifiPositionEstimation::~WifiPositionEstimation()
+{
+  if(service_spinner_)
+    service_spinner_->stop();
+  compute_starting_point_service_.shutdown();
+  publish_accuracy_data_service_.shutdown();
+  estimate_pose_service_.shutdown();
+  if(batch_spinner_)
+    batch_spinner_->stop();
+  estimate_pose_batch_service_.shutdown();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    state_ = STOPPING;
+  }
+  request_added_.notify_one();
+  if(worker_.joinable())
+    worker_.join();
+
+  {
+    std::lock_guard<std::mutex> lock(tracker_mutex_);
+    tracker_stop_ = true;
+  }
+  tracker_scan_added_.notify_one();
+  if(tracker_thread_.joinable())
+    tracker_thread_.join();
+}
+
 Eigen::Vector2d WifiPositionEstimation::random_position()
 {
   double u = (double)rand() / RAND_MAX;
@@ -186,174 +612,1887 @@ Eigen::Vector2d WifiPositionEstimation::random_position()
   return (A_ + u*AB_ + v*AC_);
 }
 
-bool WifiPositionEstimation::publish_pose_service(std_srvs::Empty::Request  &req,
-                          std_srvs::Empty::Response &res)
+void WifiPositionEstimation::check_precision(const std::vector<PrecomputedDataPoint> &data,
+                                             const std::map<std::pair<double, double>, Scan> &recorded_scans)
 {
-  geometry_msgs::PoseWithCovarianceStamped pose = compute_pose();
-  pose.header.stamp = ros::Time::now();
-  initialpose_pub_.publish(pose);
-  computing_ = false;
+  int checked = 0;
+  int unchanged = 0;
+  double max_distance = 0.0;
+  for(auto& recorded:recorded_scans)
+  {
+    if(checked == precision_check_scans_)
+      break;
+    checked++;
 
-  return true;
-}
+    int best = -1;
+    int reduced_best = -1;
+    double best_log_likelihood = -std::numeric_limits<double>::infinity();
+    double reduced_best_log_likelihood = -std::numeric_limits<double>::infinity();
+    for(int point = 0; point < random_points_.size(); point++)
+    {
+      double total = 0.0;
+      double reduced_total = 0.0;
+      for(auto& observation:recorded.second)
+      {
+        const PrecomputedDataPoint &point_data = data[point * processes_.size() + observation.first];
+        double log_prob = Process::log_probability_precomputed(point_data.mean_, point_data.variance_,
+                                                               observation.second);
+        double reduced_log_prob = precomputed_table_.log_probability(point, observation.first, observation.second);
+        if(!std::isnan(log_prob))
+          total += log_prob;
+        if(!std::isnan(reduced_log_prob))
+          reduced_total += reduced_log_prob;
+      }
+      if(total > best_log_likelihood)
+      {
+        best_log_likelihood = total;
+        best = point;
+      }
+      if(reduced_total > reduced_best_log_likelihood)
+      {
+        reduced_best_log_likelihood = reduced_total;
+        reduced_best = point;
+      }
+    }
 
-bool WifiPositionEstimation::publish_accuracy_data(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
-{
-  geometry_msgs::PoseWithCovarianceStamped pose = compute_pose();
-  wifi_localization::WifiPositionEstimation msg;
-  msg.pos_x = x_pos_;
-  msg.pos_y = y_pos_;
-  msg.estimated_pos_x = pose.pose.pose.position.x;
-  msg.estimated_pos_y = pose.pose.pose.position.y;
-  msg.amcl_diff = sqrt(pow((pose.pose.pose.position.x - x_pos_),2)+pow((pose.pose.pose.position.y - y_pos_),2));
-  msg.header.stamp = ros::Time::now();
-  wifi_pos_estimation_pub_.publish(msg);
-  computing_ = false;
+    if(best == reduced_best)
+      unchanged++;
+    else if(best != -1 && reduced_best != -1)
+      max_distance = std::max(max_distance, (random_points_[best] - random_points_[reduced_best]).norm());
+  }
 
-  return true;
+  if(unchanged == checked)
+    ROS_INFO("Precision check: the most likely point of all %i recorded scans is unchanged.", checked);
+  else
+    ROS_WARN("Precision check: the most likely point changed for %i of %i recorded scans, by up to %f meters.",
+             checked - unchanged, checked, max_distance);
 }
 
-geometry_msgs::PoseWithCovarianceStamped WifiPositionEstimation::compute_pose()
+void WifiPositionEstimation::compute_ap_bounds()
 {
-  computing_ = true;
-  ROS_INFO("Starting position estimation.");
-  Vector2d most_likely_pos;
-  double highest_prob = 0.0;
-  std::sort(macs_and_strengths_.begin(), macs_and_strengths_.end(),
-            boost::bind(&std::pair<std::string, double>::second, _1) >
-            boost::bind(&std::pair<std::string, double>::second, _2));
+  ap_bounds_.clear();
+  for(int ap = 0; ap < processes_.size(); ap++)
+  {
+    // Without precomputed data, only the noise of the process bounds the variance from below.
+    ApBounds bounds{-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+                    processes_[ap].noise_variance(), std::numeric_limits<double>::infinity()};
+    ap_bounds_.push_back(bounds);
+  }
+
+  if(!precompute_)
+    return;
+
+  for(auto& bounds:ap_bounds_)
+    bounds = {std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+              std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
 
-  if(precompute_)
+  auto update = [](ApBounds &bounds, double mean, double variance)
   {
-    // Iterate over the coordinates
-    for(auto& it:precomputed_data_)
+    bounds.mean_min = std::min(bounds.mean_min, mean);
+    bounds.mean_max = std::max(bounds.mean_max, mean);
+    // Interpolating between variances of different signs can get arbitrarily close to zero.
+    bounds.variance_min = variance < 0.0 ? 0.0 : std::min(bounds.variance_min, variance);
+    bounds.variance_max = std::max(bounds.variance_max, fabs(variance));
+  };
+
+  if(precompute_mode_ == "grid")
+  {
+    for(int row = 0; row < precomputed_grid_.rows(); row++)
+      for(int col = 0; col < precomputed_grid_.cols(); col++)
+        if(precomputed_grid_.is_computed_node(col, row))
+          for(int ap = 0; ap < processes_.size(); ap++)
+            update(ap_bounds_[ap], precomputed_grid_.node_mean(col, row, ap),
+                   precomputed_grid_.node_variance(col, row, ap));
+  }
+  else
+  {
+    for(int point = 0; point < precomputed_table_.points(); point++)
     {
-      Eigen::Vector2d current_coordinate = it.first;
-      // std::cout << "current coordinate: " << current_coordinate(0) << ", " << current_coordinate(1) << std::endl;
+      for(int ap = 0; ap < processes_.size(); ap++)
+      {
+        double mean;
+        double variance;
+        precomputed_table_.get(point, ap, mean, variance);
+        update(ap_bounds_[ap], mean, variance);
+      }
+    }
+  }
+}
 
-      double total_prob = 1.0;
+void WifiPositionEstimation::setup_incremental_scoring()
+{
+  incremental_particles_.clear();
+  IncrementalScorer::Predictor predictor;
 
-      // Iterate over the current macs and the associated strengths
-      for(auto& it2:macs_and_strengths_)
+  if(precompute_ && precompute_mode_ == "grid")
+  {
+    std::vector<std::pair<int, int>> nodes;
+    for(int row = 0; row < precomputed_grid_.rows(); row++)
+    {
+      for(int col = 0; col < precomputed_grid_.cols(); col++)
       {
-        auto data = it.second.find(it2.first);
-
-        if(data != it.second.end())
+        if(precomputed_grid_.is_free_node(col, row))
         {
-          double prob = data->second.gp_->probability_precomputed(data->second.mean_, data->second.variance_, it2.second);
-
-          if(std::isnan(prob))
-            prob = 1.0;
-          total_prob *= prob;
+          nodes.push_back(std::make_pair(col, row));
+          incremental_particles_.push_back(precomputed_grid_.node_position(col, row));
         }
       }
-      if(total_prob > highest_prob)
-      {
-        highest_prob = total_prob;
-        most_likely_pos = {current_coordinate(0), current_coordinate(1)};
-        // std::cout << "Newest most likely pos: " << random_point(0) << " and " << random_point(1) << std::endl;
-        // std::cout << "With probability: " << highest_prob << std::endl;
-      }
     }
+    predictor = [this, nodes](int particle, int ap, double &mean, double &variance)
+    {
+      mean = precomputed_grid_.node_mean(nodes[particle].first, nodes[particle].second, ap);
+      variance = precomputed_grid_.node_variance(nodes[particle].first, nodes[particle].second, ap);
+    };
+  }
+  else if(precompute_)
+  {
+    incremental_particles_ = random_points_;
+    predictor = [this](int particle, int ap, double &mean, double &variance)
+    {
+      precomputed_table_.get(particle, ap, mean, variance);
+    };
   }
-
   else
   {
-    for(int i = 0; i < n_particles_; ++i)
+    for(int i = 0; i < n_particles_; i++)
+      incremental_particles_.push_back(random_position());
+    predictor = [this](int particle, int ap, double &mean, double &variance)
     {
-      double total_prob = 1.0;
+      processes_[ap].predict(incremental_particles_[particle](0), incremental_particles_[particle](1), mean, variance);
+    };
+  }
 
-      Eigen::Vector2d random_point = random_position();
+  incremental_scorer_.reset(incremental_particles_.size(), predictor, incremental_full_rescore_);
+  ROS_INFO("Incremental scoring uses %i particles.", int(incremental_particles_.size()));
+}
 
-      // std::cout << "current coordinate: " << random_point(0) << ", " << random_point(1) << std::endl;
+void WifiPositionEstimation::compute_ap_information()
+{
+  std::vector<double> mean_sum(processes_.size(), 0.0);
+  std::vector<double> squared_mean_sum(processes_.size(), 0.0);
+  std::vector<double> variance_sum(processes_.size(), 0.0);
+  std::vector<int> count(processes_.size(), 0);
 
-      for(auto it:macs_and_strengths_)
-      {
-        std::map<std::string, Process>::iterator data = gp_map_.find(it.first);
+  auto add = [&](int ap, double mean, double variance)
+  {
+    mean_sum[ap] += mean;
+    squared_mean_sum[ap] += mean * mean;
+    variance_sum[ap] += fabs(variance);
+    count[ap]++;
+  };
 
-        if(data != gp_map_.end())
-        {
-          double prob = data->second.probability(random_point(0), random_point(1), it.second);
-          if(std::isnan(prob))
-            prob = 1.0;
-          total_prob *= prob;
-        }
-      }
-      if(total_prob > highest_prob)
+  if(precompute_ && precompute_mode_ == "grid")
+  {
+    for(int row = 0; row < precomputed_grid_.rows(); row++)
+      for(int col = 0; col < precomputed_grid_.cols(); col++)
+        if(precomputed_grid_.is_free_node(col, row))
+          for(int ap = 0; ap < processes_.size(); ap++)
+            add(ap, precomputed_grid_.node_mean(col, row, ap), precomputed_grid_.node_variance(col, row, ap));
+  }
+  else if(precompute_)
+  {
+    for(int point = 0; point < precomputed_table_.points(); point++)
+    {
+      for(int ap = 0; ap < processes_.size(); ap++)
       {
-        highest_prob = total_prob;
-        most_likely_pos = {random_point(0), random_point(1)};
-        // std::cout << "Newest most likely pos: " << random_point(0) << " and " << random_point(1) << std::endl;
-        // std::cout << "With probability: " << highest_prob << std::endl;
+        double mean;
+        double variance;
+        precomputed_table_.get(point, ap, mean, variance);
+        add(ap, mean, variance);
       }
     }
   }
+  else
+  {
+    // Without precomputed data, the training observations and the noise of the process have to do.
+    for(int ap = 0; ap < processes_.size(); ap++)
+    {
+      auto observations = processes_[ap].training_observations();
+      for(int i = 0; i < observations.rows(); i++)
+        add(ap, observations(i), processes_[ap].noise_variance());
+    }
+  }
 
-  ROS_INFO("Estimated position: %f, %f", most_likely_pos(0), most_likely_pos(1));
+  ap_information_.assign(processes_.size(), 0.0);
+  for(int ap = 0; ap < processes_.size(); ap++)
+  {
+    if(count[ap] == 0)
+      continue;
+    double mean = mean_sum[ap] / count[ap];
+    double spatial_variance = std::max(squared_mean_sum[ap] / count[ap] - mean * mean, 0.0);
+    double average_variance = std::max(variance_sum[ap] / count[ap], 1e-12);
 
-  geometry_msgs::PoseWithCovarianceStamped pose;
-  pose.header.frame_id = "map";
-  pose.pose.pose.position.x = most_likely_pos(0);
-  pose.pose.pose.position.y = most_likely_pos(1);
-  pose.pose.pose.position.z = 0.0;
-  pose.pose.pose.orientation.w = 1.0;
-  pose.pose.covariance = {0.0};
-  pose.pose.covariance[0] = 2.0;
-  pose.pose.covariance[7] = 2.0;
-  pose.pose.covariance[14] = 0.0;
-  pose.pose.covariance[21] = 0.0;
-  pose.pose.covariance[28] = 0.0;
-  pose.pose.covariance[35] = M_PI;
+    // Mutual information between position and observation, if both were Gaussian.
+    double information = 0.5 * log(1.0 + spatial_variance / average_variance);
 
-  return pose;
+    // Processes trained on only a few observations are trusted less.
+    double n_training = processes_[ap].training_size();
+    ap_information_[ap] = information * n_training / (n_training + 20.0);
+  }
+}
 
+std::vector<double> WifiPositionEstimation::remaining_log_likelihood_bounds(
+  const std::vector<std::pair<int, double>> &observations)
+{
+  std::vector<double> remaining_bounds(observations.size() + 1, 0.0);
+  for(int j = int(observations.size()) - 1; j >= 0; j--)
+  {
+    const ApBounds &bounds = ap_bounds_[observations[j].first];
+    double bound = Process::log_probability_bound(bounds.mean_min, bounds.mean_max, bounds.variance_min,
+                                                  bounds.variance_max, observations[j].second);
+    // The bound is NaN for processes without precomputed data, which never contribute to the log likelihood.
+    if(std::isnan(bound))
+      bound = 0.0;
+    remaining_bounds[j] = remaining_bounds[j + 1] + bound;
+  }
+  return remaining_bounds;
 }
 
-void WifiPositionEstimation::wifi_callback(const wifi_localization::WifiState::ConstPtr& msg)
+double WifiPositionEstimation::pruning_threshold(const std::vector<std::pair<double, Eigen::Vector2d>> &candidates,
+                                                 double highest_log_likelihood)
 {
-  if(!computing_ && !msg->macs.empty())
+  // When the best candidates are kept for the gradient refinement, a particle only has to beat the worst of them.
+  if(gradient_refinement_top_k_ > 0)
   {
-    std::vector<std::pair<std::string, double>> mas;
-    for (int i = 0; i < msg->macs.size(); i++)
-    {
-      std::string mac_name = msg->macs.at(i);
-      double wifi_dbm = msg->strengths.at(i);
+    if(candidates.size() < gradient_refinement_top_k_)
+      return -std::numeric_limits<double>::infinity();
+    return candidates.back().first;
+  }
+  return highest_log_likelihood;
+}
 
-      mas.push_back(std::make_pair(mac_name, wifi_dbm));
-    }
-    macs_and_strengths_ = mas;
+bool WifiPositionEstimation::random_free_position(Eigen::Vector2d &position)
+{
+  // Give up after a number of tries, in case the map barely contains free space.
+  for(int i = 0; i < 100; i++)
+  {
+    position = random_position();
+    if(precomputed_grid_.is_free(position(0), position(1)))
+      return true;
   }
+  return false;
 }
 
-void WifiPositionEstimation::max_weight_callback(const wifi_localization::MaxWeight::ConstPtr& msg)
+bool WifiPositionEstimation::publish_pose_service(std_srvs::Empty::Request  &req,
+                          std_srvs::Empty::Response &res)
+{
+  wait_for_result(enqueue_request(EstimationRequest::INITIAL_POSE));
+  return true;
+}
+
+bool WifiPositionEstimation::publish_accuracy_data(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
+{
+  wait_for_result(enqueue_request(EstimationRequest::ACCURACY_DATA));
+  return true;
+}
+
+bool WifiPositionEstimation::estimate_pose_service(wifi_localization::EstimatePose::Request &req,
+                                                   wifi_localization::EstimatePose::Response &res)
+{
+  double deadline = req.deadline > 0.0 ? req.deadline : anytime_deadline_;
+  std::shared_future<EstimationResult> future = enqueue_request(EstimationRequest::RESPONSE_ONLY, true, deadline,
+                                                                req.publish_intermediate);
+  // The deadline only stops the estimation itself, so a request queued behind others is bounded by the timeout.
+  if(!wait_for_result(future, deadline))
+    return false;
+
+  EstimationResult result = future.get();
+  res.pose = result.pose;
+  res.log_likelihood = result.log_likelihood;
+  res.spread = result.spread;
+  res.converged = result.converged;
+  res.completed = result.completed;
+  res.evaluated_particles = result.evaluations;
+  return result.valid;
+}
+
+bool WifiPositionEstimation::estimate_pose_batch_service(wifi_localization::EstimatePoseBatch::Request &req,
+                                                         wifi_localization::EstimatePoseBatch::Response &res)
 {
-  if(msg->max_weight > quality_threshold_ && !computing_)
+  if(req.ids.size() != req.scans.size())
+  {
+    ROS_WARN("Batch has %i ids for %i scans.", int(req.ids.size()), int(req.scans.size()));
+    return false;
+  }
+
+  std::vector<Scan> scans;
+  for(auto& msg:req.scans)
+    scans.push_back(scan_from_message(msg));
+
+  std::vector<Eigen::Vector2d> positions;
+  std::vector<double> log_likelihoods;
+  batch_estimate(scans, positions, log_likelihoods);
+
+  res.ids = req.ids;
+  for(size_t i = 0; i < scans.size(); i++)
   {
-    compute_pose();
+    geometry_msgs::PoseWithCovarianceStamped pose = pose_from_position(positions[i]);
+    pose.header.stamp = req.scans[i].header.stamp;
+    res.poses.push_back(pose);
+    res.log_likelihoods.push_back(log_likelihoods[i]);
   }
+  return true;
 }
 
-void WifiPositionEstimation::amcl_callback(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr& msg)
+void WifiPositionEstimation::batch_estimate(const std::vector<Scan> &scans, std::vector<Eigen::Vector2d> &positions,
+                                            std::vector<double> &log_likelihoods)
 {
-  x_pos_ = msg->pose.pose.position.x;
-  y_pos_ = msg->pose.pose.position.y;
+  ros::WallTime start = ros::WallTime::now();
+  std::vector<std::vector<std::pair<int, double>>> observations;
+  for(auto& scan:scans)
+    observations.push_back(indexed_observations(scan));
+
+  positions.assign(scans.size(), Eigen::Vector2d::Zero());
+  log_likelihoods.assign(scans.size(), -std::numeric_limits<double>::infinity());
+  if(scans.empty())
+    return;
+
+  bool use_grid = precompute_ && precompute_mode_ == "grid";
+  bool use_points = precompute_ && !use_grid;
+  std::vector<Eigen::Vector2d> points;
+  std::vector<std::pair<int, int>> nodes;
+  if(use_grid)
+  {
+    for(int row = 0; row < precomputed_grid_.rows(); row++)
+    {
+      for(int col = 0; col < precomputed_grid_.cols(); col++)
+      {
+        if(!precomputed_grid_.is_free_node(col, row))
+          continue;
+        nodes.push_back(std::make_pair(col, row));
+        points.push_back(precomputed_grid_.node_position(col, row));
+      }
+    }
+  }
+  else if(use_points)
+    points = random_points_;
+  else
+  {
+    for(int i = 0; i < n_particles_; i++)
+      points.push_back(random_position());
+  }
+
+  int n_points = points.size();
+  int n_threads = batch_threads_ > 0 ? batch_threads_ : std::max(int(std::thread::hardware_concurrency()), 1);
+  n_threads = std::min(n_threads, int(scans.size()));
+
+  PositionData data = [&](int point, int ap, double &mean, double &variance)
+  {
+    if(use_grid)
+    {
+      mean = precomputed_grid_.node_mean(nodes[point].first, nodes[point].second, ap);
+      variance = precomputed_grid_.node_variance(nodes[point].first, nodes[point].second, ap);
+    }
+    else if(use_points)
+      precomputed_table_.get(point, ap, mean, variance);
+    else
+      processes_[ap].predict(points[point](0), points[point](1), mean, variance);
+  };
+
+  BlockScores keep_best = [&](int scan, int first_point, const double *scores, int n)
+  {
+    for(int i = 0; i < n; i++)
+    {
+      if(scores[i] > log_likelihoods[scan])
+      {
+        log_likelihoods[scan] = scores[i];
+        positions[scan] = points[first_point + i];
+      }
+    }
+  };
+
+  // Every thread localizes a contiguous share of the scans.
+  auto localize = [&](int first_scan, int last_scan)
+  {
+    score_blocks(observations, first_scan, last_scan, 0, n_points, data, keep_best);
+  };
+
+  std::vector<std::thread> threads;
+  int scans_per_thread = (scans.size() + n_threads - 1) / n_threads;
+  for(int first = 0; first < scans.size(); first += scans_per_thread)
+    threads.push_back(std::thread(localize, first, std::min(first + scans_per_thread, int(scans.size()))));
+  for(auto& thread:threads)
+    thread.join();
+
+  ROS_INFO("Localized %i scans against %i positions with %i threads in %f seconds.", int(scans.size()), n_points,
+           int(threads.size()), (ros::WallTime::now() - start).toSec());
 }
 
-bool WifiPositionEstimation::publish_gp_map_service(wifi_localization::PlotGP::Request &req,
-                                                    wifi_localization::PlotGP::Response &res)
+void WifiPositionEstimation::score_blocks(const std::vector<std::vector<std::pair<int, double>>> &observations,
+                                          int first_scan, int last_scan, int first_point, int last_point,
+                                          const PositionData &data, const BlockScores &scores)
 {
-  std::string mac = req.mac;
+  int block_size = std::max(batch_block_size_, 1);
 
-  auto it = gp_map_.find(mac);
-  if(it == gp_map_.end())
+  // Slot of every access point in the block tables, -1 if none of the scans observed it
+  std::vector<int> slots(processes_.size(), -1);
+  std::vector<int> aps;
+  for(int s = first_scan; s < last_scan; s++)
+  {
+    for(auto& observation:observations[s])
+    {
+      if(slots[observation.first] == -1)
+      {
+        slots[observation.first] = aps.size();
+        aps.push_back(observation.first);
+      }
+    }
+  }
+
+  std::vector<double> means(aps.size() * block_size);
+  std::vector<double> variances(aps.size() * block_size);
+  std::vector<double> totals(block_size);
+  for(int block = first_point; block < last_point; block += block_size)
+  {
+    int n = std::min(block_size, last_point - block);
+    for(size_t slot = 0; slot < aps.size(); slot++)
+      for(int i = 0; i < n; i++)
+        data(block + i, aps[slot], means[slot * block_size + i], variances[slot * block_size + i]);
+
+    for(int s = first_scan; s < last_scan; s++)
+    {
+      if(observations[s].empty())
+        continue;
+      std::fill(totals.begin(), totals.begin() + n, 0.0);
+      for(auto& observation:observations[s])
+      {
+        int offset = slots[observation.first] * block_size;
+        for(int i = 0; i < n; i++)
+        {
+          double log_prob = Process::log_probability_precomputed(means[offset + i], variances[offset + i],
+                                                                 observation.second);
+          if(!std::isnan(log_prob))
+            totals[i] += log_prob;
+        }
+      }
+      scores(s, block, totals.data(), n);
+    }
+  }
+}
+
+bool WifiPositionEstimation::map_free(const nav_msgs::OccupancyGrid &map, const Eigen::Vector2d &position)
+{
+  int map_x = int(std::floor((position(0) - map.info.origin.position.x) / map.info.resolution));
+  int map_y = int(std::floor((position(1) - map.info.origin.position.y) / map.info.resolution));
+  if(map_x < 0 || map_y < 0 || map_x >= int(map.info.width) || map_y >= int(map.info.height))
+    return false;
+  int8_t occupancy = map.data[map_y * map.info.width + map_x];
+  return occupancy >= 0 && occupancy < 50;
+}
+
+void WifiPositionEstimation::precompute_heatmap(const nav_msgs::OccupancyGrid &map)
+{
+  ros::WallTime start = ros::WallTime::now();
+  bool use_grid = precompute_ && precompute_mode_ == "grid";
+  std::vector<Eigen::Vector2d> positions;
+  heatmap_cells_.clear();
+  for(grid_map::GridMapIterator it(heatmap_grid_map_); !it.isPastEnd(); ++it)
+  {
+    grid_map::Position position;
+    heatmap_grid_map_.getPosition(*it, position);
+    // Cells in obstacles are left empty in every mode. The grid additionally needs the cell to be interpolated.
+    if(!map_free(map, position) || (use_grid && !precomputed_grid_.is_free(position(0), position(1))))
+      continue;
+    heatmap_cells_.push_back(*it);
+    positions.push_back(position);
+  }
+  heatmap_grid_map_.clearAll();
+
+  int n_aps = processes_.size();
+  heatmap_means_.resize(positions.size() * n_aps);
+  heatmap_variances_.resize(positions.size() * n_aps);
+  auto compute = [&](int first, int last)
+  {
+    for(int cell = first; cell < last; cell++)
+    {
+      for(int ap = 0; ap < n_aps; ap++)
+      {
+        double &mean = heatmap_means_[cell * n_aps + ap];
+        double &variance = heatmap_variances_[cell * n_aps + ap];
+        if(!use_grid)
+          processes_[ap].predict(positions[cell](0), positions[cell](1), mean, variance);
+        else if(!precomputed_grid_.interpolate(ap, positions[cell](0), positions[cell](1), mean, variance))
+          mean = variance = std::numeric_limits<double>::quiet_NaN();
+      }
+    }
+  };
+
+  int n_cells = positions.size();
+  int n_threads = batch_threads_ > 0 ? batch_threads_ : std::max(int(std::thread::hardware_concurrency()), 1);
+  int cells_per_thread = (n_cells + n_threads - 1) / n_threads;
+  std::vector<std::thread> threads;
+  for(int first = 0; first < n_cells; first += cells_per_thread)
+    threads.push_back(std::thread(compute, first, std::min(first + cells_per_thread, n_cells)));
+  for(auto& thread:threads)
+    thread.join();
+
+  ROS_INFO("Precomputed the heatmap for %i free cells and %i access points in %f seconds.", n_cells, n_aps,
+           (ros::WallTime::now() - start).toSec());
+}
+
+void WifiPositionEstimation::heatmap_callback(const ros::TimerEvent &event)
+{
+  std::shared_ptr<const Scan> scan;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!latest_scan_ || latest_scan_ == heatmap_scan_)
+      return;
+    scan = latest_scan_;
+  }
+  heatmap_scan_ = scan;
+
+  ros::WallTime start = ros::WallTime::now();
+  std::vector<std::vector<std::pair<int, double>>> observations(1, indexed_observations(*scan));
+  if(observations[0].empty() || heatmap_cells_.empty())
+    return;
+
+  // The means and variances were precomputed, so a scan only looks them up.
+  int n_aps = processes_.size();
+  PositionData data = [&](int point, int ap, double &mean, double &variance)
+  {
+    mean = heatmap_means_[point * n_aps + ap];
+    variance = heatmap_variances_[point * n_aps + ap];
+  };
+
+  int n_cells = heatmap_cells_.size();
+  std::vector<double> log_likelihoods(n_cells);
+  BlockScores store = [&](int scan, int first_point, const double *scores, int n)
+  {
+    std::copy(scores, scores + n, log_likelihoods.begin() + first_point);
+  };
+
+  int n_threads = batch_threads_ > 0 ? batch_threads_ : std::max(int(std::thread::hardware_concurrency()), 1);
+  int cells_per_thread = (n_cells + n_threads - 1) / n_threads;
+  std::vector<std::thread> threads;
+  for(int first = 0; first < n_cells; first += cells_per_thread)
+    threads.push_back(std::thread(&WifiPositionEstimation::score_blocks, this, std::cref(observations), 0, 1, first,
+                                  std::min(first + cells_per_thread, n_cells), std::cref(data), std::cref(store)));
+  for(auto& thread:threads)
+    thread.join();
+
+  // Only free cells were rendered, the others stay empty. The posterior is normalized with a log-sum-exp.
+  double max_log_likelihood = -std::numeric_limits<double>::infinity();
+  for(auto& it:log_likelihoods)
+    max_log_likelihood = std::max(max_log_likelihood, it);
+  if(std::isinf(max_log_likelihood))
+    return;
+  double sum = 0.0;
+  for(auto& it:log_likelihoods)
+    sum += exp(it - max_log_likelihood);
+
+  for(int i = 0; i < n_cells; i++)
+  {
+    heatmap_grid_map_.at("log_likelihood", heatmap_cells_[i]) = log_likelihoods[i];
+    heatmap_grid_map_.at("posterior", heatmap_cells_[i]) = exp(log_likelihoods[i] - max_log_likelihood) / sum;
+  }
+
+  heatmap_grid_map_.setTimestamp(ros::Time::now().toNSec());
+  grid_map_msgs::GridMap message;
+  grid_map::GridMapRosConverter::toMessage(heatmap_grid_map_, message);
+  message.info.header.frame_id = "map";
+  heatmap_pub_.publish(message);
+  ROS_INFO("Rendered the likelihood heatmap of %i cells in %f seconds.", n_cells,
+           (ros::WallTime::now() - start).toSec());
+}
+
+std::shared_future<EstimationResult> WifiPositionEstimation::enqueue_request(EstimationRequest::Target target)
+{
+  return enqueue_request(target, anytime_deadline_ > 0.0, anytime_deadline_, publish_intermediate_);
+}
+
+std::shared_future<EstimationResult> WifiPositionEstimation::enqueue_request(EstimationRequest::Target target,
+                                                                             bool anytime, double deadline,
+                                                                             bool publish_intermediate)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return enqueue_request_locked(target, anytime, deadline, publish_intermediate);
+}
+
+std::shared_future<EstimationResult> WifiPositionEstimation::enqueue_request_locked(EstimationRequest::Target target,
+                                                                                    bool anytime, double deadline,
+                                                                                    bool publish_intermediate)
+{
+  EstimationRequest request;
+  request.target = target;
+  request.scan = latest_scan_;
+  request.amcl_x = x_pos_;
+  request.amcl_y = y_pos_;
+  request.local = false;
+  if(local_search_ && has_trusted_pose_ && !anytime)
+  {
+    double elapsed = (ros::Time::now() - trusted_time_).toSec();
+    double radius = local_search_radius_ + local_search_growth_ * elapsed +
+                    local_search_odom_factor_ * trusted_odom_distance_;
+    if(radius <= local_search_max_radius_)
+    {
+      request.local = true;
+      request.window = {trusted_position_(0), trusted_position_(1), radius};
+    }
+  }
+  request.anytime = anytime;
+  request.deadline = deadline > 0.0 ? std::chrono::steady_clock::now() +
+                                      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                              std::chrono::duration<double>(deadline))
+                                    : std::chrono::steady_clock::time_point::max();
+  request.publish_intermediate = publish_intermediate;
+  request.result = std::make_shared<std::promise<EstimationResult>>();
+  std::shared_future<EstimationResult> result = request.result->get_future().share();
+
+  // Nearly identical scans are answered from the cache without involving the worker thread. Local searches are not
+  // cached, their result depends on the window as well as on the scan.
+  request.fingerprint = result_cache_.fingerprint(*request.scan);
+  EstimationResult cached;
+  if(!request.local && result_cache_.find(request.fingerprint, cached))
+  {
+    cached.pose.header.stamp = ros::Time::now();
+    publish_result(request, cached);
+    request.result->set_value(cached);
+    publish_diagnostics(false);
+    // Triggers coalesced meanwhile start the next estimation right away.
+    if(target == EstimationRequest::TRIGGERED &&
+       scheduler_.finished(cached.pose.header.stamp.toSec(), 0.0, latest_scan_stamp_))
+      enqueue_request_locked(EstimationRequest::TRIGGERED, anytime_deadline_ > 0.0, anytime_deadline_,
+                             publish_intermediate_);
+    return result;
+  }
+
+  requests_.push_back(request);
+  if(state_ == IDLE)
+    state_ = QUEUED;
+  request_added_.notify_one();
+  return result;
+}
+
+bool WifiPositionEstimation::wait_for_result(const std::shared_future<EstimationResult> &result, double deadline)
+{
+  if(service_timeout_ < 0.0)
+  {
+    result.wait();
+    return true;
+  }
+
+  double timeout = service_timeout_ + std::max(deadline, 0.0);
+  if(result.wait_for(std::chrono::duration<double>(timeout)) == std::future_status::ready)
+    return true;
+  if(timeout > 0.0)
+    ROS_WARN("Position estimation did not finish within %f seconds. The result is published when it is ready.",
+             timeout);
+  return false;
+}
+
+void WifiPositionEstimation::worker()
+{
+  while(true)
+  {
+    EstimationRequest request;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      request_added_.wait(lock, [this] { return state_ == STOPPING || !requests_.empty(); });
+      if(state_ == STOPPING)
+        return;
+      request = requests_.front();
+      requests_.pop_front();
+      state_ = COMPUTING;
+    }
+
+    double cpu_start = thread_cpu_time();
+    EstimationResult result;
+    if(request.anytime)
+    {
+      result = anytime_estimation(*request.scan, request.deadline, request.publish_intermediate);
+    }
+    else
+    {
+      result.valid = compute_pose(*request.scan, result, request.local ? &request.window : nullptr);
+      result.log_likelihood = std::numeric_limits<double>::quiet_NaN();
+      result.spread = std::numeric_limits<double>::quiet_NaN();
+      result.converged = false;
+      result.completed = true;
+      result.evaluations = 0;
+    }
+    result.pose.header.stamp = ros::Time::now();
+    geometry_msgs::PoseWithCovarianceStamped &pose = result.pose;
+    if(result.valid)
+      publish_result(request, result);
+    request.result->set_value(result);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Results cut short by a deadline are not cached, a later request may have more time.
+    if(result.completed && result.valid && !request.local)
+      result_cache_.insert(request.fingerprint, result);
+    if(request.target == EstimationRequest::TRIGGERED)
+    {
+      // Triggers coalesced during this estimation start the next one right away.
+      if(scheduler_.finished(pose.header.stamp.toSec(), thread_cpu_time() - cpu_start, latest_scan_stamp_))
+        enqueue_request_locked(EstimationRequest::TRIGGERED, anytime_deadline_ > 0.0, anytime_deadline_,
+                               publish_intermediate_);
+      publish_diagnostics(true);
+    }
+    if(state_ != STOPPING)
+      state_ = requests_.empty() ? IDLE : QUEUED;
+  }
+}
+
+void WifiPositionEstimation::publish_diagnostics(bool force)
+{
+  ros::Time now = ros::Time::now();
+  if(!force && now - last_diagnostics_ < ros::Duration(1.0))
+    return;
+  last_diagnostics_ = now;
+
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "wifi_position_estimation: trigger scheduler";
+  status.hardware_id = "none";
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = "Last trigger: " + EstimationScheduler::outcome_name(scheduler_.last_outcome());
+  if(scheduler_.last_outcome() == EstimationScheduler::OVER_BUDGET)
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+
+  for(int i = 0; i < EstimationScheduler::N_OUTCOMES; i++)
+  {
+    diagnostic_msgs::KeyValue value;
+    EstimationScheduler::Outcome outcome = EstimationScheduler::Outcome(i);
+    value.key = EstimationScheduler::outcome_name(outcome);
+    value.value = std::to_string(scheduler_.count(outcome));
+    status.values.push_back(value);
+  }
+  diagnostic_msgs::KeyValue cpu_usage;
+  cpu_usage.key = "cpu_usage";
+  cpu_usage.value = std::to_string(scheduler_.cpu_usage(now.toSec()));
+  status.values.push_back(cpu_usage);
+
+  diagnostic_msgs::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = now;
+  diagnostics.status.push_back(status);
+
+  if(result_cache_.enabled())
+  {
+    diagnostic_msgs::DiagnosticStatus cache_status;
+    cache_status.name = "wifi_position_estimation: result cache";
+    cache_status.hardware_id = "none";
+    cache_status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    cache_status.message = std::to_string(result_cache_.size()) + " cached results";
+    diagnostic_msgs::KeyValue hits;
+    hits.key = "hits";
+    hits.value = std::to_string(result_cache_.hits());
+    cache_status.values.push_back(hits);
+    diagnostic_msgs::KeyValue misses;
+    misses.key = "misses";
+    misses.value = std::to_string(result_cache_.misses());
+    cache_status.values.push_back(misses);
+    diagnostics.status.push_back(cache_status);
+  }
+  diagnostics_pub_.publish(diagnostics);
+}
+
+void WifiPositionEstimation::publish_result(const EstimationRequest &request, const EstimationResult &result)
+{
+  const geometry_msgs::PoseWithCovarianceStamped &pose = result.pose;
+  if(result.has_hypotheses)
+  {
+    wifi_localization::WifiPoseHypotheses msg = result.hypotheses;
+    msg.header.stamp = pose.header.stamp;
+    hypotheses_pub_.publish(msg);
+    if(publish_hypothesis_array_)
+    {
+      geometry_msgs::PoseArray array;
+      array.header = msg.header;
+      array.poses = msg.modes;
+      hypothesis_array_pub_.publish(array);
+    }
+  }
+
+  if(request.target == EstimationRequest::ACCURACY_DATA)
+  {
+    wifi_localization::WifiPositionEstimation msg;
+    msg.pos_x = request.amcl_x;
+    msg.pos_y = request.amcl_y;
+    msg.estimated_pos_x = pose.pose.pose.position.x;
+    msg.estimated_pos_y = pose.pose.pose.position.y;
+    msg.amcl_diff = sqrt(pow((pose.pose.pose.position.x - request.amcl_x),2)+pow((pose.pose.pose.position.y - request.amcl_y),2));
+    msg.header.stamp = pose.header.stamp;
+    wifi_pos_estimation_pub_.publish(msg);
+  }
+  else if(request.target != EstimationRequest::RESPONSE_ONLY)
+  {
+    initialpose_pub_.publish(pose);
+  }
+}
+
+bool WifiPositionEstimation::compute_pose(const Scan &scan, EstimationResult &result, const SearchWindow *window)
+{
+  ROS_INFO("Starting position estimation.");
+  result.has_hypotheses = false;
+  std::vector<std::pair<int, double>> observations = indexed_observations(scan);
+  Vector2d most_likely_pos = Vector2d::Zero();
+  double highest_log_likelihood = -std::numeric_limits<double>::infinity();
+  std::vector<std::pair<double, Eigen::Vector2d>> candidates;
+  posterior_.clear();
+  // Whether early termination abandoned a particle, whose log likelihood is unknown then
+  bool pruned = false;
+
+  if(window != nullptr && local_search(observations, *window, most_likely_pos, highest_log_likelihood))
+  {
+    ROS_INFO("Found a plausible position within %f meters of the last trusted pose.", window->radius);
+  }
+
+  else if(incremental_scoring_ && incremental_scorer_.size() > 0)
+  {
+    int updated = incremental_scorer_.update(observations);
+    for(size_t i = 0; i < incremental_particles_.size(); i++)
+      posterior_.add(incremental_particles_[i], incremental_scorer_.log_likelihoods()[i]);
+    int best = incremental_scorer_.best_particle();
+    if(best != -1)
+    {
+      most_likely_pos = incremental_particles_[best];
+      highest_log_likelihood = incremental_scorer_.log_likelihoods()[best];
+    }
+    ROS_INFO("Incremental scoring updated %i of %i access points.", updated, int(observations.size()));
+  }
+
+  else if(search_mode_ == "branch_and_bound" && !likelihood_pyramid_.empty())
+  {
+    int evaluated_tiles = likelihood_pyramid_.search(observations, most_likely_pos, highest_log_likelihood);
+    if(evaluated_tiles == -1)
+      ROS_WARN("The likelihood pyramid contains no free node.");
+    else
+      ROS_INFO("Evaluated %i tiles of the likelihood pyramid.", evaluated_tiles);
+  }
+
+  else if(refinement_rounds_ > 0)
+  {
+    most_likely_pos = importance_resampling(observations, highest_log_likelihood);
+  }
+
+  else if(precompute_ && precompute_mode_ == "grid")
+  {
+    std::vector<double> remaining_bounds = remaining_log_likelihood_bounds(observations);
+    for(int i = 0; i < n_particles_; ++i)
+    {
+      double total_log_prob = 0.0;
+      double threshold = pruning_threshold(candidates, highest_log_likelihood);
+
+      Eigen::Vector2d random_point;
+      if(!random_free_position(random_point))
+        continue;
+
+      for(size_t j = 0; j < observations.size(); j++)
+      {
+        // Abandon the particle, as soon as it can not beat the best particle anymore.
+        if(early_termination_ && total_log_prob + remaining_bounds[j] < threshold)
+        {
+          total_log_prob = -std::numeric_limits<double>::infinity();
+          pruned = true;
+          break;
+        }
+
+        double mean;
+        double variance;
+        if(precomputed_grid_.interpolate(observations[j].first, random_point(0), random_point(1), mean, variance))
+        {
+          double log_prob = Process::log_probability_precomputed(mean, variance, observations[j].second);
+          if(!std::isnan(log_prob))
+            total_log_prob += log_prob;
+        }
+      }
+      insert_candidate(candidates, total_log_prob, random_point);
+      posterior_.add(random_point, total_log_prob);
+      if(total_log_prob > highest_log_likelihood)
+      {
+        highest_log_likelihood = total_log_prob;
+        most_likely_pos = {random_point(0), random_point(1)};
+      }
+    }
+  }
+
+  else if(!likelihood_table_.empty())
+  {
+    std::vector<int> columns;
+    for(auto& observation:observations)
+      columns.push_back(LikelihoodTable::column(observation.second));
+
+    for(int point = 0; point < random_points_.size(); point++)
+    {
+      int32_t quantized = 0;
+      for(size_t j = 0; j < observations.size(); j++)
+        quantized += likelihood_table_.row(point, observations[j].first)[columns[j]];
+
+      double total_log_prob = likelihood_table_.log_likelihood(quantized);
+      insert_candidate(candidates, total_log_prob, random_points_[point]);
+      posterior_.add(random_points_[point], total_log_prob);
+      if(total_log_prob > highest_log_likelihood)
+      {
+        highest_log_likelihood = total_log_prob;
+        most_likely_pos = random_points_[point];
+      }
+    }
+  }
+
+  else if(precompute_)
+  {
+    std::vector<double> remaining_bounds = remaining_log_likelihood_bounds(observations);
+
+    // Iterate over the coordinates
+    for(int point = 0; point < random_points_.size(); point++)
+    {
+      Eigen::Vector2d current_coordinate = random_points_[point];
+      double total_log_prob = 0.0;
+      double threshold = pruning_threshold(candidates, highest_log_likelihood);
+
+      // Iterate over the current macs and the associated strengths
+      for(size_t j = 0; j < observations.size(); j++)
+      {
+        if(early_termination_ && total_log_prob + remaining_bounds[j] < threshold)
+        {
+          total_log_prob = -std::numeric_limits<double>::infinity();
+          pruned = true;
+          break;
+        }
+
+        double log_prob = precomputed_table_.log_probability(point, observations[j].first, observations[j].second);
+        if(!std::isnan(log_prob))
+          total_log_prob += log_prob;
+      }
+      insert_candidate(candidates, total_log_prob, current_coordinate);
+      posterior_.add(current_coordinate, total_log_prob);
+      if(total_log_prob > highest_log_likelihood)
+      {
+        highest_log_likelihood = total_log_prob;
+        most_likely_pos = {current_coordinate(0), current_coordinate(1)};
+      }
+    }
+  }
+
+  else
+  {
+    std::vector<double> remaining_bounds = remaining_log_likelihood_bounds(observations);
+    for(int i = 0; i < n_particles_; ++i)
+    {
+      double total_log_prob = 0.0;
+      double threshold = pruning_threshold(candidates, highest_log_likelihood);
+
+      Eigen::Vector2d random_point = random_position();
+
+      for(size_t j = 0; j < observations.size(); j++)
+      {
+        if(early_termination_ && total_log_prob + remaining_bounds[j] < threshold)
+        {
+          total_log_prob = -std::numeric_limits<double>::infinity();
+          pruned = true;
+          break;
+        }
+
+        double mean;
+        double variance;
+        processes_[observations[j].first].predict(random_point(0), random_point(1), mean, variance);
+        double log_prob = Process::log_probability_precomputed(mean, variance, observations[j].second);
+        if(!std::isnan(log_prob))
+          total_log_prob += log_prob;
+      }
+      insert_candidate(candidates, total_log_prob, random_point);
+      posterior_.add(random_point, total_log_prob);
+      if(total_log_prob > highest_log_likelihood)
+      {
+        highest_log_likelihood = total_log_prob;
+        most_likely_pos = {random_point(0), random_point(1)};
+      }
+    }
+  }
+
+  // Every search leaves the log likelihood at -inf if it did not score a single position.
+  if(std::isinf(highest_log_likelihood))
+  {
+    ROS_WARN("No position could be estimated.");
+    return false;
+  }
+
+  // The abandoned particles would be weighted with -inf, which shrinks the covariance to the running maxima.
+  if(pruned)
+  {
+    ROS_INFO("Particles were abandoned early, keeping the default covariance.");
+    posterior_.clear();
+  }
+
+  if(gradient_refinement_top_k_ > 0)
+  {
+    // Searches that only report their best position are refined from that position.
+    if(candidates.empty())
+      candidates.push_back(std::make_pair(highest_log_likelihood, most_likely_pos));
+    most_likely_pos = gradient_refinement(observations, candidates);
+  }
+
+  ROS_INFO("Estimated position: %f, %f", most_likely_pos(0), most_likely_pos(1));
+
+  result.pose = pose_from_position(most_likely_pos);
+  result.has_hypotheses = apply_posterior(result.pose, result.hypotheses);
+  return true;
+}
+
+bool WifiPositionEstimation::apply_posterior(geometry_msgs::PoseWithCovarianceStamped &pose,
+                                             wifi_localization::WifiPoseHypotheses &hypotheses)
+{
+  Eigen::Vector2d mean;
+  Eigen::Matrix2d covariance;
+  if(!posterior_.moments(mean, covariance))
+    return false;
+
+  pose.pose.covariance[0] = std::max(covariance(0, 0), min_position_variance_);
+  pose.pose.covariance[1] = covariance(0, 1);
+  pose.pose.covariance[6] = covariance(1, 0);
+  pose.pose.covariance[7] = std::max(covariance(1, 1), min_position_variance_);
+
+  if(hypotheses_ <= 0)
+    return false;
+
+  hypotheses = wifi_localization::WifiPoseHypotheses();
+  hypotheses.header.frame_id = "map";
+  hypotheses.posterior = pose.pose;
+  hypotheses.posterior.pose.position.x = mean(0);
+  hypotheses.posterior.pose.position.y = mean(1);
+  hypotheses.log_mean_likelihood = posterior_.log_mean_likelihood();
+  hypotheses.scored_positions = posterior_.size();
+
+  for(auto& mode:posterior_.modes(hypotheses_, hypothesis_separation_))
+  {
+    geometry_msgs::Pose mode_pose;
+    mode_pose.position.x = mode.first(0);
+    mode_pose.position.y = mode.first(1);
+    mode_pose.orientation.w = 1.0;
+    hypotheses.modes.push_back(mode_pose);
+    hypotheses.weights.push_back(mode.second);
+  }
+
+  ROS_INFO("Posterior has %i modes, standard deviation %f, %f.", int(hypotheses.modes.size()),
+           sqrt(covariance(0, 0)), sqrt(covariance(1, 1)));
+  return true;
+}
+
+geometry_msgs::PoseWithCovarianceStamped WifiPositionEstimation::pose_from_position(const Eigen::Vector2d &position)
+{
+  geometry_msgs::PoseWithCovarianceStamped pose;
+  pose.header.frame_id = "map";
+  pose.pose.pose.position.x = position(0);
+  pose.pose.pose.position.y = position(1);
+  pose.pose.pose.position.z = 0.0;
+  pose.pose.pose.orientation.w = 1.0;
+  pose.pose.covariance = {0.0};
+  pose.pose.covariance[0] = 2.0;
+  pose.pose.covariance[7] = 2.0;
+  pose.pose.covariance[14] = 0.0;
+  pose.pose.covariance[21] = 0.0;
+  pose.pose.covariance[28] = 0.0;
+  pose.pose.covariance[35] = M_PI;
+
+  return pose;
+}
+
+bool WifiPositionEstimation::local_search(const std::vector<std::pair<int, double>> &observations,
+                                          const SearchWindow &window, Eigen::Vector2d &position,
+                                          double &log_likelihood)
+{
+  Eigen::Vector2d center(window.x, window.y);
+  log_likelihood = -std::numeric_limits<double>::infinity();
+  int evaluated = 0;
+
+  auto evaluate = [&](const Eigen::Vector2d &point)
+  {
+    double value = this->log_likelihood(observations, point);
+    posterior_.add(point, value);
+    evaluated++;
+    if(value > log_likelihood)
+    {
+      log_likelihood = value;
+      position = point;
+    }
+  };
+
+  if(precompute_ && precompute_mode_ == "grid")
+  {
+    // Every free node of the window is evaluated, so the search is exhaustive at the resolution of the grid.
+    Eigen::Vector2d origin = precomputed_grid_.node_position(0, 0);
+    double resolution = precomputed_grid_.resolution();
+    int min_col = std::max(int(floor((window.x - window.radius - origin(0)) / resolution)), 0);
+    int max_col = std::min(int(ceil((window.x + window.radius - origin(0)) / resolution)), precomputed_grid_.cols() - 1);
+    int min_row = std::max(int(floor((window.y - window.radius - origin(1)) / resolution)), 0);
+    int max_row = std::min(int(ceil((window.y + window.radius - origin(1)) / resolution)), precomputed_grid_.rows() - 1);
+    for(int row = min_row; row <= max_row; row++)
+    {
+      for(int col = min_col; col <= max_col; col++)
+      {
+        Eigen::Vector2d node = precomputed_grid_.node_position(col, row);
+        if(precomputed_grid_.is_free_node(col, row) && (node - center).norm() <= window.radius)
+          evaluate(node);
+      }
+    }
+  }
+  else
+  {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for(int i = 0; i < local_search_particles_; i++)
+    {
+      // Uniform within the disc.
+      double radius = window.radius * sqrt(uniform(random_engine_));
+      double angle = 2.0 * M_PI * uniform(random_engine_);
+      evaluate(center + radius * Eigen::Vector2d(cos(angle), sin(angle)));
+    }
+  }
+
+  if(std::isinf(log_likelihood) || observations.empty())
+  {
+    posterior_.clear();
+    return false;
+  }
+
+  double statistic = log_likelihood / observations.size();
+  double threshold = local_search_min_log_likelihood_;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(monitor_.calibrated())
+      threshold = monitor_.mean() - monitor_.threshold() * sqrt(monitor_.variance());
+  }
+  ROS_INFO("Local search evaluated %i positions, best log likelihood per observation %f, threshold %f.", evaluated,
+           statistic, threshold);
+  // The global search that follows a failed local search must not mix its positions with the window.
+  if(statistic < threshold)
+    posterior_.clear();
+  return statistic >= threshold;
+}
+
+std::vector<std::pair<int, double>> WifiPositionEstimation::indexed_observations(const Scan &scan)
+{
+  const std::vector<std::pair<int, double>> &observations = scan;
+
+  if(max_aps_ <= 0 && ap_information_budget_ <= 0.0)
+    return observations;
+
+  // Weak signals are often far away and noisy, so their information is scaled down.
+  std::vector<std::pair<double, std::pair<int, double>>> ranked;
+  for(auto& observation:observations)
+  {
+    double strength_weight = std::min(std::max((observation.second + 100.0) / 70.0, 0.05), 1.0);
+    ranked.push_back(std::make_pair(ap_information_[observation.first] * strength_weight, observation));
+  }
+  std::stable_sort(ranked.begin(), ranked.end(),
+                   [](const std::pair<double, std::pair<int, double>> &a,
+                      const std::pair<double, std::pair<int, double>> &b) { return a.first > b.first; });
+
+  std::vector<std::pair<int, double>> selected;
+  double information = 0.0;
+  for(auto& it:ranked)
+  {
+    if(max_aps_ > 0 && selected.size() >= max_aps_)
+      break;
+    if(ap_information_budget_ > 0.0 && information >= ap_information_budget_)
+      break;
+    selected.push_back(it.second);
+    information += it.first;
+  }
+  ROS_DEBUG("Selected %i of %i observed access points.", int(selected.size()), int(observations.size()));
+  return selected;
+}
+
+double WifiPositionEstimation::log_likelihood(const std::vector<std::pair<int, double>> &observations,
+                                              const Eigen::Vector2d &position)
+{
+  bool use_grid = precompute_ && precompute_mode_ == "grid";
+  double total_log_prob = 0.0;
+  for(auto& it:observations)
+  {
+    double mean;
+    double variance;
+    if(use_grid)
+    {
+      if(!precomputed_grid_.interpolate(it.first, position(0), position(1), mean, variance))
+        return -std::numeric_limits<double>::infinity();
+    }
+    else
+    {
+      processes_[it.first].predict(position(0), position(1), mean, variance);
+    }
+
+    double log_prob = Process::log_probability_precomputed(mean, variance, it.second);
+    if(!std::isnan(log_prob))
+      total_log_prob += log_prob;
+  }
+  return total_log_prob;
+}
+
+double WifiPositionEstimation::point_log_likelihood(const std::vector<std::pair<int, double>> &observations, int point)
+{
+  if(!likelihood_table_.empty())
+  {
+    int32_t quantized = 0;
+    for(auto& it:observations)
+      quantized += likelihood_table_.row(point, it.first)[LikelihoodTable::column(it.second)];
+    return likelihood_table_.log_likelihood(quantized);
+  }
+
+  double total_log_prob = 0.0;
+  for(auto& it:observations)
+  {
+    double log_prob = precomputed_table_.log_probability(point, it.first, it.second);
+    if(!std::isnan(log_prob))
+      total_log_prob += log_prob;
+  }
+  return total_log_prob;
+}
+
+std::vector<Eigen::Vector2d> WifiPositionEstimation::resample(const std::vector<Eigen::Vector2d> &particles,
+                                                              const std::vector<double> &log_weights, int n,
+                                                              double spread)
+{
+  bool use_grid = precompute_ && precompute_mode_ == "grid";
+  if(particles.empty() || n <= 0)
+    return std::vector<Eigen::Vector2d>();
+
+  // Systematic resampling proportional to the weights.
+  double max_log_weight = *std::max_element(log_weights.begin(), log_weights.end());
+  std::vector<double> cumulative(particles.size());
+  double sum = 0.0;
+  for(size_t i = 0; i < particles.size(); i++)
+  {
+    sum += std::isinf(log_weights[i]) ? 0.0 : exp(log_weights[i] - max_log_weight);
+    cumulative[i] = sum;
+  }
+
+  std::vector<Eigen::Vector2d> resampled(n);
+  std::normal_distribution<double> noise(0.0, spread);
+  double step = sum / n;
+  double u = std::uniform_real_distribution<double>(0.0, step)(random_engine_);
+  size_t parent = 0;
+  for(int i = 0; i < n; i++, u += step)
+  {
+    while(parent < particles.size() - 1 && cumulative[parent] < u)
+      parent++;
+
+    resampled[i] = particles[parent];
+    // Retry a few times if the particle was moved into an obstacle, otherwise keep the parent.
+    for(int tries = 0; tries < 10; tries++)
+    {
+      Eigen::Vector2d candidate = particles[parent] + Eigen::Vector2d(noise(random_engine_), noise(random_engine_));
+      if(!use_grid || precomputed_grid_.is_free(candidate(0), candidate(1)))
+      {
+        resampled[i] = candidate;
+        break;
+      }
+    }
+  }
+  return resampled;
+}
+
+double WifiPositionEstimation::weighted_spread(const std::vector<Eigen::Vector2d> &particles,
+                                               const std::vector<double> &log_weights)
+{
+  if(log_weights.empty())
+    return std::numeric_limits<double>::infinity();
+  double max_log_weight = *std::max_element(log_weights.begin(), log_weights.end());
+  if(std::isinf(max_log_weight))
+    return std::numeric_limits<double>::infinity();
+
+  std::vector<double> weights(particles.size());
+  double sum = 0.0;
+  Eigen::Vector2d mean = Eigen::Vector2d::Zero();
+  for(size_t i = 0; i < particles.size(); i++)
+  {
+    weights[i] = std::isinf(log_weights[i]) ? 0.0 : exp(log_weights[i] - max_log_weight);
+    sum += weights[i];
+    mean += weights[i] * particles[i];
+  }
+  mean /= sum;
+
+  double squared_spread = 0.0;
+  for(size_t i = 0; i < particles.size(); i++)
+    squared_spread += weights[i] * (particles[i] - mean).squaredNorm();
+  return sqrt(squared_spread / sum);
+}
+
+EstimationResult WifiPositionEstimation::anytime_estimation(const Scan &scan,
+                                                            std::chrono::steady_clock::time_point deadline,
+                                                            bool publish_intermediate)
+{
+  ROS_INFO("Starting anytime position estimation.");
+  std::vector<std::pair<int, double>> observations = indexed_observations(scan);
+  bool use_grid = precompute_ && precompute_mode_ == "grid";
+  int batch_size = std::max(anytime_batch_size_, 1);
+
+  EstimationResult result;
+  result.log_likelihood = -std::numeric_limits<double>::infinity();
+  result.evaluations = 0;
+  result.completed = true;
+  Eigen::Vector2d best_position = Eigen::Vector2d::Zero();
+  double published_log_likelihood = -std::numeric_limits<double>::infinity();
+
+  // Scores the particles from the given index on in batches, evaluate computes the log likelihood of the particle of
+  // an index. Returns false if the deadline passed before all of them were scored, the unscored particles are removed
+  // then.
+  auto score = [&](std::vector<Eigen::Vector2d> &particles, std::vector<double> &log_weights, size_t begin,
+                   const std::function<double(size_t)> &evaluate)
+  {
+    log_weights.resize(particles.size());
+    for(size_t i = begin; i < particles.size(); i++)
+    {
+      log_weights[i] = evaluate(i);
+      result.evaluations++;
+      if(log_weights[i] > result.log_likelihood)
+      {
+        result.log_likelihood = log_weights[i];
+        best_position = particles[i];
+      }
+
+      if((i + 1 - begin) % batch_size == 0 || i + 1 == particles.size())
+      {
+        if(publish_intermediate && result.log_likelihood > published_log_likelihood)
+        {
+          published_log_likelihood = result.log_likelihood;
+          geometry_msgs::PoseWithCovarianceStamped pose = pose_from_position(best_position);
+          pose.header.stamp = ros::Time::now();
+          intermediate_pub_.publish(pose);
+        }
+        if(std::chrono::steady_clock::now() >= deadline && i + 1 < particles.size())
+        {
+          particles.resize(i + 1);
+          log_weights.resize(i + 1);
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  std::vector<Eigen::Vector2d> particles;
+  std::vector<double> log_weights;
+  auto evaluate_particle = [&](size_t i) { return log_likelihood(observations, particles[i]); };
+
+  // Coarse stage: uniform particles, scored in random order, so that stopping early still covers the whole map. The
+  // precomputed points are uniform already and are scored from their table, like compute_pose does.
+  if(precompute_ && !use_grid)
+  {
+    std::vector<int> order(random_points_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random_engine_);
+    for(int point:order)
+      particles.push_back(random_points_[point]);
+    result.completed = score(particles, log_weights, 0,
+                             [&](size_t i) { return point_log_likelihood(observations, order[i]); });
+  }
+  else
+  {
+    for(int i = 0; i < n_particles_; i++)
+    {
+      Eigen::Vector2d particle;
+      if(!use_grid)
+        particles.push_back(random_position());
+      else if(random_free_position(particle))
+        particles.push_back(particle);
+    }
+    result.completed = score(particles, log_weights, 0, evaluate_particle);
+  }
+
+  // The coarse particles are importance samples of the posterior, the resampled ones are not.
+  posterior_.clear();
+  for(size_t i = 0; i < particles.size(); i++)
+    posterior_.add(particles[i], log_weights[i]);
+
+  // Fine stage: resample around the particles with the highest weights with a shrinking spread.
+  double spread = refinement_spread_;
+  result.spread = particles.empty() ? std::numeric_limits<double>::infinity() : weighted_spread(particles, log_weights);
+  for(int round = 0; round < refinement_rounds_ && result.completed && !particles.empty() &&
+                     result.spread >= refinement_min_spread_; round++)
+  {
+    particles = resample(particles, log_weights, refinement_particles_, spread);
+    spread *= refinement_shrink_;
+    result.completed = score(particles, log_weights, 0, evaluate_particle);
+    result.spread = weighted_spread(particles, log_weights);
+  }
+  result.converged = result.spread < refinement_min_spread_;
+
+  ROS_INFO("Anytime estimation evaluated %i particles, spread %f, %s.", result.evaluations, result.spread,
+           result.completed ? "completed" : "stopped at the deadline");
+  result.valid = !std::isinf(result.log_likelihood);
+  result.pose = pose_from_position(best_position);
+  result.has_hypotheses = result.valid && apply_posterior(result.pose, result.hypotheses);
+  return result;
+}
+
+Eigen::Vector2d WifiPositionEstimation::importance_resampling(const std::vector<std::pair<int, double>> &observations,
+                                                              double &best_log_likelihood)
+{
+  bool use_grid = precompute_ && precompute_mode_ == "grid";
+  std::vector<Eigen::Vector2d> particles(refinement_particles_);
+  std::vector<double> log_weights(refinement_particles_);
+
+  Eigen::Vector2d best_position = Eigen::Vector2d::Zero();
+  best_log_likelihood = -std::numeric_limits<double>::infinity();
+  int evaluations = 0;
+  double spread = refinement_spread_;
+
+  for(int round = 0; round <= refinement_rounds_; round++)
+  {
+    if(round > 0)
+    {
+      particles = resample(particles, log_weights, particles.size(), spread);
+      spread *= refinement_shrink_;
+    }
+    else
+    {
+      particles.clear();
+      for(int i = 0; i < refinement_particles_; i++)
+      {
+        Eigen::Vector2d particle = random_position();
+        if(!use_grid || random_free_position(particle))
+          particles.push_back(particle);
+      }
+      log_weights.resize(particles.size());
+      if(particles.empty())
+      {
+        ROS_WARN("No free position found for the particles.");
+        break;
+      }
+    }
+
+    for(size_t i = 0; i < particles.size(); i++)
+    {
+      log_weights[i] = log_likelihood(observations, particles[i]);
+      evaluations++;
+      // Only the uniform particles of the first round are importance samples of the posterior.
+      if(round == 0)
+        posterior_.add(particles[i], log_weights[i]);
+      if(log_weights[i] > best_log_likelihood)
+      {
+        best_log_likelihood = log_weights[i];
+        best_position = particles[i];
+      }
+    }
+
+    // Stop early once the particles have converged.
+    if(round > 0)
+    {
+      Eigen::Vector2d mean = Eigen::Vector2d::Zero();
+      for(auto& particle:particles)
+        mean += particle;
+      mean /= particles.size();
+      double squared_spread = 0.0;
+      for(auto& particle:particles)
+        squared_spread += (particle - mean).squaredNorm();
+      if(sqrt(squared_spread / particles.size()) < refinement_min_spread_)
+      {
+        ROS_INFO("Particles converged after %i refinement rounds.", round);
+        break;
+      }
+    }
+  }
+
+  ROS_INFO("Importance resampling evaluated %i particles.", evaluations);
+  return best_position;
+}
+
+double WifiPositionEstimation::log_likelihood_gradient(const std::vector<std::pair<int, double>> &observations,
+                                                       const Eigen::Vector2d &position, Eigen::Vector2d &gradient)
+{
+  double total_log_prob = 0.0;
+  gradient = Eigen::Vector2d::Zero();
+  for(auto& it:observations)
+  {
+    double mean;
+    double variance;
+    Eigen::Vector2d mean_gradient;
+    Eigen::Vector2d variance_gradient;
+    processes_[it.first].predict_with_gradient(position(0), position(1), mean, variance, mean_gradient,
+                                                variance_gradient);
+
+    double log_prob = Process::log_probability_precomputed(mean, variance, it.second);
+    if(std::isnan(log_prob))
+      continue;
+    total_log_prob += log_prob;
+
+    // probability_precomputed uses the absolute value of the variance.
+    double residual = Process::normalize_observation(it.second) - mean;
+    double abs_variance = fabs(variance);
+    variance_gradient *= sgn(variance);
+    gradient += residual / abs_variance * mean_gradient +
+                0.5 * (residual * residual / (abs_variance * abs_variance) - 1.0 / abs_variance) * variance_gradient;
+  }
+  return total_log_prob;
+}
+
+void WifiPositionEstimation::insert_candidate(std::vector<std::pair<double, Eigen::Vector2d>> &candidates, double score,
+                                              const Eigen::Vector2d &position)
+{
+  if(gradient_refinement_top_k_ <= 0 || score == -std::numeric_limits<double>::infinity())
+    return;
+  if(candidates.size() == gradient_refinement_top_k_ && score <= candidates.back().first)
+    return;
+
+  auto it = candidates.begin();
+  while(it != candidates.end() && it->first >= score)
+    ++it;
+  candidates.insert(it, std::make_pair(score, position));
+  if(candidates.size() > gradient_refinement_top_k_)
+    candidates.pop_back();
+}
+
+Eigen::Vector2d WifiPositionEstimation::gradient_refinement(const std::vector<std::pair<int, double>> &observations,
+                                                            const std::vector<std::pair<double, Eigen::Vector2d>> &candidates)
+{
+  bool use_grid = precompute_ && precompute_mode_ == "grid";
+  Eigen::Vector2d best_position = candidates.front().second;
+  double best_log_likelihood = -std::numeric_limits<double>::infinity();
+
+  for(auto& candidate:candidates)
+  {
+    // BFGS on the negative log likelihood. The first step is scaled to be one meter long.
+    Eigen::Vector2d position = candidate.second;
+    Eigen::Vector2d gradient;
+    double value = -log_likelihood_gradient(observations, position, gradient);
+    gradient = -gradient;
+    Eigen::Matrix2d inverse_hessian = Eigen::Matrix2d::Identity() / std::max(gradient.norm(), 1e-9);
+
+    for(int step = 0; step < gradient_refinement_steps_ && gradient.norm() > 1e-9; step++)
+    {
+      Eigen::Vector2d direction = -inverse_hessian * gradient;
+      if(direction.dot(gradient) >= 0.0)
+      {
+        inverse_hessian = Eigen::Matrix2d::Identity() / std::max(gradient.norm(), 1e-9);
+        direction = -inverse_hessian * gradient;
+      }
+
+      // Backtracking line search with the Armijo condition.
+      double step_length = 1.0;
+      Eigen::Vector2d new_position;
+      Eigen::Vector2d new_gradient;
+      double new_value = value;
+      bool accepted = false;
+      for(int i = 0; i < 20; i++, step_length *= 0.5)
+      {
+        new_position = position + step_length * direction;
+        if(use_grid && !precomputed_grid_.is_free(new_position(0), new_position(1)))
+          continue;
+        new_value = -log_likelihood_gradient(observations, new_position, new_gradient);
+        if(new_value <= value + 1e-4 * step_length * gradient.dot(direction))
+        {
+          accepted = true;
+          break;
+        }
+      }
+      if(!accepted)
+        break;
+      new_gradient = -new_gradient;
+
+      Eigen::Vector2d s = new_position - position;
+      Eigen::Vector2d y = new_gradient - gradient;
+      double sy = s.dot(y);
+      if(sy > 1e-12)
+      {
+        Eigen::Matrix2d I = Eigen::Matrix2d::Identity();
+        inverse_hessian = (I - s * y.transpose() / sy) * inverse_hessian * (I - y * s.transpose() / sy) +
+                          s * s.transpose() / sy;
+      }
+
+      position = new_position;
+      gradient = new_gradient;
+      value = new_value;
+    }
+
+    if(-value > best_log_likelihood)
+    {
+      best_log_likelihood = -value;
+      best_position = position;
+    }
+  }
+  return best_position;
+}
+
+void WifiPositionEstimation::wifi_callback(const wifi_localization::WifiState::ConstPtr& msg)
+{
+  if(!msg->macs.empty())
+  {
+    add_scan(std::make_shared<Scan>(scan_from_message(*msg)), msg->header.stamp);
+  }
+}
+
+template<class Macs, class Strengths>
+Scan WifiPositionEstimation::resolve_scan(const Macs &macs, const Strengths &strengths)
+{
+  // The macs are resolved to the indices of their processes once here, so that the estimation only works on indices.
+  Scan scan;
+  for (size_t i = 0; i < macs.size(); i++)
+  {
+    int index = mac_dictionary_.index(macs.at(i));
+    if(index != -1)
+      scan.push_back(std::make_pair(index, double(strengths.at(i))));
+  }
+  std::sort(scan.begin(), scan.end(),
+            [](const std::pair<int, double> &a, const std::pair<int, double> &b) { return a.second > b.second; });
+  return scan;
+}
+
+Scan WifiPositionEstimation::scan_from_message(const wifi_localization::WifiState &msg)
+{
+  return resolve_scan(msg.macs, msg.strengths);
+}
+
+Scan WifiPositionEstimation::scan_from_message(const wifi_localization::WifiState2 &msg)
+{
+  // The packed bssids can be looked up directly, without parsing any strings.
+  return resolve_scan(msg.bssids, msg.strengths);
+}
+
+void WifiPositionEstimation::wifi_compact_callback(const wifi_localization::WifiState2::ConstPtr& msg)
+{
+  if(!msg->bssids.empty())
+  {
+    add_scan(std::make_shared<Scan>(scan_from_message(*msg)), msg->header.stamp);
+  }
+}
+
+void WifiPositionEstimation::add_scan(const std::shared_ptr<const Scan> &scan, const ros::Time &stamp)
+{
+  {
+    // Requests keep the snapshot they were created with, so the latest scan is replaced instead of modified.
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest_scan_ = scan;
+    latest_scan_stamp_ = stamp.toSec();
+  }
+
+  if(streaming_filter_)
+    filter_scan(*scan, stamp);
+  if(tracking_)
+  {
+    std::lock_guard<std::mutex> lock(tracker_mutex_);
+    tracker_scan_ = scan;
+    tracker_scan_stamp_ = stamp;
+    tracker_scan_added_.notify_one();
+  }
+  if(kidnapping_monitor_)
+    monitor_scan(*scan);
+}
+
+void WifiPositionEstimation::max_weight_callback(const wifi_localization::MaxWeight::ConstPtr& msg)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_max_weight_ = msg->max_weight;
+    received_max_weight_ = true;
+  }
+  if(msg->max_weight > quality_threshold_)
+    trigger_estimation();
+}
+
+void WifiPositionEstimation::trigger_estimation()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    EstimationScheduler::Outcome outcome = scheduler_.trigger(ros::Time::now().toSec(), latest_scan_stamp_);
+    publish_diagnostics(outcome == EstimationScheduler::STARTED);
+    if(outcome != EstimationScheduler::STARTED)
+      return;
+  }
+  enqueue_request(EstimationRequest::TRIGGERED);
+}
+
+bool WifiPositionEstimation::amcl_trusted() const
+{
+  return received_max_weight_ && last_max_weight_ <= quality_threshold_;
+}
+
+void WifiPositionEstimation::monitor_scan(const Scan &scan)
+{
+  Eigen::Vector2d amcl_position;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!has_amcl_pose_)
+      return;
+    amcl_position = Eigen::Vector2d(x_pos_, y_pos_);
+  }
+
+  std::vector<std::pair<int, double>> observations = indexed_observations(scan);
+  if(observations.empty())
+    return;
+
+  // The best point of the ring tolerates small errors of amcl. Dividing by the number of observations makes scans
+  // with different numbers of access points comparable.
+  double best = log_likelihood(observations, amcl_position);
+  for(int i = 0; i < monitor_ring_points_; i++)
+  {
+    double angle = 2.0 * M_PI * i / monitor_ring_points_;
+    Eigen::Vector2d point = amcl_position + monitor_ring_radius_ * Eigen::Vector2d(cos(angle), sin(angle));
+    best = std::max(best, log_likelihood(observations, point));
+  }
+  if(std::isinf(best))
+    return;
+  double statistic = best / observations.size();
+
+  bool kidnapped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    kidnapped = monitor_.check(statistic);
+    if(monitor_.last_check_passed() && amcl_trusted())
+      monitor_.calibrate(statistic);
+  }
+
+  if(kidnapped)
+  {
+    ROS_WARN("Scans do not fit the amcl pose (%f per access point). Starting global position estimation.", statistic);
+    trigger_estimation();
+  }
+}
+
+void WifiPositionEstimation::amcl_callback(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr& msg)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  x_pos_ = msg->pose.pose.position.x;
+  y_pos_ = msg->pose.pose.position.y;
+  has_amcl_pose_ = true;
+
+  if(amcl_trusted())
+  {
+    has_trusted_pose_ = true;
+    trusted_position_ = Eigen::Vector2d(x_pos_, y_pos_);
+    trusted_time_ = ros::Time::now();
+    trusted_odom_distance_ = 0.0;
+  }
+}
+
+void WifiPositionEstimation::odom_callback(const nav_msgs::Odometry::ConstPtr& msg)
+{
+  Eigen::Vector2d position(msg->pose.pose.position.x, msg->pose.pose.position.y);
+  double step = 0.0;
+  {
+    std::lock_guard<std::mutex> lock(filter_mutex_);
+    if(has_odom_)
+      step = (position - last_odom_).norm();
+    odom_distance_ += step;
+    last_odom_ = position;
+    has_odom_ = true;
+  }
+
+  if(local_search_)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trusted_odom_distance_ += step;
+  }
+
+  if(tracking_)
+  {
+    const geometry_msgs::Quaternion &q = msg->pose.pose.orientation;
+    double yaw = atan2(2.0 * (q.w * q.z + q.x * q.y), 1.0 - 2.0 * (q.y * q.y + q.z * q.z));
+    std::lock_guard<std::mutex> lock(tracker_mutex_);
+    latest_odom_pose_ = Eigen::Vector3d(position(0), position(1), yaw);
+    if(!has_tracker_odom_)
+      tracker_odom_pose_ = latest_odom_pose_;
+    has_tracker_odom_ = true;
+  }
+}
+
+void WifiPositionEstimation::tracker_loop()
+{
+  bool use_grid = precompute_ && precompute_mode_ == "grid";
+  ParticleTracker::PositionSampler sampler = [this, use_grid](Eigen::Vector2d &position)
+  {
+    position = random_position();
+    return !use_grid || random_free_position(position);
+  };
+  tracker_.reset(sampler);
+
+  while(true)
+  {
+    std::shared_ptr<const Scan> scan;
+    ros::Time stamp;
+    Eigen::Vector3d motion = Eigen::Vector3d::Zero();
+    {
+      std::unique_lock<std::mutex> lock(tracker_mutex_);
+      tracker_scan_added_.wait(lock, [this] { return tracker_stop_ || tracker_scan_ != nullptr; });
+      if(tracker_stop_)
+        return;
+      scan = tracker_scan_;
+      stamp = tracker_scan_stamp_;
+      tracker_scan_ = nullptr;
+
+      if(has_tracker_odom_)
+      {
+        // Express the odometry since the previous scan in the frame of the robot at the previous scan.
+        double theta = tracker_odom_pose_(2);
+        Eigen::Vector2d delta = latest_odom_pose_.head<2>() - tracker_odom_pose_.head<2>();
+        motion = Eigen::Vector3d(cos(theta) * delta(0) + sin(theta) * delta(1),
+                                 -sin(theta) * delta(0) + cos(theta) * delta(1),
+                                 remainder(latest_odom_pose_(2) - theta, 2.0 * M_PI));
+        tracker_odom_pose_ = latest_odom_pose_;
+      }
+    }
+
+    std::vector<std::pair<int, double>> observations = indexed_observations(*scan);
+    tracker_.predict(motion(0), motion(1), motion(2));
+    tracker_.update([this, &observations](const Eigen::Vector2d &position)
+                    {
+                      return log_likelihood(observations, position);
+                    }, sampler);
+    if(tracker_.size() == 0)
+    {
+      ROS_WARN("No free position found for the particles of the tracker.");
+      continue;
+    }
+
+    Eigen::Vector3d mean;
+    Eigen::Matrix3d covariance;
+    tracker_.estimate(mean, covariance);
+    ROS_DEBUG("Tracker uses %i particles with a spread of %f meters.", tracker_.size(), tracker_.spread());
+
+    geometry_msgs::PoseWithCovarianceStamped pose = pose_from_position(mean.head<2>());
+    pose.header.stamp = stamp;
+    pose.pose.pose.orientation.z = sin(0.5 * mean(2));
+    pose.pose.pose.orientation.w = cos(0.5 * mean(2));
+    pose.pose.covariance[0] = covariance(0, 0);
+    pose.pose.covariance[1] = covariance(0, 1);
+    pose.pose.covariance[5] = covariance(0, 2);
+    pose.pose.covariance[6] = covariance(1, 0);
+    pose.pose.covariance[7] = covariance(1, 1);
+    pose.pose.covariance[11] = covariance(1, 2);
+    pose.pose.covariance[30] = covariance(2, 0);
+    pose.pose.covariance[31] = covariance(2, 1);
+    pose.pose.covariance[35] = covariance(2, 2);
+    tracker_pub_.publish(pose);
+  }
+}
+
+void WifiPositionEstimation::filter_scan(const Scan &scan, const ros::Time &stamp)
+{
+  std::vector<std::pair<int, double>> observations = indexed_observations(scan);
+  Eigen::Vector2d mode, mean;
+  Eigen::Matrix2d covariance;
+  {
+    std::lock_guard<std::mutex> lock(filter_mutex_);
+    // The heading of the robot in the map is unknown, so the odometry only widens the blur instead of shifting it.
+    double sigma = filter_scan_noise_ + filter_motion_noise_ * odom_distance_;
+    odom_distance_ = 0.0;
+    grid_filter_.predict(sigma);
+    grid_filter_.update(observations);
+    if(!grid_filter_.estimate(mode, mean, covariance))
+      return;
+  }
+
+  geometry_msgs::PoseWithCovarianceStamped pose = pose_from_position(mode);
+  pose.header.stamp = stamp;
+  pose.pose.covariance[0] = covariance(0, 0);
+  pose.pose.covariance[1] = covariance(0, 1);
+  pose.pose.covariance[6] = covariance(1, 0);
+  pose.pose.covariance[7] = covariance(1, 1);
+  filter_pub_.publish(pose);
+}
+
+bool WifiPositionEstimation::publish_gp_map_service(wifi_localization::PlotGP::Request &req,
+                                                    wifi_localization::PlotGP::Response &res)
+{
+  int index = mac_dictionary_.index(req.mac);
+  if(index == -1)
   {
     ROS_ERROR("The mac provided for the service for publishing the grid map of the gaussian process was not found.");
     return false;
   }
 
   ROS_INFO("Found mac. Begin to plot map.");
-  it->second.create_gp_mean_map(gp_grid_map_);
-  it->second.create_gp_variance_map(gp_grid_map_);
+  std::lock_guard<std::mutex> lock(gp_grid_map_mutex_);
+  processes_[index].create_gp_mean_map(gp_grid_map_);
+  processes_[index].create_gp_variance_map(gp_grid_map_);
 
   ros::Time time = ros::Time::now();
 
@@ -22,18 +22,22 @@ int main(int argc, char **argv)
   n.param("/wifi_position_estimation/publish_data_periodically", publish_data_periodically, publish_data_periodically);
   n.param("/wifi_position_estimation/periodic_publishing_rate", periodic_publishing_rate, periodic_publishing_rate);
 
+  // The estimations run on their own thread. The services that wait for them and the batch service are served by
+  // spinners of their own, so this one only keeps the subscribers running.
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
   if(publish_data_periodically)
   {
     ros::Rate r(periodic_publishing_rate);
     while (ros::ok())
     {
       wl.publish_accuracy_data(req, res);
-      ros::spinOnce();
       r.sleep();
     }
   }
   else
-    ros::spin();
+    ros::waitForShutdown();
   
 
   return 0;
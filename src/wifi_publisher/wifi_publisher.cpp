@@ -1,12 +1,22 @@
 #include <wifi_publisher/wifi_publisher.h>
 #include "wifi_localization/WifiState.h"
 
-WifiPublisher::WifiPublisher(ros::NodeHandle &nh, std::string wifi_interface, std::vector<unsigned int> channel_list, int ms_till_discard, int chans_per_scan):wifi_interface_(wifi_interface), ms_till_discard_(ms_till_discard), chans_per_scan_(chans_per_scan), current_frequency_(0), sequential_failures_(0)
+WifiPublisher::WifiPublisher(ros::NodeHandle &nh, std::string wifi_interface, std::vector<unsigned int> channel_list, int ms_till_discard, int chans_per_scan, std::string message_format):wifi_interface_(wifi_interface), ms_till_discard_(ms_till_discard), chans_per_scan_(chans_per_scan), current_frequency_(0), sequential_failures_(0)
 {
   channel_ = new struct netlink_channel;
 
   wifi_scan_init(wifi_interface.c_str(), channel_);
-  wifi_pub_ = nh.advertise<wifi_localization::WifiState>("wifi_data", 1);
+
+  // "legacy" publishes WifiState, "compact" publishes WifiState2, "both" publishes both of them.
+  publish_legacy_ = message_format != "compact";
+  publish_compact_ = message_format == "compact" || message_format == "both";
+  if(publish_legacy_)
+    wifi_pub_ = nh.advertise<wifi_localization::WifiState>("wifi_data", 1);
+  if(publish_compact_)
+  {
+    wifi_compact_pub_ = nh.advertise<wifi_localization::WifiState2>("wifi_data_compact", 1);
+    ssid_dictionary_pub_ = nh.advertise<wifi_localization::WifiSsidDictionary>("wifi_ssid_dictionary", 1, true);
+  }
   scan_data_ = new struct bss_infos;
   scan_data_->scan_data_length = 200;
   scan_data_->sequence = 0;
@@ -66,8 +76,11 @@ bool WifiPublisher::scan()
   }
 
   wifi_localization::WifiState wifi_data;
+  wifi_localization::WifiState2 wifi_compact_data;
 
   wifi_data.header.stamp = ros::Time::now();
+  wifi_compact_data.header.stamp = wifi_data.header.stamp;
+  uint32_t ssid_dictionary_version = ssid_dictionary_.version;
 
   WifiDataPoint wifi_data_point;
   for(int i=0;i<scan_data_->sequence;i++)
@@ -75,35 +88,73 @@ bool WifiPublisher::scan()
     if((scan_data_->data[i].seen_ms_ago<ms_till_discard_) || (ms_till_discard_ == -1))
     {
       int signal_strength = int(scan_data_->data[i].signal_mbm)/100;
-      std::string mac = std::string(scan_data_->data[i].bssid);
-
-      wifi_data.ssids.push_back(std::string(scan_data_->data[i].ssid));
-      wifi_data.macs.push_back(mac);
-      wifi_data.channels.push_back(freq_to_channel(scan_data_->data[i].frequency));
-      wifi_data.strengths.push_back(signal_strength);
-      wifi_data.ms.push_back(scan_data_->data[i].seen_ms_ago);
-      wifi_data.changed_signal_strength.push_back(true);
+      uint64_t packed_mac = scan_data_->data[i].bssid_packed;
+      bool changed_signal_strength = true;
 
-      auto it = previous_signal_strength_.find(mac);
+      // Access points seen for the first time count as changed.
+      auto it = previous_signal_strength_.find(packed_mac);
 
       if(it != previous_signal_strength_.end())
-        if(it->second != signal_strength)
-          wifi_data.changed_signal_strength.back() = false;
+        if(it->second == signal_strength)
+          changed_signal_strength = false;
 
-      previous_signal_strength_[mac] = signal_strength;
+      previous_signal_strength_[packed_mac] = signal_strength;
 
+      if(publish_legacy_)
+      {
+        wifi_data.ssids.push_back(std::string(scan_data_->data[i].ssid));
+        wifi_data.macs.push_back(std::string(scan_data_->data[i].bssid));
+        wifi_data.channels.push_back(freq_to_channel(scan_data_->data[i].frequency));
+        wifi_data.strengths.push_back(signal_strength);
+        wifi_data.ms.push_back(scan_data_->data[i].seen_ms_ago);
+        wifi_data.changed_signal_strength.push_back(changed_signal_strength);
+      }
+      if(publish_compact_)
+      {
+        wifi_compact_data.bssids.push_back(packed_mac);
+        wifi_compact_data.strengths.push_back(std::max(std::min(signal_strength, 127), -128));
+        wifi_compact_data.channels.push_back(freq_to_channel(scan_data_->data[i].frequency));
+        wifi_compact_data.ms.push_back(std::min(int(scan_data_->data[i].seen_ms_ago), 65535));
+        wifi_compact_data.changed_signal_strength.push_back(changed_signal_strength);
+        wifi_compact_data.ssid_indices.push_back(ssid_index(scan_data_->data[i].ssid));
+      }
     }
   }
   scan_data_->sequence = 0;
   scan_data_->data;
 
+  if(publish_compact_ && ssid_dictionary_.version != ssid_dictionary_version)
+  {
+    ssid_dictionary_.header.stamp = wifi_data.header.stamp;
+    ssid_dictionary_pub_.publish(ssid_dictionary_);
+  }
+
   if(!wifi_data.macs.empty())
   {
     wifi_pub_.publish(wifi_data);
   }
+  if(!wifi_compact_data.bssids.empty())
+  {
+    wifi_compact_data.ssid_dictionary_version = ssid_dictionary_.version;
+    wifi_compact_pub_.publish(wifi_compact_data);
+  }
   return true;
 }
 
+uint16_t WifiPublisher::ssid_index(const std::string &ssid)
+{
+  auto it = ssid_indices_.find(ssid);
+  if(it != ssid_indices_.end())
+    return it->second;
+
+  // New ssids are appended, so indices stay valid for subscribers that still use an older version of the dictionary.
+  uint16_t index = ssid_dictionary_.ssids.size();
+  ssid_dictionary_.ssids.push_back(ssid);
+  ssid_dictionary_.version++;
+  ssid_indices_[ssid] = index;
+  return index;
+}
+
 void WifiPublisher::reset()
 {
   wifi_scan_close(channel_);
@@ -31,13 +31,17 @@ int main(int argc, char **argv)
   nh.param("wifi_publisher/ms_till_discard", ms_till_discard, ms_till_discard);
   nh.param("/wifi_publisher/scans_per_sec", scans_per_sec, scans_per_sec);
 
+  // Either "legacy" (WifiState), "compact" (WifiState2) or "both".
+  std::string message_format = "legacy";
+  nh.param("/wifi_publisher/message_format", message_format, message_format);
+
   std::vector<unsigned int> channel_list_unsigned (channel_list.begin(), channel_list.end());
 
 
 
   //WifiPublisher publisher(nh, wifi_interface, channel_list_2GHz);
 
-  WifiPublisher publisher(nh,wifi_interface,channel_list_unsigned,ms_till_discard, chans_per_scan);
+  WifiPublisher publisher(nh,wifi_interface,channel_list_unsigned,ms_till_discard, chans_per_scan, message_format);
   ros::Rate loop_rate(scans_per_sec);
 
   while(ros::ok())
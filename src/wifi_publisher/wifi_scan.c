@@ -237,6 +237,11 @@ static int callback_dump(struct nl_msg *msg, void *arg) {
       scan_data->sequence++;
       struct bss_info* data = &scan_data->data[scan_data->sequence-1];
       strcpy(data->bssid, mac_addr);
+      unsigned char *bssid = nla_data(bss[NL80211_BSS_BSSID]);
+      data->bssid_packed = 0;
+      for (int i = 0; i < BSSID_LENGTH; i++) {
+          data->bssid_packed = (data->bssid_packed << 8) | bssid[i];
+      }
       data->frequency = nla_get_u32(bss[NL80211_BSS_FREQUENCY]);
       data->signal_mbm = nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM]);
       data->seen_ms_ago = nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]);
@@ -0,0 +1,56 @@
+#include "wifi_position_estimation/estimation_scheduler.h"
+#include <gtest/gtest.h>
+
+TEST(EstimationScheduler, NeedsAFreshScan)
+{
+  EstimationScheduler scheduler;
+  EXPECT_EQ(EstimationScheduler::STARTED, scheduler.trigger(0.0, 1.0));
+  EXPECT_FALSE(scheduler.finished(1.0, 0.5, 1.0));
+  EXPECT_EQ(EstimationScheduler::NO_FRESH_SCAN, scheduler.trigger(2.0, 1.0));
+  EXPECT_EQ(EstimationScheduler::STARTED, scheduler.trigger(2.0, 1.5));
+}
+
+TEST(EstimationScheduler, ReplaysCoalescedTriggersOnce)
+{
+  EstimationScheduler scheduler;
+  EXPECT_EQ(EstimationScheduler::STARTED, scheduler.trigger(0.0, 1.0));
+  EXPECT_EQ(EstimationScheduler::COALESCED, scheduler.trigger(0.1, 1.1));
+  EXPECT_EQ(EstimationScheduler::COALESCED, scheduler.trigger(0.2, 1.2));
+
+  // The burst starts exactly one more estimation with the latest scan.
+  EXPECT_TRUE(scheduler.finished(1.0, 0.5, 1.2));
+  EXPECT_EQ(EstimationScheduler::COALESCED, scheduler.trigger(1.1, 1.3));
+  EXPECT_TRUE(scheduler.finished(2.0, 0.5, 1.3));
+  EXPECT_FALSE(scheduler.finished(3.0, 0.5, 1.3));
+  EXPECT_EQ(3, scheduler.count(EstimationScheduler::STARTED));
+  EXPECT_EQ(3, scheduler.count(EstimationScheduler::COALESCED));
+}
+
+TEST(EstimationScheduler, ReplayedTriggersNeedAFreshScan)
+{
+  EstimationScheduler scheduler;
+  EXPECT_EQ(EstimationScheduler::STARTED, scheduler.trigger(0.0, 1.0));
+  EXPECT_EQ(EstimationScheduler::COALESCED, scheduler.trigger(0.1, 1.0));
+  EXPECT_FALSE(scheduler.finished(1.0, 0.5, 1.0));
+  EXPECT_EQ(EstimationScheduler::NO_FRESH_SCAN, scheduler.last_outcome());
+}
+
+TEST(EstimationScheduler, KeepsTheMinimumInterval)
+{
+  EstimationScheduler scheduler(5.0);
+  EXPECT_EQ(EstimationScheduler::STARTED, scheduler.trigger(0.0, 1.0));
+  EXPECT_FALSE(scheduler.finished(1.0, 0.5, 1.0));
+  EXPECT_EQ(EstimationScheduler::TOO_SOON, scheduler.trigger(4.0, 2.0));
+  EXPECT_EQ(EstimationScheduler::STARTED, scheduler.trigger(5.0, 2.0));
+}
+
+TEST(EstimationScheduler, KeepsTheCpuBudget)
+{
+  EstimationScheduler scheduler(0.0, 0.1, 10.0);
+  EXPECT_EQ(EstimationScheduler::STARTED, scheduler.trigger(0.0, 1.0));
+  EXPECT_FALSE(scheduler.finished(2.0, 1.0, 1.0));
+  EXPECT_DOUBLE_EQ(0.1, scheduler.cpu_usage(2.0));
+  EXPECT_EQ(EstimationScheduler::OVER_BUDGET, scheduler.trigger(3.0, 2.0));
+  // The estimation leaves the window after budget_window seconds.
+  EXPECT_EQ(EstimationScheduler::STARTED, scheduler.trigger(12.5, 2.0));
+}
@@ -0,0 +1,112 @@
+#include "wifi_position_estimation/grid_filter.h"
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+/// Corridor of 10 x 2 cells of one meter, the cells in column 9 are occupied
+nav_msgs::OccupancyGrid corridor()
+{
+  nav_msgs::OccupancyGrid map;
+  map.info.resolution = 1.0;
+  map.info.width = 10;
+  map.info.height = 2;
+  map.data.assign(20, 0);
+  map.data[9] = 100;
+  map.data[19] = 100;
+  return map;
+}
+
+/// Process whose signal strength drops by 4 dBm per meter along the corridor
+Process falling_signal()
+{
+  Matrix<double, Dynamic, 2> coordinates(22, 2);
+  Matrix<double, Dynamic, 1> observations(22);
+  for(int i = 0; i < 22; i++)
+  {
+    coordinates.row(i) << i / 2, 2 * (i % 2);
+    observations(i) = -40.0 - 4.0 * (i / 2);
+  }
+  // The hyperparameters are logarithms, as stored in the parameter files.
+  return Process(coordinates, observations, -7.0, -1.0, {-0.5, 0.0});
+}
+
+class GridFilterTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    grid_.set_geometry(corridor(), 1.0);
+    grid_.compute({falling_signal()});
+  }
+
+  PrecomputedGrid grid_;
+};
+}
+
+TEST_F(GridFilterTest, EstimateNeedsAReset)
+{
+  GridFilter filter;
+  Eigen::Vector2d mode, mean;
+  Eigen::Matrix2d covariance;
+  EXPECT_TRUE(filter.empty());
+  EXPECT_FALSE(filter.estimate(mode, mean, covariance));
+}
+
+TEST_F(GridFilterTest, ResetSpreadsTheBeliefOverFreeNodes)
+{
+  GridFilter filter;
+  filter.reset(grid_, 0.0);
+  Eigen::Vector2d mode, mean;
+  Eigen::Matrix2d covariance;
+  ASSERT_TRUE(filter.estimate(mode, mean, covariance));
+  // Nodes in columns 0 to 8 and rows 0 to 2 are free, the occupied cells cover columns 9 and 10.
+  EXPECT_NEAR(4.0, mean(0), 1e-9);
+  EXPECT_NEAR(1.0, mean(1), 1e-9);
+  EXPECT_GT(covariance(0, 0), 1.0);
+}
+
+TEST_F(GridFilterTest, UpdateMovesTheModeToMatchingNodes)
+{
+  GridFilter filter;
+  filter.reset(grid_, 0.0);
+  filter.update({{0, -60.0}});
+  filter.update({{0, -60.0}});
+  Eigen::Vector2d mode, mean;
+  Eigen::Matrix2d covariance;
+  ASSERT_TRUE(filter.estimate(mode, mean, covariance));
+  EXPECT_NEAR(5.0, mode(0), 1e-9);
+  EXPECT_NEAR(5.0, mean(0), 0.5);
+}
+
+TEST_F(GridFilterTest, PredictKeepsTheBeliefInFreeSpace)
+{
+  GridFilter filter;
+  filter.reset(grid_, 0.0);
+  for(int i = 0; i < 5; i++)
+    filter.update({{0, -72.0}});
+  Eigen::Vector2d mode, mean, blurred_mean;
+  Eigen::Matrix2d covariance, blurred_covariance;
+  ASSERT_TRUE(filter.estimate(mode, mean, covariance));
+  EXPECT_NEAR(8.0, mode(0), 1e-9);
+
+  // Blurring spreads the belief, but none of it ends up behind the wall.
+  filter.predict(1.0);
+  ASSERT_TRUE(filter.estimate(mode, blurred_mean, blurred_covariance));
+  EXPECT_GT(blurred_covariance(0, 0), covariance(0, 0));
+  EXPECT_LE(blurred_mean(0), 8.0);
+}
+
+TEST_F(GridFilterTest, UniformMixRecoversFromAWrongBelief)
+{
+  GridFilter filter;
+  filter.reset(grid_, 0.5);
+  for(int i = 0; i < 20; i++)
+    filter.update({{0, -40.0}});
+  filter.predict(0.0);
+  filter.update({{0, -72.0}});
+  Eigen::Vector2d mode, mean;
+  Eigen::Matrix2d covariance;
+  ASSERT_TRUE(filter.estimate(mode, mean, covariance));
+  EXPECT_NEAR(8.0, mode(0), 1e-9);
+}
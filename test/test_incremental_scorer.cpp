@@ -0,0 +1,114 @@
+#include "wifi_position_estimation/incremental_scorer.h"
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+namespace
+{
+const int PARTICLES = 50;
+
+/// Normalized means and variances that differ for every particle and process
+void predict(int particle, int ap, double &mean, double &variance)
+{
+  mean = 0.3 + 0.2 * std::sin(0.37 * particle + 1.1 * ap);
+  variance = 0.002 + 0.001 * ((particle * 7 + ap * 3) % 5);
+}
+
+/// Log likelihood of every particle summed up from scratch
+std::vector<double> full_scores(const std::vector<std::pair<int, double>> &observations)
+{
+  std::vector<double> totals(PARTICLES, 0.0);
+  for(int particle = 0; particle < PARTICLES; particle++)
+  {
+    for(auto& observation:observations)
+    {
+      double mean, variance;
+      predict(particle, observation.first, mean, variance);
+      totals[particle] += Process::log_probability_precomputed(mean, variance, observation.second);
+    }
+  }
+  return totals;
+}
+
+/// Scans with unchanged, changed, removed and added access points from one to the next
+const std::vector<std::vector<std::pair<int, double>>> SCANS = {{{0, -50.0}, {1, -62.0}, {2, -71.0}},
+                                                                {{0, -50.0}, {1, -65.0}, {2, -71.0}},
+                                                                {{0, -50.0}, {2, -71.0}, {3, -58.0}},
+                                                                {{2, -74.0}, {3, -58.0}, {4, -80.0}, {5, -45.0}},
+                                                                {{2, -74.0}, {3, -58.0}, {4, -80.0}, {5, -45.0}},
+                                                                {},
+                                                                {{1, -60.0}, {5, -47.0}},
+                                                                {{0, -52.0}, {1, -60.0}, {4, -79.0}, {5, -47.0}}};
+
+void expect_full_scores(const IncrementalScorer &scorer, const std::vector<std::pair<int, double>> &observations)
+{
+  std::vector<double> expected = full_scores(observations);
+  ASSERT_EQ(expected.size(), scorer.log_likelihoods().size());
+  for(int particle = 0; particle < PARTICLES; particle++)
+    EXPECT_NEAR(expected[particle], scorer.log_likelihoods()[particle], 1e-9);
+}
+}
+
+TEST(IncrementalScorer, UpdatesMatchAFullRescore)
+{
+  IncrementalScorer scorer;
+  scorer.reset(PARTICLES, predict, 0);
+  for(auto& scan:SCANS)
+  {
+    scorer.update(scan);
+    expect_full_scores(scorer, scan);
+  }
+}
+
+TEST(IncrementalScorer, PeriodicRescoresMatchAFullRescore)
+{
+  IncrementalScorer scorer;
+  scorer.reset(PARTICLES, predict, 3);
+  for(int round = 0; round < 2; round++)
+  {
+    for(auto& scan:SCANS)
+    {
+      scorer.update(scan);
+      expect_full_scores(scorer, scan);
+    }
+  }
+}
+
+TEST(IncrementalScorer, OnlyTouchesChangedAccessPoints)
+{
+  IncrementalScorer scorer;
+  scorer.reset(PARTICLES, predict, 0);
+  EXPECT_EQ(3, scorer.update(SCANS[0]));
+  // ap 1 is subtracted and added again
+  EXPECT_EQ(2, scorer.update(SCANS[1]));
+  // ap 1 is removed, ap 3 is added
+  EXPECT_EQ(2, scorer.update(SCANS[2]));
+  EXPECT_EQ(0, scorer.update(SCANS[2]));
+}
+
+TEST(IncrementalScorer, PredictsEveryProcessOnce)
+{
+  int predictions = 0;
+  IncrementalScorer scorer;
+  scorer.reset(PARTICLES, [&predictions](int particle, int ap, double &mean, double &variance)
+  {
+    predictions++;
+    predict(particle, ap, mean, variance);
+  }, 2);
+  for(auto& scan:SCANS)
+    scorer.update(scan);
+  EXPECT_EQ(6 * PARTICLES, predictions);
+}
+
+TEST(IncrementalScorer, BestParticleHasTheHighestLogLikelihood)
+{
+  IncrementalScorer scorer;
+  EXPECT_EQ(-1, scorer.best_particle());
+  scorer.reset(PARTICLES, predict, 0);
+  scorer.update(SCANS[3]);
+  std::vector<double> expected = full_scores(SCANS[3]);
+  int best = scorer.best_particle();
+  ASSERT_NE(-1, best);
+  for(int particle = 0; particle < PARTICLES; particle++)
+    EXPECT_LE(expected[particle], expected[best]);
+}
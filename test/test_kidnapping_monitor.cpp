@@ -0,0 +1,49 @@
+#include "wifi_position_estimation/kidnapping_monitor.h"
+#include <gtest/gtest.h>
+#include <limits>
+
+TEST(KidnappingMonitor, DoesNotFailBeforeCalibration)
+{
+  KidnappingMonitor monitor(3.0, 4, 1);
+  for(int i = 0; i < 3; i++)
+    monitor.calibrate(-1.0);
+  EXPECT_FALSE(monitor.calibrated());
+  EXPECT_FALSE(monitor.check(-100.0));
+  EXPECT_TRUE(monitor.last_check_passed());
+}
+
+TEST(KidnappingMonitor, AveragesTheFirstSamples)
+{
+  KidnappingMonitor monitor(3.0, 2, 1, 0.05);
+  monitor.calibrate(-1.0);
+  monitor.calibrate(-3.0);
+  EXPECT_TRUE(monitor.calibrated());
+  EXPECT_DOUBLE_EQ(-2.0, monitor.mean());
+  EXPECT_DOUBLE_EQ(1.0, monitor.variance());
+}
+
+TEST(KidnappingMonitor, IgnoresInfiniteAndNanSamples)
+{
+  KidnappingMonitor monitor(3.0, 1, 1);
+  monitor.calibrate(-std::numeric_limits<double>::infinity());
+  monitor.calibrate(std::numeric_limits<double>::quiet_NaN());
+  EXPECT_FALSE(monitor.calibrated());
+}
+
+TEST(KidnappingMonitor, ReportsConsecutiveFailures)
+{
+  KidnappingMonitor monitor(3.0, 2, 2);
+  monitor.calibrate(-1.0);
+  monitor.calibrate(-3.0);
+
+  // The check fails below -2 - 3 * 1.
+  EXPECT_FALSE(monitor.check(-4.9));
+  EXPECT_TRUE(monitor.last_check_passed());
+  EXPECT_FALSE(monitor.check(-5.1));
+  EXPECT_FALSE(monitor.last_check_passed());
+  // A passed check starts the count over.
+  EXPECT_FALSE(monitor.check(-2.0));
+  EXPECT_FALSE(monitor.check(-5.1));
+  EXPECT_TRUE(monitor.check(-5.1));
+  EXPECT_FALSE(monitor.check(-5.1));
+}
@@ -0,0 +1,126 @@
+#include "wifi_position_estimation/likelihood_pyramid.h"
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace
+{
+/// Room of 7 x 5 cells of one meter with a wall in column 3, open in row 4
+nav_msgs::OccupancyGrid room()
+{
+  nav_msgs::OccupancyGrid map;
+  map.info.resolution = 1.0;
+  map.info.width = 7;
+  map.info.height = 5;
+  map.data.assign(35, 0);
+  for(int row = 0; row < 4; row++)
+    map.data[row * 7 + 3] = 100;
+  return map;
+}
+
+/// Process with a signal strength that falls from a corner of the room
+Process access_point(double x0, double y0)
+{
+  Matrix<double, Dynamic, 2> coordinates(35, 2);
+  Matrix<double, Dynamic, 1> observations(35);
+  for(int i = 0; i < 35; i++)
+  {
+    coordinates.row(i) << i % 7, i / 7;
+    observations(i) = -40.0 - 5.0 * std::hypot(i % 7 - x0, i / 7 - y0);
+  }
+  // The hyperparameters are logarithms, as stored in the parameter files.
+  return Process(coordinates, observations, -5.0, -1.0, {0.0, 0.0});
+}
+
+/// Log likelihood of a node, as the search computes it
+double node_log_likelihood(const PrecomputedGrid &grid, int col, int row,
+                           const std::vector<std::pair<int, double>> &observations)
+{
+  double total = 0.0;
+  for(auto& observation:observations)
+  {
+    double log_prob = Process::log_probability_precomputed(grid.node_mean(col, row, observation.first),
+                                                           grid.node_variance(col, row, observation.first),
+                                                           observation.second);
+    if(!std::isnan(log_prob))
+      total += log_prob;
+  }
+  return total;
+}
+}
+
+TEST(LikelihoodPyramid, BoundIsAtLeastEveryLogProbabilityInTheRanges)
+{
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  for(int i = 0; i < 1000; i++)
+  {
+    double mean_min = -2.0 + 4.0 * unit(generator);
+    double mean_max = mean_min + 2.0 * unit(generator);
+    double variance_min = 1e-3 + unit(generator);
+    double variance_max = variance_min + unit(generator);
+    double z = -100.0 + 70.0 * unit(generator);
+    double bound = Process::log_probability_bound(mean_min, mean_max, variance_min, variance_max, z);
+    for(int j = 0; j < 20; j++)
+    {
+      double mean = mean_min + (mean_max - mean_min) * unit(generator);
+      double variance = variance_min + (variance_max - variance_min) * unit(generator);
+      EXPECT_GE(bound + 1e-9, Process::log_probability_precomputed(mean, variance, z));
+    }
+  }
+}
+
+TEST(LikelihoodPyramid, SearchFindsTheBestFreeNode)
+{
+  PrecomputedGrid grid;
+  grid.set_geometry(room(), 0.5);
+  grid.compute({access_point(0.0, 0.0), access_point(6.0, 0.0), access_point(3.0, 4.0)});
+  LikelihoodPyramid pyramid;
+  pyramid.build(grid);
+  ASSERT_FALSE(pyramid.empty());
+
+  std::vector<std::vector<std::pair<int, double>>> scans = {{{0, -45.0}, {1, -70.0}, {2, -55.0}},
+                                                            {{0, -72.0}, {1, -48.0}},
+                                                            {{2, -40.0}},
+                                                            {{0, -60.0}, {1, -60.0}, {2, -52.0}}};
+  for(auto& scan:scans)
+  {
+    double best = -std::numeric_limits<double>::infinity();
+    for(int row = 0; row < grid.rows(); row++)
+      for(int col = 0; col < grid.cols(); col++)
+        if(grid.is_free_node(col, row))
+          best = std::max(best, node_log_likelihood(grid, col, row, scan));
+
+    Eigen::Vector2d position;
+    double log_likelihood;
+    ASSERT_GT(pyramid.search(scan, position, log_likelihood), 0);
+    EXPECT_NEAR(best, log_likelihood, 1e-9);
+
+    // The position is a free node with that log likelihood.
+    int col = int(std::lround(position(0) / grid.resolution()));
+    int row = int(std::lround(position(1) / grid.resolution()));
+    EXPECT_TRUE(grid.is_free_node(col, row));
+    EXPECT_NEAR(best, node_log_likelihood(grid, col, row, scan), 1e-9);
+  }
+}
+
+TEST(LikelihoodPyramid, SingleNodeGridHasNoLevels)
+{
+  nav_msgs::OccupancyGrid map;
+  map.info.resolution = 1.0;
+  map.info.width = 1;
+  map.info.height = 1;
+  map.data.assign(1, 0);
+  PrecomputedGrid grid;
+  grid.set_geometry(map, 2.0);
+  grid.compute({access_point(0.0, 0.0)});
+  LikelihoodPyramid pyramid;
+  pyramid.build(grid);
+
+  Eigen::Vector2d position;
+  double log_likelihood;
+  EXPECT_TRUE(pyramid.empty());
+  EXPECT_EQ(-1, pyramid.search({{0, -50.0}}, position, log_likelihood));
+}
@@ -0,0 +1,71 @@
+#include "wifi_position_estimation/likelihood_table.h"
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+
+TEST(LikelihoodTable, BinKeysOfNegativeBinsDoNotCollide)
+{
+  std::set<uint64_t> keys;
+  for(int64_t variance_bin = -3; variance_bin <= 3; variance_bin++)
+    for(int64_t mean_bin = -3; mean_bin <= 3; mean_bin++)
+      keys.insert(LikelihoodTable::bin_key(variance_bin, mean_bin));
+  EXPECT_EQ(49u, keys.size());
+
+  // A negative mean bin must not spill into the variance bits.
+  EXPECT_EQ(0xffffffffull, LikelihoodTable::bin_key(0, -1));
+  EXPECT_EQ(0xffffffff00000000ull, LikelihoodTable::bin_key(-1, 0));
+}
+
+TEST(LikelihoodTable, ColumnsAreClamped)
+{
+  EXPECT_EQ(0, LikelihoodTable::column(-200.0));
+  EXPECT_EQ(0, LikelihoodTable::column(LikelihoodTable::MIN_DBM));
+  EXPECT_EQ(LikelihoodTable::ROW_LENGTH - 1, LikelihoodTable::column(0.0));
+  EXPECT_EQ(-60 - LikelihoodTable::MIN_DBM, LikelihoodTable::column(-59.6));
+}
+
+TEST(LikelihoodTable, RowsApproximateTheAnalyticLogLikelihood)
+{
+  int n_points = 200;
+  int n_aps = 5;
+  std::mt19937 random_engine(42);
+  std::uniform_real_distribution<double> mean_distribution(0.0, 0.7);
+  std::uniform_real_distribution<double> log_variance_distribution(log(0.001), log(0.05));
+  std::vector<PrecomputedDataPoint> data(n_points * n_aps);
+  for(auto& it:data)
+    it = {mean_distribution(random_engine), exp(log_variance_distribution(random_engine))};
+
+  LikelihoodTable table;
+  ASSERT_TRUE(table.build(data, n_points, n_aps, 1 << 24, 0.01));
+  EXPECT_LE(table.bytes(), size_t(1 << 24));
+  // The finest clusters have a step of 0.01 standard deviations and 0.01 in the log variance.
+  EXPECT_DOUBLE_EQ(0.01, table.cluster_step());
+
+  double max_error = 0.0;
+  for(int point = 0; point < n_points; point++)
+  {
+    for(int ap = 0; ap < n_aps; ap++)
+    {
+      const PrecomputedDataPoint &it = data[point * n_aps + ap];
+      for(int dbm = -95; dbm <= -30; dbm += 5)
+      {
+        double analytic = Process::log_probability_precomputed(it.mean_, it.variance_, dbm);
+        double looked_up = table.log_likelihood(table.row(point, ap)[LikelihoodTable::column(dbm)]);
+        max_error = std::max(max_error, fabs(analytic - looked_up));
+      }
+    }
+  }
+  EXPECT_LT(max_error, 0.1);
+}
+
+TEST(LikelihoodTable, RejectsTooSmallBudgets)
+{
+  std::vector<PrecomputedDataPoint> data(100, {0.5, 0.01});
+  LikelihoodTable table;
+  EXPECT_FALSE(table.build(data, 50, 2, 100, 0.01));
+  EXPECT_TRUE(table.empty());
+  // Identical means and variances share one row.
+  ASSERT_TRUE(table.build(data, 50, 2, 1 << 16, 0.01));
+  EXPECT_EQ(1, table.clusters());
+}
@@ -0,0 +1,59 @@
+#include "mac_dictionary.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+TEST(MacDictionary, PacksAllSeparatorsAndCases)
+{
+  uint64_t colons, underscores, upper;
+  ASSERT_TRUE(pack_mac("aa:bb:cc:dd:ee:ff", colons));
+  ASSERT_TRUE(pack_mac("aa_bb_cc_dd_ee_ff", underscores));
+  ASSERT_TRUE(pack_mac("AA-BB-CC-DD-EE-FF", upper));
+  EXPECT_EQ(0xaabbccddeeffull, colons);
+  EXPECT_EQ(colons, underscores);
+  EXPECT_EQ(colons, upper);
+  EXPECT_EQ("aa_bb_cc_dd_ee_ff", unpack_mac(colons, '_'));
+}
+
+TEST(MacDictionary, RejectsMalformedMacs)
+{
+  uint64_t packed;
+  EXPECT_FALSE(pack_mac("aa:bb:cc:dd:ee", packed));
+  EXPECT_FALSE(pack_mac("aa:bb:cc:dd:ee:ff:00", packed));
+  EXPECT_FALSE(pack_mac("a:abb:cc:dd:ee:ff", packed));
+  EXPECT_FALSE(pack_mac("parameters", packed));
+}
+
+TEST(MacDictionary, InsertKeepsTheIndexOfKnownMacs)
+{
+  MacDictionary dictionary;
+  EXPECT_EQ(0, dictionary.insert(1));
+  EXPECT_EQ(1, dictionary.insert(2));
+  EXPECT_EQ(0, dictionary.insert(1));
+  EXPECT_EQ(2, dictionary.size());
+  EXPECT_EQ(1, dictionary.index("00:00:00:00:00:02"));
+  EXPECT_EQ(-1, dictionary.index("00:00:00:00:00:03"));
+  EXPECT_EQ(-1, dictionary.index("not a mac"));
+}
+
+TEST(MacDictionary, MacFilesDropsDuplicatesAndOtherFiles)
+{
+  boost::filesystem::path directory = boost::filesystem::temp_directory_path() /
+                                      boost::filesystem::unique_path("mac_files_%%%%%%%%");
+  boost::filesystem::create_directory(directory);
+  boost::filesystem::create_directory(directory / "parameters");
+  for(auto name:{"aa_bb_cc_dd_ee_ff.csv", "AA:BB:CC:DD:EE:FF.csv", "00_11_22_33_44_55.csv", "notes.txt"})
+    std::ofstream((directory / name).string()) << "0\n";
+
+  std::vector<std::string> ignored;
+  std::map<uint64_t, std::string> files = mac_files(directory.string(), ignored);
+  boost::filesystem::remove_all(directory);
+
+  ASSERT_EQ(2u, files.size());
+  // Upper case letters sort first, so that file is kept.
+  EXPECT_EQ(directory.string() + "/AA:BB:CC:DD:EE:FF.csv", files[0xaabbccddeeffull]);
+  EXPECT_EQ(directory.string() + "/00_11_22_33_44_55.csv", files[0x001122334455ull]);
+  ASSERT_EQ(2u, ignored.size());
+  EXPECT_EQ(directory.string() + "/aa_bb_cc_dd_ee_ff.csv", ignored[0]);
+  EXPECT_EQ(directory.string() + "/notes.txt", ignored[1]);
+}
@@ -0,0 +1,100 @@
+#include "wifi_position_estimation/model_bundle.h"
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+namespace
+{
+class ModelBundleTest : public ::testing::Test
+{
+protected:
+  const uint64_t key_ = 0x0123456789abcdefull;
+  std::vector<uint64_t> macs_;
+  std::vector<Process> processes_;
+  std::string file_;
+
+  void SetUp() override
+  {
+    for(int ap = 0; ap < 2; ap++)
+    {
+      Matrix<double, Dynamic, 2> coordinates(6, 2);
+      Matrix<double, Dynamic, 1> observations(6);
+      for(int i = 0; i < 6; i++)
+      {
+        coordinates.row(i) << i, (i * 7) % 3;
+        observations(i) = -40.0 - 5.0 * i - 3.0 * ap;
+      }
+      processes_.push_back(Process(coordinates, observations, -5.0, -1.0, {-0.5, 0.0}));
+      macs_.push_back(0xaabbccddee00ull + ap);
+    }
+    file_ = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("bundle_%%%%%%%%.bin")).string();
+    ASSERT_TRUE(ModelBundle::write(file_, key_, macs_, processes_));
+  }
+
+  void TearDown() override
+  {
+    boost::filesystem::remove(file_);
+  }
+
+  /// Overwrites 8 bytes of the file at an offset
+  void patch(size_t offset, uint64_t value)
+  {
+    std::fstream file(file_.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+};
+}
+
+TEST_F(ModelBundleTest, MappedProcessesPredictLikeTheOriginals)
+{
+  ModelBundle bundle;
+  ASSERT_TRUE(bundle.load(file_, key_));
+  ASSERT_EQ(2, bundle.size());
+  for(int ap = 0; ap < bundle.size(); ap++)
+  {
+    EXPECT_EQ(macs_[ap], bundle.mac(ap));
+    Process mapped(bundle.model(ap));
+    for(double x = -1.0; x <= 6.0; x += 0.5)
+    {
+      double mean, variance, mapped_mean, mapped_variance;
+      processes_[ap].predict(x, 1.0, mean, variance);
+      mapped.predict(x, 1.0, mapped_mean, mapped_variance);
+      EXPECT_NEAR(mean, mapped_mean, 1e-9);
+      EXPECT_NEAR(variance, mapped_variance, 1e-9);
+    }
+  }
+}
+
+TEST_F(ModelBundleTest, RejectsOtherKeysAndMissingFiles)
+{
+  ModelBundle bundle;
+  EXPECT_FALSE(bundle.load(file_, key_ + 1));
+  EXPECT_EQ(0, bundle.size());
+  EXPECT_FALSE(bundle.load(file_ + ".missing", key_));
+  EXPECT_FALSE(ModelBundle::write(file_, key_, {macs_[0]}, processes_));
+}
+
+TEST_F(ModelBundleTest, RejectsTruncatedFiles)
+{
+  boost::filesystem::resize_file(file_, boost::filesystem::file_size(file_) - 8);
+  ModelBundle bundle;
+  EXPECT_FALSE(bundle.load(file_, key_));
+}
+
+TEST_F(ModelBundleTest, RejectsCorruptCounts)
+{
+  ModelBundle bundle;
+  // n_models is the fifth field of the header. This count wraps n_models * sizeof(Entry) around to 0.
+  patch(32, 1ull << 60);
+  EXPECT_FALSE(bundle.load(file_, key_));
+  patch(32, 2);
+  ASSERT_TRUE(bundle.load(file_, key_));
+
+  // n is the second field of the first entry. n * n wraps around to 0 for the first value, the arrays of the second
+  // one do not fit into the file.
+  patch(48, 1ull << 32);
+  EXPECT_FALSE(bundle.load(file_, key_));
+  patch(48, 1ull << 20);
+  EXPECT_FALSE(bundle.load(file_, key_));
+}
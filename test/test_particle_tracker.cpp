@@ -0,0 +1,102 @@
+#include "wifi_position_estimation/particle_tracker.h"
+#include <gtest/gtest.h>
+#include <limits>
+
+namespace
+{
+/// Draws positions on a 20 x 20 meter square
+class SquareSampler
+{
+public:
+  bool operator()(Eigen::Vector2d &position)
+  {
+    position = Eigen::Vector2d(distribution_(engine_), distribution_(engine_));
+    return true;
+  }
+
+private:
+  std::mt19937 engine_{42};
+  std::uniform_real_distribution<double> distribution_{0.0, 20.0};
+};
+
+/// Log likelihood of a scan taken at (5, 5)
+double peak(const Eigen::Vector2d &position)
+{
+  return -0.5 * (position - Eigen::Vector2d(5.0, 5.0)).squaredNorm();
+}
+}
+
+TEST(ParticleTracker, ResetLeavesOutFailedPositions)
+{
+  ParticleTracker tracker;
+  tracker.configure(10, 100, 1.0, 0.1, 0.1);
+  int calls = 0;
+  tracker.reset([&calls](Eigen::Vector2d &position)
+                {
+                  position = Eigen::Vector2d::Zero();
+                  return calls++ % 2 == 0;
+                });
+  EXPECT_EQ(100, calls);
+  EXPECT_EQ(50, tracker.size());
+
+  tracker.reset([](Eigen::Vector2d &) { return false; });
+  EXPECT_EQ(0, tracker.size());
+}
+
+TEST(ParticleTracker, ConvergesAndShrinksToMinParticles)
+{
+  ParticleTracker tracker;
+  tracker.configure(50, 1000, 1.0, 0.1, 0.1);
+  SquareSampler sampler;
+  tracker.reset(std::ref(sampler));
+  ASSERT_EQ(1000, tracker.size());
+  EXPECT_GT(tracker.spread(), 2.0);
+
+  for(int i = 0; i < 10; i++)
+  {
+    tracker.predict(0.0, 0.0, 0.0);
+    tracker.update(peak, std::ref(sampler));
+  }
+  Eigen::Vector3d mean;
+  Eigen::Matrix3d covariance;
+  tracker.estimate(mean, covariance);
+  EXPECT_NEAR(5.0, mean(0), 0.5);
+  EXPECT_NEAR(5.0, mean(1), 0.5);
+  EXPECT_LT(tracker.spread(), 1.0);
+  EXPECT_EQ(50, tracker.size());
+}
+
+TEST(ParticleTracker, ResetsWhenNoParticleFitsTheScan)
+{
+  ParticleTracker tracker;
+  tracker.configure(10, 100, 1.0, 0.1, 0.1);
+  int calls = 0;
+  auto sampler = [&calls](Eigen::Vector2d &position)
+  {
+    position = Eigen::Vector2d(calls++ % 10, 0.0);
+    return true;
+  };
+  tracker.reset(sampler);
+  tracker.update([](const Eigen::Vector2d &) { return -std::numeric_limits<double>::infinity(); }, sampler);
+  EXPECT_EQ(200, calls);
+  EXPECT_EQ(100, tracker.size());
+}
+
+TEST(ParticleTracker, PredictMovesAlongTheHeading)
+{
+  ParticleTracker tracker;
+  tracker.configure(1, 1, 1.0, 0.0, 0.0);
+  tracker.reset([](Eigen::Vector2d &position)
+                {
+                  position = Eigen::Vector2d::Zero();
+                  return true;
+                });
+  Eigen::Vector3d start, end;
+  Eigen::Matrix3d covariance;
+  tracker.estimate(start, covariance);
+  tracker.predict(2.0, 0.0, 0.5);
+  tracker.estimate(end, covariance);
+  EXPECT_NEAR(2.0 * cos(start(2)), end(0), 0.05);
+  EXPECT_NEAR(2.0 * sin(start(2)), end(1), 0.05);
+  EXPECT_NEAR(remainder(start(2) + 0.5, 2.0 * M_PI), end(2), 0.05);
+}
@@ -0,0 +1,70 @@
+#include "wifi_position_estimation/posterior_summary.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+
+TEST(PosteriorSummary, MomentsNeedTwoFiniteParticles)
+{
+  PosteriorSummary summary;
+  Eigen::Vector2d mean;
+  Eigen::Matrix2d covariance;
+  summary.add(Eigen::Vector2d(0.0, 0.0), 0.0);
+  summary.add(Eigen::Vector2d(1.0, 0.0), -std::numeric_limits<double>::infinity());
+  summary.add(Eigen::Vector2d(2.0, 0.0), std::numeric_limits<double>::quiet_NaN());
+  EXPECT_FALSE(summary.moments(mean, covariance));
+}
+
+TEST(PosteriorSummary, MomentsWeightByLikelihood)
+{
+  PosteriorSummary summary;
+  summary.add(Eigen::Vector2d(0.0, 0.0), log(1.0));
+  summary.add(Eigen::Vector2d(4.0, 2.0), log(3.0));
+  summary.add(Eigen::Vector2d(9.0, 9.0), -std::numeric_limits<double>::infinity());
+  Eigen::Vector2d mean;
+  Eigen::Matrix2d covariance;
+  ASSERT_TRUE(summary.moments(mean, covariance));
+  EXPECT_NEAR(3.0, mean(0), 1e-12);
+  EXPECT_NEAR(1.5, mean(1), 1e-12);
+  EXPECT_NEAR(3.0, covariance(0, 0), 1e-12);
+  EXPECT_NEAR(1.5, covariance(0, 1), 1e-12);
+  EXPECT_NEAR(0.75, covariance(1, 1), 1e-12);
+}
+
+TEST(PosteriorSummary, LogMeanLikelihood)
+{
+  PosteriorSummary summary;
+  EXPECT_TRUE(std::isinf(summary.log_mean_likelihood()));
+  summary.add(Eigen::Vector2d(0.0, 0.0), log(1.0));
+  summary.add(Eigen::Vector2d(1.0, 0.0), log(3.0));
+  EXPECT_NEAR(log(2.0), summary.log_mean_likelihood(), 1e-12);
+}
+
+TEST(PosteriorSummary, ModesAreSeparatedAndSorted)
+{
+  PosteriorSummary summary;
+  // Two clusters, the one around (10, 0) holds more weight. The particles next to (0, 0) fall into neighboring cells.
+  summary.add(Eigen::Vector2d(0.5, 0.5), log(1.0));
+  summary.add(Eigen::Vector2d(1.5, 0.5), log(2.0));
+  summary.add(Eigen::Vector2d(10.5, 0.5), log(4.0));
+  summary.add(Eigen::Vector2d(10.6, 0.5), log(1.0));
+
+  std::vector<PosteriorSummary::Mode> modes = summary.modes(5, 1.0);
+  ASSERT_EQ(2u, modes.size());
+  EXPECT_EQ(10.5, modes[0].first(0));
+  EXPECT_NEAR(5.0 / 8.0, modes[0].second, 1e-12);
+  EXPECT_EQ(1.5, modes[1].first(0));
+  EXPECT_NEAR(3.0 / 8.0, modes[1].second, 1e-12);
+
+  ASSERT_EQ(1u, summary.modes(1, 1.0).size());
+}
+
+TEST(PosteriorSummary, ModesRejectInvalidArguments)
+{
+  PosteriorSummary summary;
+  summary.add(Eigen::Vector2d(0.5, 0.5), 0.0);
+  EXPECT_TRUE(summary.modes(0, 1.0).empty());
+  EXPECT_TRUE(summary.modes(-1, 1.0).empty());
+  EXPECT_TRUE(summary.modes(1, 0.0).empty());
+  EXPECT_TRUE(summary.modes(1, -1.0).empty());
+  EXPECT_TRUE(summary.modes(1, std::numeric_limits<double>::quiet_NaN()).empty());
+}
@@ -0,0 +1,111 @@
+#include "wifi_position_estimation/precompute_cache.h"
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+namespace
+{
+class PrecomputeCacheTest : public ::testing::Test
+{
+protected:
+  const uint64_t key_ = 0x0123456789abcdefull;
+  const int n_aps_ = 3;
+  std::vector<Eigen::Vector2d> points_;
+  PrecomputedTable table_;
+  std::string file_;
+
+  void SetUp() override
+  {
+    std::vector<PrecomputedDataPoint> data;
+    for(int point = 0; point < 10; point++)
+    {
+      points_.push_back(Eigen::Vector2d(point, -point));
+      for(int ap = 0; ap < n_aps_; ap++)
+        data.push_back({0.1 * point + 0.01 * ap, 0.001 * (ap + 1)});
+    }
+    table_.build(data, points_.size(), n_aps_, PrecomputedTable::FIXED16);
+    file_ = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cache_%%%%%%%%.bin")).string();
+    ASSERT_TRUE(PrecomputeCache::save(file_, key_, points_, table_));
+  }
+
+  void TearDown() override
+  {
+    boost::filesystem::remove(file_);
+  }
+
+  /// Overwrites 8 bytes of the file at an offset
+  void patch(size_t offset, uint64_t value)
+  {
+    std::fstream file(file_.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+};
+}
+
+TEST(CacheKey, DependsOnEveryByte)
+{
+  CacheKey a, b, c;
+  a.add(1.0);
+  a.add(std::string("map"));
+  b.add(1.0);
+  b.add(std::string("map"));
+  c.add(1.0);
+  c.add(std::string("mAp"));
+  EXPECT_EQ(a.value(), b.value());
+  EXPECT_NE(a.value(), c.value());
+}
+
+TEST_F(PrecomputeCacheTest, LoadsSavedFiles)
+{
+  PrecomputeCache cache;
+  std::vector<Eigen::Vector2d> points;
+  PrecomputedTable table;
+  ASSERT_TRUE(cache.load(file_, key_, n_aps_, PrecomputedTable::FIXED16, points, table));
+  ASSERT_EQ(points_.size(), points.size());
+  for(size_t point = 0; point < points.size(); point++)
+  {
+    EXPECT_EQ(points_[point], points[point]);
+    for(int ap = 0; ap < n_aps_; ap++)
+    {
+      double mean, variance, loaded_mean, loaded_variance;
+      table_.get(point, ap, mean, variance);
+      table.get(point, ap, loaded_mean, loaded_variance);
+      EXPECT_EQ(mean, loaded_mean);
+      EXPECT_EQ(variance, loaded_variance);
+    }
+  }
+}
+
+TEST_F(PrecomputeCacheTest, RejectsMismatchingFiles)
+{
+  PrecomputeCache cache;
+  std::vector<Eigen::Vector2d> points;
+  PrecomputedTable table;
+  EXPECT_FALSE(cache.load(file_ + ".missing", key_, n_aps_, PrecomputedTable::FIXED16, points, table));
+  EXPECT_FALSE(cache.load(file_, key_ + 1, n_aps_, PrecomputedTable::FIXED16, points, table));
+  EXPECT_FALSE(cache.load(file_, key_, n_aps_ + 1, PrecomputedTable::FIXED16, points, table));
+  EXPECT_FALSE(cache.load(file_, key_, n_aps_, PrecomputedTable::FLOAT, points, table));
+}
+
+TEST_F(PrecomputeCacheTest, RejectsTruncatedFiles)
+{
+  boost::filesystem::resize_file(file_, boost::filesystem::file_size(file_) - 1);
+  PrecomputeCache cache;
+  std::vector<Eigen::Vector2d> points;
+  PrecomputedTable table;
+  EXPECT_FALSE(cache.load(file_, key_, n_aps_, PrecomputedTable::FIXED16, points, table));
+}
+
+TEST_F(PrecomputeCacheTest, RejectsCorruptPointCounts)
+{
+  PrecomputeCache cache;
+  std::vector<Eigen::Vector2d> points;
+  PrecomputedTable table;
+  // n_points is the fifth field of the header. This count wraps n_points * 16 around to the size of the 10 points,
+  // and its lower 32 bits match the table as well.
+  patch(32, (1ull << 60) + 10);
+  EXPECT_FALSE(cache.load(file_, key_, n_aps_, PrecomputedTable::FIXED16, points, table));
+  patch(32, 11);
+  EXPECT_FALSE(cache.load(file_, key_, n_aps_, PrecomputedTable::FIXED16, points, table));
+}
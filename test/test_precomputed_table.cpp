@@ -0,0 +1,143 @@
+#include "wifi_position_estimation/precomputed_table.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <sstream>
+
+namespace
+{
+/**
+ * Synthetic precomputed data and scans, seeded so the errors are reproducible. The means and variances cover the
+ * normalized range of the processes, about -100 to -30 dBm.
+ */
+class PrecomputedTableTest : public ::testing::Test
+{
+protected:
+  const int n_points_ = 5000;
+  const int n_aps_ = 100;
+  const int n_scans_ = 50;
+  const int observations_per_scan_ = 20;
+
+  std::vector<PrecomputedDataPoint> data_;
+  std::vector<std::vector<std::pair<int, double>>> scans_;
+
+  void SetUp() override
+  {
+    std::mt19937 random_engine(42);
+    std::uniform_real_distribution<double> mean_distribution(0.0, 0.7);
+    std::uniform_real_distribution<double> log_variance_distribution(log(0.001), log(0.05));
+    data_.resize(size_t(n_points_) * n_aps_);
+    for(auto& it:data_)
+      it = {mean_distribution(random_engine), exp(log_variance_distribution(random_engine))};
+
+    std::uniform_int_distribution<int> ap_distribution(0, n_aps_ - 1);
+    std::uniform_int_distribution<int> dbm_distribution(-95, -30);
+    scans_.resize(n_scans_);
+    for(auto& scan:scans_)
+      for(int i = 0; i < observations_per_scan_; i++)
+        scan.push_back(std::make_pair(ap_distribution(random_engine), double(dbm_distribution(random_engine))));
+  }
+
+  /**
+   * Scores every scan at every point with a table and with the double values.
+   * @param max_error Will be set to the largest difference of a total log likelihood
+   * @return Number of scans whose most likely point differs
+   */
+  int compare(const PrecomputedTable &table, double &max_error) const
+  {
+    max_error = 0.0;
+    int changed = 0;
+    for(auto& scan:scans_)
+    {
+      int best = -1, best_table = -1;
+      double best_total = -std::numeric_limits<double>::infinity();
+      double best_table_total = -std::numeric_limits<double>::infinity();
+      for(int point = 0; point < n_points_; point++)
+      {
+        double total = 0.0, table_total = 0.0;
+        for(auto& observation:scan)
+        {
+          const PrecomputedDataPoint &it = data_[size_t(point) * n_aps_ + observation.first];
+          total += Process::log_probability_precomputed(it.mean_, it.variance_, observation.second);
+          table_total += table.log_probability(point, observation.first, observation.second);
+        }
+        max_error = std::max(max_error, fabs(total - table_total));
+        if(total > best_total)
+        {
+          best_total = total;
+          best = point;
+        }
+        if(table_total > best_table_total)
+        {
+          best_table_total = table_total;
+          best_table = point;
+        }
+      }
+      changed += best != best_table;
+    }
+    return changed;
+  }
+};
+}
+
+TEST_F(PrecomputedTableTest, DoubleIsExact)
+{
+  PrecomputedTable table;
+  table.build(data_, n_points_, n_aps_, PrecomputedTable::DOUBLE);
+  double max_error;
+  EXPECT_EQ(0, compare(table, max_error));
+  EXPECT_EQ(0.0, max_error);
+}
+
+TEST_F(PrecomputedTableTest, FloatStaysWithinTolerance)
+{
+  PrecomputedTable table;
+  table.build(data_, n_points_, n_aps_, PrecomputedTable::FLOAT);
+  EXPECT_EQ(size_t(n_points_) * n_aps_ * 8, table.bytes());
+  double max_error;
+  EXPECT_EQ(0, compare(table, max_error));
+  EXPECT_LT(max_error, 1e-4);
+}
+
+TEST_F(PrecomputedTableTest, Fixed16StaysWithinTolerance)
+{
+  PrecomputedTable table;
+  table.build(data_, n_points_, n_aps_, PrecomputedTable::FIXED16);
+  EXPECT_EQ(size_t(n_points_) * n_aps_ * 4 + 4 * n_aps_ * sizeof(double), table.bytes());
+  double max_error;
+  EXPECT_EQ(0, compare(table, max_error));
+  EXPECT_LT(max_error, 0.05);
+}
+
+TEST_F(PrecomputedTableTest, AttachReadsWrittenTables)
+{
+  for(auto precision:{PrecomputedTable::DOUBLE, PrecomputedTable::FLOAT, PrecomputedTable::FIXED16})
+  {
+    PrecomputedTable table;
+    table.build(data_, n_points_, n_aps_, precision);
+    std::ostringstream out;
+    ASSERT_TRUE(table.write(out));
+    std::string bytes = out.str();
+    // Copied into doubles, so the values are aligned to 8 bytes.
+    std::vector<double> aligned((bytes.size() + 7) / 8);
+    memcpy(aligned.data(), bytes.data(), bytes.size());
+
+    PrecomputedTable attached;
+    EXPECT_FALSE(attached.attach(reinterpret_cast<const char *>(aligned.data()), bytes.size() - 1, n_points_, n_aps_,
+                                 precision));
+    ASSERT_TRUE(attached.attach(reinterpret_cast<const char *>(aligned.data()), bytes.size(), n_points_, n_aps_,
+                                precision));
+    for(int point = 0; point < n_points_; point += 499)
+    {
+      for(int ap = 0; ap < n_aps_; ap += 7)
+      {
+        double mean, variance, attached_mean, attached_variance;
+        table.get(point, ap, mean, variance);
+        attached.get(point, ap, attached_mean, attached_variance);
+        EXPECT_EQ(mean, attached_mean);
+        EXPECT_EQ(variance, attached_variance);
+      }
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#include "wifi_position_estimation/gaussian_process/gaussian_process.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+namespace
+{
+const double STEP = 1e-5;
+
+/// Process trained on a grid of 5 x 4 points with an irregular signal strength
+Process irregular_signal()
+{
+  Matrix<double, Dynamic, 2> coordinates(20, 2);
+  Matrix<double, Dynamic, 1> observations(20);
+  for(int i = 0; i < 20; i++)
+  {
+    double x = i % 5;
+    double y = i / 5;
+    coordinates.row(i) << x, y;
+    observations(i) = -50.0 - 6.0 * std::sin(x) + 4.0 * std::cos(1.3 * y) - 2.0 * x * y / 5.0;
+  }
+  // The hyperparameters are logarithms, as stored in the parameter files.
+  return Process(coordinates, observations, -4.0, -0.5, {-0.3, 0.2});
+}
+}
+
+TEST(ProcessGradient, KernelGradientMatchesFiniteDifferences)
+{
+  ARD_SE_Kernel kernel(-4.0, -0.5, -0.3, 0.2);
+  Vector2d pos2(0.3, -0.2);
+  for(const Vector2d &pos1:{Vector2d(1.0, 0.5), Vector2d(-0.7, 0.1), Vector2d(0.35, -0.1)})
+  {
+    Vector2d gradient = kernel.position_gradient(pos1, pos2);
+    for(int d = 0; d < 2; d++)
+    {
+      Vector2d step = Vector2d::Zero();
+      step(d) = STEP;
+      double numeric = (kernel.covariance(pos1 + step, pos2) - kernel.covariance(pos1 - step, pos2)) / (2.0 * STEP);
+      EXPECT_NEAR(numeric, gradient(d), 1e-6);
+    }
+  }
+}
+
+TEST(ProcessGradient, PredictionGradientsMatchFiniteDifferences)
+{
+  Process process = irregular_signal();
+  // Positions between the training points, whose covariance with themselves would add the noise
+  for(const Vector2d &position:{Vector2d(0.5, 0.5), Vector2d(1.7, 2.3), Vector2d(3.2, 0.4), Vector2d(2.5, 2.9),
+                                Vector2d(4.6, 1.1)})
+  {
+    double mean, variance;
+    Vector2d mean_gradient, variance_gradient;
+    process.predict_with_gradient(position(0), position(1), mean, variance, mean_gradient, variance_gradient);
+
+    double plain_mean, plain_variance;
+    process.predict(position(0), position(1), plain_mean, plain_variance);
+    EXPECT_NEAR(plain_mean, mean, 1e-12);
+    EXPECT_NEAR(plain_variance, variance, 1e-12);
+
+    for(int d = 0; d < 2; d++)
+    {
+      Vector2d step = Vector2d::Zero();
+      step(d) = STEP;
+      double mean_plus, variance_plus, mean_minus, variance_minus;
+      process.predict(position(0) + step(0), position(1) + step(1), mean_plus, variance_plus);
+      process.predict(position(0) - step(0), position(1) - step(1), mean_minus, variance_minus);
+      EXPECT_NEAR((mean_plus - mean_minus) / (2.0 * STEP), mean_gradient(d), 1e-6);
+      EXPECT_NEAR((variance_plus - variance_minus) / (2.0 * STEP), variance_gradient(d), 1e-6);
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#include "wifi_position_estimation/result_cache.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+EstimationResult result_at(double x)
+{
+  EstimationResult result;
+  result.pose.pose.pose.position.x = x;
+  return result;
+}
+}
+
+TEST(ResultCache, QuantizesAndSortsScans)
+{
+  ResultCache cache(1, 3.0);
+  ResultCache::Fingerprint a = cache.fingerprint({{2, -60.0}, {0, -70.4}});
+  ResultCache::Fingerprint b = cache.fingerprint({{0, -69.6}, {2, -59.0}});
+  ResultCache::Fingerprint c = cache.fingerprint({{0, -70.0}, {2, -50.0}});
+  EXPECT_EQ(a, b);
+  EXPECT_NE(a, c);
+  ASSERT_EQ(2u, a.size());
+  EXPECT_EQ(0, a[0].first);
+  EXPECT_EQ(2, a[1].first);
+}
+
+TEST(ResultCache, FindsInsertedResults)
+{
+  ResultCache cache(2);
+  ResultCache::Fingerprint a = cache.fingerprint({{0, -60.0}});
+  EstimationResult result;
+  EXPECT_FALSE(cache.find(a, result));
+  cache.insert(a, result_at(1.0));
+  ASSERT_TRUE(cache.find(a, result));
+  EXPECT_EQ(1.0, result.pose.pose.pose.position.x);
+
+  // Inserting a known fingerprint replaces its result.
+  cache.insert(a, result_at(2.0));
+  ASSERT_TRUE(cache.find(a, result));
+  EXPECT_EQ(2.0, result.pose.pose.pose.position.x);
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(2, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+}
+
+TEST(ResultCache, EvictsTheLeastRecentlyUsedResult)
+{
+  ResultCache cache(2);
+  ResultCache::Fingerprint a = cache.fingerprint({{0, -60.0}});
+  ResultCache::Fingerprint b = cache.fingerprint({{1, -60.0}});
+  ResultCache::Fingerprint c = cache.fingerprint({{2, -60.0}});
+  EstimationResult result;
+  cache.insert(a, result_at(1.0));
+  cache.insert(b, result_at(2.0));
+  // Finding a makes b the least recently used entry.
+  EXPECT_TRUE(cache.find(a, result));
+  cache.insert(c, result_at(3.0));
+  EXPECT_EQ(2, cache.size());
+  EXPECT_TRUE(cache.find(a, result));
+  EXPECT_FALSE(cache.find(b, result));
+  EXPECT_TRUE(cache.find(c, result));
+}
+
+TEST(ResultCache, ZeroCapacityDisablesTheCache)
+{
+  for(int capacity:{0, -1})
+  {
+    ResultCache cache(capacity);
+    ResultCache::Fingerprint a = cache.fingerprint({{0, -60.0}});
+    EstimationResult result;
+    cache.insert(a, result_at(1.0));
+    EXPECT_FALSE(cache.enabled());
+    EXPECT_FALSE(cache.find(a, result));
+    EXPECT_EQ(0, cache.size());
+  }
+}
+
+TEST(ResultCache, KeepsTheHypotheses)
+{
+  ResultCache cache(1);
+  ResultCache::Fingerprint a = cache.fingerprint({{0, -60.0}});
+  EstimationResult result = result_at(1.0);
+  result.has_hypotheses = true;
+  result.hypotheses.weights.push_back(0.75);
+  cache.insert(a, result);
+
+  EstimationResult cached;
+  ASSERT_TRUE(cache.find(a, cached));
+  EXPECT_TRUE(cached.has_hypotheses);
+  ASSERT_EQ(1u, cached.hypotheses.weights.size());
+  EXPECT_EQ(0.75, cached.hypotheses.weights[0]);
+}
@@ -0,0 +1,63 @@
+#include "wifi_position_estimation/training_parameters.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+class TrainingParameters : public ::testing::Test
+{
+protected:
+  boost::filesystem::path directory_;
+
+  void SetUp() override
+  {
+    directory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("training_%%%%%%%%");
+    boost::filesystem::create_directory(directory_);
+  }
+
+  void TearDown() override
+  {
+    boost::filesystem::remove_all(directory_);
+  }
+
+  std::string write(const std::string &name, const std::string &contents)
+  {
+    std::string file = (directory_ / name).string();
+    std::ofstream(file.c_str(), std::ios::binary) << contents;
+    return file;
+  }
+};
+
+TEST_F(TrainingParameters, KeyDependsOnlyOnTheTrainingData)
+{
+  std::string data = "x, y, rssi\n0.0, 0.0, -50\n1.0, 0.0, -60\n";
+  uint64_t key = training_key(write("a.csv", data));
+  EXPECT_EQ(key, training_key(write("b.csv", data)));
+  EXPECT_NE(key, training_key(write("c.csv", data + "2.0, 0.0, -70\n")));
+  // Files longer than the read buffer are hashed completely.
+  std::string long_data(10000, '0');
+  uint64_t long_key = training_key(write("d.csv", long_data));
+  long_data.back() = '1';
+  EXPECT_NE(long_key, training_key(write("e.csv", long_data)));
+}
+
+TEST_F(TrainingParameters, RoundTripsParametersOfTheSameKey)
+{
+  std::string file = (directory_ / "parameters.csv").string();
+  Eigen::Vector4d written(-2.5, 0.75, 1.25, -0.5);
+  write_parameters(file, 0xfedcba9876543210ull, written);
+
+  Eigen::Vector4d read;
+  ASSERT_TRUE(read_parameters(file, 0xfedcba9876543210ull, read));
+  for(int i = 0; i < 4; i++)
+    EXPECT_NEAR(written(i), read(i), 1e-6);
+  EXPECT_FALSE(read_parameters(file, 0xfedcba9876543211ull, read));
+}
+
+TEST_F(TrainingParameters, RejectsMissingAndUnkeyedFiles)
+{
+  Eigen::Vector4d read;
+  EXPECT_FALSE(read_parameters((directory_ / "missing.csv").string(), 0, read));
+  // Files written before the parameters were keyed
+  std::string unkeyed = write("unkeyed.csv", "signal_noise, signal_var, lengthscale\n-2.5, 0.75, 1.25, -0.5\n");
+  EXPECT_FALSE(read_parameters(unkeyed, 0, read));
+}